@@ -0,0 +1,68 @@
+"""Synthetic soundings and throughput helpers shared by the benchmark suites."""
+
+from __future__ import annotations
+
+import os
+import time
+from typing import Any, Callable
+
+import numpy as np
+
+import nzthermo as nzt
+
+THREADS = sorted({1, os.cpu_count() or 1})
+DTYPES = ["float32", "float64"]
+
+
+def pressure_levels(Z: int, dtype: Any = np.float64) -> np.ndarray:
+    """``Z`` levels from the surface to 100 hPa, evenly spaced in log pressure."""
+    return np.geomspace(101325.0, 10000.0, Z).astype(dtype)
+
+
+def soundings(
+    N: int, Z: int, dtype: Any = np.float64, nan_density: float = 0.0, seed: int = 0
+) -> tuple[np.ndarray, np.ndarray, np.ndarray]:
+    """``(Z,)`` pressure and ``(N, Z)`` temperature and dewpoint with a conditionally unstable
+    lapse rate, a moist boundary layer and ``nan_density`` of the columns masked out."""
+    rng = np.random.default_rng(seed)
+    pressure = pressure_levels(Z)
+    height = 7000.0 * np.log(pressure[0] / pressure)  # (Z,) approximately in meters
+    surface = rng.uniform(285.0, 310.0, (N, 1))
+    temperature = np.maximum(surface - 0.0065 * height, 200.0)
+    depression = rng.uniform(1.0, 10.0, (N, 1)) + 0.003 * height
+    dewpoint = temperature - depression
+
+    if nan_density:
+        mask = rng.random(N) < nan_density
+        temperature[mask] = np.nan
+        dewpoint[mask] = np.nan
+
+    return pressure.astype(dtype), temperature.astype(dtype), dewpoint.astype(dtype)
+
+
+def columns_per_second(func: Callable[[], Any], N: int, repeat: int = 3) -> float:
+    """The best of ``repeat`` calls, as the number of columns per second."""
+    best = np.inf
+    for _ in range(repeat):
+        start = time.perf_counter()
+        func()
+        best = min(best, time.perf_counter() - start)
+    return N / best
+
+
+def bytes_per_column(N: int, *arrays: np.ndarray) -> float:
+    """The bytes read and written per column of a batch of ``N`` columns, arrays shared by every
+    column are counted once. ``N`` is passed explicitly since it can not be told from the shapes
+    when every array is 1-D, either ``(N,)`` per column or ``(Z,)`` shared."""
+    return sum(x.nbytes for x in arrays) / N
+
+
+class ThreadedBenchmark:
+    """Run every benchmark of the suite with the thread count of the ``threads`` parameter, which
+    is always the last one."""
+
+    def setup(self, *params: Any) -> None:
+        nzt.set_num_threads(params[-1])
+
+    def teardown(self, *params: Any) -> None:
+        nzt.set_num_threads(0)
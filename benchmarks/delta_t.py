@@ -0,0 +1,51 @@
+"""Delta T and the solar position of a series of datetimes."""
+
+from __future__ import annotations
+
+import numpy as np
+
+from nzthermo._datetime import delta_t, solar_position
+
+from .common import THREADS, ThreadedBenchmark, columns_per_second
+
+
+class DeltaT(ThreadedBenchmark):
+    params = ([100, 10_000, 1_000_000, 10_000_000], ["random", "sorted"], THREADS)
+    param_names = ["N", "order", "threads"]
+
+    def setup(self, N: int, order: str, threads: int) -> None:
+        super().setup(threads)
+        if order == "sorted":  # evenly spaced timestamps over five years
+            step = max(1, 5 * 365 * 86400 // N)
+            self.dt = np.datetime64("2020-01-01T00", "s") + np.arange(N, dtype=np.int64) * step
+        else:
+            rng = np.random.default_rng(0)
+            self.dt = rng.integers(-2000 * 365, 2100 * 365, N).astype("datetime64[D]")
+
+    def time_delta_t(self, N: int, order: str, threads: int) -> None:
+        delta_t(self.dt)
+
+    def track_values_per_second(self, N: int, order: str, threads: int) -> float:
+        return columns_per_second(lambda: delta_t(self.dt), N)
+
+    track_values_per_second.unit = "values/s"
+
+
+class SolarPosition(ThreadedBenchmark):
+    params = ([1_000, 100_000], [24, 240], THREADS)
+    param_names = ["N", "T", "threads"]
+
+    def setup(self, N: int, T: int, threads: int) -> None:
+        super().setup(threads)
+        rng = np.random.default_rng(0)
+        self.latitude = rng.uniform(-90.0, 90.0, N)
+        self.longitude = rng.uniform(-180.0, 180.0, N)
+        self.dt = np.datetime64("2024-06-21T00", "h") + np.arange(T)
+
+    def time_solar_position(self, N: int, T: int, threads: int) -> None:
+        solar_position(self.latitude, self.longitude, self.dt)
+
+    def track_values_per_second(self, N: int, T: int, threads: int) -> float:
+        return columns_per_second(lambda: solar_position(self.latitude, self.longitude, self.dt), N * T)
+
+    track_values_per_second.unit = "values/s"
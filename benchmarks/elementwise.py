@@ -0,0 +1,64 @@
+"""The fused element-wise thermodynamics against the equivalent numpy expressions."""
+
+from __future__ import annotations
+
+import numpy as np
+
+import nzthermo.core as core
+
+from .common import DTYPES, THREADS, ThreadedBenchmark, soundings
+
+
+def theta_e_numpy(pressure: np.ndarray, temperature: np.ndarray, dewpoint: np.ndarray) -> np.ndarray:
+    # only numpy expressions, each one allocates its own temporaries
+    e = core.E0 * np.exp(17.67 * (dewpoint - core.T0) / (dewpoint - 29.65))
+    r = (core.Rd / core.Rv) * e / (pressure - e)
+    t_l = 56 + 1.0 / (1.0 / (dewpoint - 56) + np.log(temperature / dewpoint) / 800.0)
+    th_l = temperature / ((pressure - e) / core.P0) ** (core.Rd / core.Cpd) * (temperature / t_l) ** (0.28 * r)
+    return th_l * np.exp(r * (1 + 0.448 * r) * (3036.0 / t_l - 1.78))
+
+
+class EquivalentPotentialTemperature(ThreadedBenchmark):
+    params = ([1_000, 100_000], [40], DTYPES, THREADS)
+    param_names = ["N", "Z", "dtype", "threads"]
+    timeout = 300
+
+    def setup(self, N: int, Z: int, dtype: str, threads: int) -> None:
+        super().setup(threads)
+        self.pressure, self.temperature, self.dewpoint = soundings(N, Z, dtype)
+        self.out = np.empty_like(self.temperature)
+
+    def time_fused(self, N: int, Z: int, dtype: str, threads: int) -> None:
+        core.equivalent_potential_temperature(self.pressure, self.temperature, self.dewpoint, out=self.out)
+
+    def time_numpy(self, N: int, Z: int, dtype: str, threads: int) -> None:
+        theta_e_numpy(self.pressure, self.temperature, self.dewpoint)
+
+    def peakmem_fused(self, N: int, Z: int, dtype: str, threads: int) -> None:
+        core.equivalent_potential_temperature(self.pressure, self.temperature, self.dewpoint)
+
+    def peakmem_numpy(self, N: int, Z: int, dtype: str, threads: int) -> None:
+        theta_e_numpy(self.pressure, self.temperature, self.dewpoint)
+
+
+class CCLDewpoint(ThreadedBenchmark):
+    """The ``(N, Z)`` dewpoint of the surface mixing ratio, chained through one buffer."""
+
+    params = ([1_000, 100_000], [40], DTYPES, THREADS)
+    param_names = ["N", "Z", "dtype", "threads"]
+    timeout = 300
+
+    def setup(self, N: int, Z: int, dtype: str, threads: int) -> None:
+        super().setup(threads)
+        pressure, _, dewpoint = soundings(N, Z, dtype)
+        self.pressure = np.broadcast_to(pressure, dewpoint.shape)
+        self.r = core.saturation_mixing_ratio(self.pressure[:, 0], dewpoint[:, 0])[:, np.newaxis]
+
+    def time_fused(self, N: int, Z: int, dtype: str, threads: int) -> None:
+        td = core.vapor_pressure(self.pressure, self.r)
+        core.dewpoint(td, out=td)
+
+    def time_numpy(self, N: int, Z: int, dtype: str, threads: int) -> None:
+        e = self.pressure * self.r / ((core.Rd / core.Rv) + self.r)
+        ln = np.log(e / core.E0)
+        core.T0 + 243.5 * ln / (17.67 - ln)
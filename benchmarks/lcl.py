@@ -0,0 +1,61 @@
+"""Element-wise LCL, the throughput and the error of the closed form methods."""
+
+from __future__ import annotations
+
+import numpy as np
+
+import nzthermo as nzt
+
+from .common import DTYPES, THREADS, ThreadedBenchmark, columns_per_second
+
+METHODS = ["iterative", "bolton", "romps"]
+
+
+def surface(N: int, dtype: str = "float64") -> tuple[np.ndarray, np.ndarray, np.ndarray]:
+    rng = np.random.default_rng(0)
+    pressure = rng.uniform(85000.0, 103000.0, N)
+    temperature = rng.uniform(250.0, 315.0, N)
+    dewpoint = temperature - rng.uniform(0.0, 30.0, N)
+    return pressure.astype(dtype), temperature.astype(dtype), dewpoint.astype(dtype)
+
+
+class LCL(ThreadedBenchmark):
+    params = ([100, 10_000, 1_000_000, 10_000_000], DTYPES, METHODS, THREADS)
+    param_names = ["N", "dtype", "method", "threads"]
+    timeout = 300
+
+    def setup(self, N: int, dtype: str, method: str, threads: int) -> None:
+        super().setup(threads)
+        self.inputs = surface(N, dtype)
+
+    def time_lcl(self, N: int, dtype: str, method: str, threads: int) -> None:
+        nzt.lcl(*self.inputs, method=method)
+
+    def track_columns_per_second(self, N: int, dtype: str, method: str, threads: int) -> float:
+        return columns_per_second(lambda: nzt.lcl(*self.inputs, method=method), N)
+
+    track_columns_per_second.unit = "columns/s"
+
+    def track_bytes_per_column(self, N: int, dtype: str, method: str, threads: int) -> float:
+        # element-wise, every input and output is per column
+        return sum(x.dtype.itemsize for x in self.inputs) + 2 * np.dtype(dtype).itemsize
+
+    track_bytes_per_column.unit = "bytes"
+
+
+class LCLError:
+    """The largest difference of the closed form methods from the iterative solution."""
+
+    params = (["bolton", "romps"], ["pressure", "temperature"])
+    param_names = ["method", "field"]
+
+    def setup(self, method: str, field: str) -> None:
+        inputs = surface(100_000)
+        self.expected = nzt.lcl(*inputs, eps=1e-3, max_iters=100)
+        self.actual = nzt.lcl(*inputs, method=method)
+
+    def track_max_abs_error(self, method: str, field: str) -> float:
+        i = 0 if field == "pressure" else 1
+        return float(np.nanmax(np.abs(self.actual[i] - self.expected[i])))
+
+    track_max_abs_error.unit = "Pa | K"
@@ -0,0 +1,61 @@
+"""
+nzthermo against MetPy for the same batch of columns. MetPy only handles a single column at a time
+so it is called in a loop, the batch is kept small enough for that to finish.
+"""
+
+from __future__ import annotations
+
+import metpy.calc as mpcalc
+import numpy as np
+from metpy.units import units
+
+import nzthermo as nzt
+
+from .common import soundings
+
+
+class MetPyComparison:
+    params = ([10, 100], ["nzthermo", "metpy"])
+    param_names = ["N", "library"]
+    timeout = 600
+
+    def setup(self, N: int, library: str) -> None:
+        self.P, self.T, self.Td = soundings(N, 37)
+        self.columns = [
+            (self.P * units.pascal, self.T[i] * units.kelvin, self.Td[i] * units.kelvin) for i in range(N)
+        ]
+
+    def time_moist_lapse(self, N: int, library: str) -> None:
+        if library == "nzthermo":
+            nzt.moist_lapse(self.P, self.T[:, 0])
+        else:
+            for p, t, _ in self.columns:
+                mpcalc.moist_lapse(p, t[0])
+
+    def time_lcl(self, N: int, library: str) -> None:
+        if library == "nzthermo":
+            nzt.lcl(np.full(N, self.P[0]), self.T[:, 0], self.Td[:, 0])
+        else:
+            for p, t, td in self.columns:
+                mpcalc.lcl(p[0], t[0], td[0])
+
+    def time_parcel_profile(self, N: int, library: str) -> None:
+        if library == "nzthermo":
+            nzt.parcel_profile(self.P, self.T, self.Td)
+        else:
+            for p, t, td in self.columns:
+                mpcalc.parcel_profile_with_lcl(p, t, td)
+
+    def time_downdraft_cape(self, N: int, library: str) -> None:
+        if library == "nzthermo":
+            nzt.downdraft_cape(self.P, self.T, self.Td)
+        else:
+            for p, t, td in self.columns:
+                mpcalc.downdraft_cape(p, t, td)
+
+    def time_ccl(self, N: int, library: str) -> None:
+        if library == "nzthermo":
+            nzt.ccl(np.broadcast_to(self.P, self.T.shape), self.T, self.Td)
+        else:
+            for p, t, td in self.columns:
+                mpcalc.ccl(p, t, td)
@@ -0,0 +1,95 @@
+"""
+Moist adiabatic lapse rate in the three broadcast modes.
+
+Masked columns: land / sea and terrain masks set whole columns (the parcel) or the levels below
+the surface to nan. The column kernels are serial within the ``prange`` over the batch, so masked
+columns cost a single pass over the levels and fully masked blocks of the broadcast kernel are not
+integrated at all.
+"""
+
+from __future__ import annotations
+
+import numpy as np
+
+import nzthermo as nzt
+
+from .common import DTYPES, THREADS, ThreadedBenchmark, bytes_per_column, columns_per_second, pressure_levels
+
+Z = 37
+P = pressure_levels(Z)
+
+
+def masked_inputs(N: int, density: float, dtype=np.float64) -> tuple[np.ndarray, np.ndarray, np.ndarray]:
+    rng = np.random.default_rng(0)
+    temperature = rng.uniform(280.0, 305.0, N).astype(dtype)
+    reference_pressure = np.full(N, P[0], dtype=dtype)
+    mask = rng.random(N) < density
+    # masked columns come in contiguous runs, as with land / sea masks on a grid
+    run = max(N // 1000, 1)
+    mask = np.repeat(mask[::run], run)[:N]
+    temperature[mask] = np.nan
+    pressure = np.tile(P, (N, 1)).astype(dtype)
+    pressure[~mask, :4] = np.nan  # levels below ground
+    return pressure, temperature, reference_pressure
+
+
+def mode_inputs(N: int, Z: int, dtype: str, mode: str) -> tuple[np.ndarray, np.ndarray, np.ndarray]:
+    rng = np.random.default_rng(0)
+    temperature = rng.uniform(280.0, 305.0, N).astype(dtype)
+    if mode == "element-wise":
+        pressure = rng.uniform(30000.0, 100000.0, N).astype(dtype)
+        return pressure, temperature, np.full(N, 101325.0, dtype=dtype)
+
+    pressure = pressure_levels(Z, dtype)
+    if mode == "matrix":
+        pressure = np.tile(pressure, (N, 1))
+    return pressure, temperature, np.full(N, pressure.flat[0], dtype=dtype)
+
+
+class MoistLapse(ThreadedBenchmark):
+    params = ([100, 10_000, 1_000_000], [10, 37, 137], DTYPES, ["broadcast", "matrix", "element-wise"], THREADS)
+    param_names = ["N", "Z", "dtype", "mode", "threads"]
+    timeout = 300
+
+    def setup(self, N: int, Z: int, dtype: str, mode: str, threads: int) -> None:
+        if mode == "matrix" and N * Z > 10_000_000:
+            raise NotImplementedError  # skipped, the (N, Z) pressure alone would not fit the budget
+        super().setup(threads)
+        self.inputs = mode_inputs(N, Z, dtype, mode)
+
+    def time_moist_lapse(self, *params) -> None:
+        nzt.moist_lapse(*self.inputs)
+
+    def track_columns_per_second(self, N: int, *params) -> float:
+        return columns_per_second(lambda: nzt.moist_lapse(*self.inputs), N)
+
+    track_columns_per_second.unit = "columns/s"
+
+    def track_bytes_per_column(self, N: int, *params) -> float:
+        return bytes_per_column(N, *self.inputs, nzt.moist_lapse(*self.inputs))
+
+    track_bytes_per_column.unit = "bytes"
+
+
+class MoistLapseMethods:
+    params = ([10_000, 100_000], ["rk2", "rk45", "table"])
+    param_names = ["N", "method"]
+
+    def setup(self, N: int, method: str) -> None:
+        self.inputs = mode_inputs(N, 37, "float64", "broadcast")
+        nzt.moist_lapse(*self.inputs[:2], method=method)  # build the table outside of the timing
+
+    def time_moist_lapse(self, N: int, method: str) -> None:
+        nzt.moist_lapse(*self.inputs, method=method)
+
+
+class MaskedColumns:
+    params = ([10_000, 100_000], [0.0, 0.5, 0.9, 0.99], ["broadcast", "matrix"])
+    param_names = ["N", "nan_density", "mode"]
+
+    def setup(self, N: int, density: float, mode: str) -> None:
+        pressure, self.temperature, self.reference_pressure = masked_inputs(N, density)
+        self.pressure = P if mode == "broadcast" else pressure
+
+    def time_moist_lapse(self, N: int, density: float, mode: str) -> None:
+        nzt.moist_lapse(self.pressure, self.temperature, self.reference_pressure)
@@ -0,0 +1,110 @@
+"""The profile kernels over a sweep of the number of columns, levels, nan density and threads."""
+
+from __future__ import annotations
+
+import numpy as np
+
+import nzthermo as nzt
+
+from .common import DTYPES, THREADS, ThreadedBenchmark, bytes_per_column, columns_per_second, soundings
+
+
+class Profiles(ThreadedBenchmark):
+    params = ([100, 10_000, 100_000], [10, 37, 137], DTYPES, [0.0, 0.5], THREADS)
+    param_names = ["N", "Z", "dtype", "nan_density", "threads"]
+    timeout = 600
+
+    def setup(self, N: int, Z: int, dtype: str, nan_density: float, threads: int) -> None:
+        super().setup(threads)
+        self.P, self.T, self.Td = soundings(N, Z, dtype, nan_density)
+        self.grid = nzt.PressureGrid(self.P)
+
+    def time_parcel_profile(self, *params) -> None:
+        nzt.parcel_profile(self.P, self.T, self.Td)
+
+    def time_downdraft_cape(self, *params) -> None:
+        nzt.downdraft_cape(self.P, self.T, self.Td)
+
+    def time_parcel_profile_grid(self, *params) -> None:
+        nzt.parcel_profile(self.grid, self.T, self.Td)
+
+    def time_downdraft_cape_grid(self, *params) -> None:
+        nzt.downdraft_cape(self.grid, self.T, self.Td)
+
+    def time_ccl(self, *params) -> None:
+        nzt.ccl(np.broadcast_to(self.P, self.T.shape), self.T, self.Td)
+
+    def time_cape_cin(self, *params) -> None:
+        nzt.cape_cin(self.P, self.T, self.Td)
+
+    def track_parcel_profile_columns_per_second(self, N: int, *params) -> float:
+        return columns_per_second(lambda: nzt.parcel_profile(self.P, self.T, self.Td), N)
+
+    track_parcel_profile_columns_per_second.unit = "columns/s"
+
+    def track_downdraft_cape_columns_per_second(self, N: int, *params) -> float:
+        return columns_per_second(lambda: nzt.downdraft_cape(self.P, self.T, self.Td), N)
+
+    track_downdraft_cape_columns_per_second.unit = "columns/s"
+
+    def track_parcel_profile_bytes_per_column(self, N: int, *params) -> float:
+        return bytes_per_column(N, self.P, self.T, self.Td, *nzt.parcel_profile(self.P, self.T, self.Td))
+
+    track_parcel_profile_bytes_per_column.unit = "bytes"
+
+    def track_downdraft_cape_bytes_per_column(self, N: int, *params) -> float:
+        return bytes_per_column(N, self.P, self.T, self.Td, nzt.downdraft_cape(self.P, self.T, self.Td))
+
+    track_downdraft_cape_bytes_per_column.unit = "bytes"
+
+
+class Tiling(ThreadedBenchmark):
+    """The time and the peak resident memory of the kernels that hold ``(N, Z)`` temporaries, in a
+    single tile and in tiles sized to the L2 cache, the L3 cache and a 256 MiB budget. The float64
+    soundings are cast to float32 by ``downdraft_cape`` one tile at a time."""
+
+    params = ([100_000, 1_000_000], [37, 137], [None, 2**20, 32 * 2**20, 256 * 2**20], THREADS)
+    param_names = ["N", "Z", "max_memory", "threads"]
+    timeout = 600
+
+    def setup(self, N: int, Z: int, max_memory: int | None, threads: int) -> None:
+        super().setup(threads)
+        self.P, self.T, self.Td = soundings(N, Z, "float64")
+        self.P2 = np.broadcast_to(self.P, self.T.shape)
+
+    def time_ccl(self, N: int, Z: int, max_memory: int | None, threads: int) -> None:
+        nzt.ccl(self.P2, self.T, self.Td, max_memory=max_memory)
+
+    def time_downdraft_cape(self, N: int, Z: int, max_memory: int | None, threads: int) -> None:
+        nzt.downdraft_cape(self.P, self.T, self.Td, dtype=np.float32, max_memory=max_memory)
+
+    def peakmem_ccl(self, N: int, Z: int, max_memory: int | None, threads: int) -> None:
+        nzt.ccl(self.P2, self.T, self.Td, max_memory=max_memory)
+
+    def peakmem_downdraft_cape(self, N: int, Z: int, max_memory: int | None, threads: int) -> None:
+        nzt.downdraft_cape(self.P, self.T, self.Td, dtype=np.float32, max_memory=max_memory)
+
+
+class SerialThreshold:
+    """The per-call overhead for a handful of soundings, run on the calling thread below the serial
+    threshold or through the OpenMP team with a threshold of 0."""
+
+    params = ([1, 4, 16], [37, 137], ["serial", "openmp"])
+    param_names = ["N", "Z", "path"]
+
+    def setup(self, N: int, Z: int, path: str) -> None:
+        self.threshold = nzt.get_serial_threshold()
+        nzt.set_serial_threshold(2**62 if path == "serial" else 0)
+        self.P, self.T, self.Td = soundings(N, Z, "float64")
+
+    def teardown(self, N: int, Z: int, path: str) -> None:
+        nzt.set_serial_threshold(self.threshold)
+
+    def time_cape_cin(self, N: int, Z: int, path: str) -> None:
+        nzt.cape_cin(self.P, self.T, self.Td)
+
+    def time_downdraft_cape(self, N: int, Z: int, path: str) -> None:
+        nzt.downdraft_cape(self.P, self.T, self.Td)
+
+    def time_moist_lapse(self, N: int, Z: int, path: str) -> None:
+        nzt.moist_lapse(self.P, self.T[:, 0])
@@ -1,32 +1,74 @@
 __all__ = [
     # ._c
+    "DIAGNOSTICS_ENABLED",
     "OPENMP_ENABLED",
-    "lcl",
-    "moist_lapse",
+    "PressureGrid",
+    "cape_cin",
+    "diagnostics",
+    "get_num_threads",
+    "get_schedule",
+    "get_serial_threshold",
+    "mixed_parcel",
+    "most_unstable_parcel",
+    "reset_diagnostics",
+    "set_num_threads",
+    "set_schedule",
+    "set_serial_threshold",
+    "threading_info",
     # .core
     "dewpoint",
     "dewpoint_from_specific_humidity",
     "wet_bulb_temperature",
     "ccl",
+    "convective_levels",
+    "el",
+    "lcl",
+    "lfc",
     "downdraft_cape",
     "dry_lapse",
     "mixing_ratio",
     "mixing_ratio_from_specific_humidity",
+    "moist_lapse",
+    "parcel_profile",
     "saturation_mixing_ratio",
     "saturation_vapor_pressure",
+    "sounding",
     "vapor_pressure",
 ]
-from ._c import OPENMP_ENABLED, lcl, moist_lapse
+from ._c import (
+    DIAGNOSTICS_ENABLED,
+    OPENMP_ENABLED,
+    PressureGrid,
+    cape_cin,
+    diagnostics,
+    get_num_threads,
+    get_schedule,
+    get_serial_threshold,
+    mixed_parcel,
+    most_unstable_parcel,
+    reset_diagnostics,
+    set_num_threads,
+    set_schedule,
+    set_serial_threshold,
+    threading_info,
+)
 from .core import (
     ccl,
+    convective_levels,
     dewpoint,
     dewpoint_from_specific_humidity,
     downdraft_cape,
     dry_lapse,
+    el,
+    lcl,
+    lfc,
     mixing_ratio,
     mixing_ratio_from_specific_humidity,
+    moist_lapse,
+    parcel_profile,
     saturation_mixing_ratio,
     saturation_vapor_pressure,
+    sounding,
     vapor_pressure,
     wet_bulb_temperature,
 )
@@ -10,9 +10,39 @@ cdef extern from *:
     cdef bint OPENMP
 
 
+cdef extern from *:
+    """
+    #ifdef _OPENMP
+    #include <omp.h>
+    static void nzt_set_num_threads(int n) { omp_set_num_threads(n); }
+    static int nzt_get_num_threads(void) { return omp_get_max_threads(); }
+    static void nzt_set_schedule(int kind, int chunk) { omp_set_schedule((omp_sched_t) kind, chunk); }
+    /* the kind keeps the modifier bits, e.g. ``omp_sched_monotonic``, so that it can be restored as is */
+    static int nzt_get_schedule(int *chunk) {
+        omp_sched_t kind;
+        omp_get_schedule(&kind, chunk);
+        return (int) kind;
+    }
+    #else
+    static void nzt_set_num_threads(int n) { (void) n; }
+    static int nzt_get_num_threads(void) { return 1; }
+    static void nzt_set_schedule(int kind, int chunk) { (void) kind; (void) chunk; }
+    static int nzt_get_schedule(int *chunk) { *chunk = 0; return 0; }
+    #endif /* _OPENMP */
+    """
+    void nzt_set_num_threads(int n) noexcept nogil
+    int nzt_get_num_threads() noexcept nogil
+    void nzt_set_schedule(int kind, int chunk) noexcept nogil
+    int nzt_get_schedule(int* chunk) noexcept nogil
+
+
 cdef extern from "<math.h>" nogil:
     double exp(double x)
     double log(double x)
+    double pow(double x, double y)
+    float expf(float x)
+    float logf(float x)
+    float powf(float x, float y)
     double ceil(double x)
     double sin(double x)
     double cos(double x)
@@ -20,6 +50,8 @@ cdef extern from "<math.h>" nogil:
     double asin(double x)
     double acos(double x)
     double atan(double x)
+    double atan2(double y, double x)
+    double fmod(double x, double y)
     double fmax(double x, double y)
     double fmin(double x, double y)
     bint isnan(long double x)
@@ -35,3 +67,160 @@ cdef enum BroadcastMode:
     BROADCAST = 1
     MATRIX = 2
     ELEMENT_WISE = 3
+
+
+cdef enum IntegrationMethod:
+    RK2 = 1
+    RK45 = 2
+    TABLE = 3
+
+
+cdef enum LCLMethod:
+    ITERATIVE = 1
+    BOLTON = 2
+    ROMPS = 3
+
+
+cdef enum ConvectiveLevel:
+    BOTTOM = 1
+    TOP = 2
+    MOST_CAPE = 3
+
+
+cdef enum SoundingPass:
+    PARCEL = 1
+    DOWNDRAFT = 2
+    CONDENSATION = 4
+    MOISTURE = 8
+
+
+cdef enum ParcelKind:
+    SURFACE = 1
+    MIXED_LAYER = 2
+    MOST_UNSTABLE = 3
+
+
+cdef enum WetBulbMethod:
+    NORMAND = 1
+    STULL = 2
+
+
+cdef enum ElementwiseKind:
+    SATURATION_VAPOR_PRESSURE = 1
+    VAPOR_PRESSURE = 2
+    DEWPOINT = 3
+    MIXING_RATIO = 4
+    SATURATION_MIXING_RATIO = 5
+    VIRTUAL_TEMPERATURE = 6
+    POTENTIAL_TEMPERATURE = 7
+    EQUIVALENT_POTENTIAL_TEMPERATURE = 8
+
+
+# -------------------------------------------------------------------------------------------------
+# C level API
+# -------------------------------------------------------------------------------------------------
+# The structs and kernels below can be cimported from other Cython modules and called without the
+# GIL, as in ``from nzthermo._c cimport floating, moist_lapse_1d_``. The kernels only read their
+# inputs and write to their outputs, so concurrent calls on disjoint outputs are thread-safe. The
+# units are those of the Python functions.
+cdef struct GridLevels:
+    const double* log_pressure      # (Z,) log(p)
+    const double* exner             # (Z,) (p / P0)^(Rd / Cpd)
+    size_t layer_start              # [layer_start, layer_stop) the 700-500 hPa layer
+    size_t layer_stop
+
+
+cdef struct PseudoAdiabats:
+    const double* data  # (theta_size, pressure_size) C-contiguous
+    size_t theta_size
+    size_t pressure_size
+    double log_pressure_min
+    double delta_log_pressure
+
+
+cdef floating saturation_vapor_pressure(floating temperature) noexcept nogil
+cdef floating saturation_mixing_ratio(floating pressure, floating temperature) noexcept nogil
+cdef floating vapor_pressure(floating pressure, floating mixing_ratio) noexcept nogil
+cdef floating _dewpoint(floating vapor_pressure) noexcept nogil
+cdef floating mixing_ratio(
+    floating partial_press, floating total_press, floating molecular_weight_ratio=*
+) noexcept nogil
+cdef floating virtual_temperature(floating temperature, floating mixing_ratio) noexcept nogil
+cdef floating potential_temperature(floating pressure, floating temperature) noexcept nogil
+cdef floating equivalent_potential_temperature(
+    floating pressure, floating temperature, floating dewpoint
+) noexcept nogil
+cdef floating moist_lapse_integrator(
+    floating pressure, floating next_pressure, floating temperature, floating step
+) noexcept nogil
+cdef floating lcl_integrator(
+    floating pressure, floating temperature, floating mixing_ratio, size_t max_iters, floating eps
+) noexcept nogil
+cdef floating wet_bulb_normand(
+    floating pressure, floating temperature, floating dewpoint, floating step, size_t max_iters, floating eps
+) noexcept nogil
+cdef floating wet_bulb_stull(floating temperature, floating dewpoint) noexcept nogil
+
+# ``table`` may be NULL for the RK2 and RK45 methods, ``grid`` may always be NULL
+cdef void moist_lapse_1d_(
+    floating[:] out,
+    const floating[:] pressure,
+    floating reference_pressure,
+    floating temperature,
+    floating step,
+    IntegrationMethod method,
+    floating rtol,
+    const PseudoAdiabats* table,
+    floating top_pressure=*,
+    floating min_temperature=*,
+) noexcept nogil
+cdef floating moist_lapse_element_(
+    floating pressure,
+    floating reference_pressure,
+    floating temperature,
+    floating step,
+    IntegrationMethod method,
+    floating rtol,
+    const PseudoAdiabats* table,
+    floating top_pressure=*,
+) noexcept nogil
+cdef void parcel_profile_1d_(
+    floating[:] pressure_out,
+    floating[:] temperature_out,
+    floating[:] parcel_temperature_out,
+    floating[:] dewpoint_out,
+    floating[:] lcl_out,
+    const floating[:] pressure,
+    const floating[:] temperature,
+    const floating[:] dewpoint,
+    floating reference_pressure,
+    floating reference_temperature,
+    floating reference_dewpoint,
+    floating step,
+    size_t max_iters,
+    floating eps,
+    const GridLevels* grid,
+) noexcept nogil
+cdef void cape_cin_1d_(
+    floating[:] out,
+    const floating[:] pressure,
+    const floating[:] temperature,
+    const floating[:] dewpoint,
+    floating reference_pressure,
+    floating reference_temperature,
+    floating reference_dewpoint,
+    floating step,
+    size_t max_iters,
+    floating eps,
+    ParcelKind parcel,
+    floating depth,
+) noexcept nogil
+cdef floating downdraft_cape_1d_(
+    const floating[:] pressure,
+    const floating[:] temperature,
+    const floating[:] dewpoint,
+    floating step,
+    size_t max_iters,
+    floating eps,
+    const GridLevels* grid,
+) noexcept nogil
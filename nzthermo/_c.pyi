@@ -1,4 +1,4 @@
-from typing import Any, Literal, TypeVar, Union, overload
+from typing import Any, Literal, Sequence, TypeVar, Union, overload
 
 import numpy as np
 
@@ -8,6 +8,28 @@ _T = TypeVar("_T")
 _dtype_T = TypeVar("_dtype_T", np.float64, np.float32, np.float_)
 _dtype = type[_dtype_T] | type[float] | Literal["float32", "float64"]
 OPENMP_ENABLED: bool
+DIAGNOSTICS_ENABLED: bool
+SOUNDING_FIELDS: tuple[str, ...]
+
+class PressureGrid:
+    pressure: np.ndarray[shape[Z], np.dtype[np.float64]]
+    log_pressure: np.ndarray[shape[Z], np.dtype[np.float64]]
+    exner: np.ndarray[shape[Z], np.dtype[np.float64]]
+    layer_start: int
+    layer_stop: int
+    def __init__(self, pressure: Pascal[np.ndarray[shape[Z], np.dtype[Any]]]) -> None: ...
+    def __len__(self) -> int: ...
+
+def set_num_threads(n: int = 0) -> None: ...
+def get_num_threads() -> int: ...
+def set_schedule(kind: Literal["auto", "static", "dynamic", "guided", "runtime"] = "auto", chunk: int = 0) -> None: ...
+def get_schedule() -> tuple[str, int]: ...
+def set_serial_threshold(n: int = 1024) -> None: ...
+def get_serial_threshold() -> int: ...
+def diagnostics() -> dict[str, Any]: ...
+def reset_diagnostics() -> None: ...
+def threading_info() -> dict[str, Any]: ...
+def _batch_rows(N: int, column_bytes: int, batch_size: int | None = None, max_memory: int | None = None) -> int: ...
 
 @overload
 def moist_lapse(
@@ -16,7 +38,13 @@ def moist_lapse(
     reference_pressure: Pascal[np.ndarray[N, np.dtype[_dtype_T]]] | None = None,
     *,
     step: float = 1000.0,
+    threads: int | None = None,
     dtype: _dtype[_dtype_T] | None = None,
+    out: np.ndarray[shape[N], np.dtype[_dtype_T]] | None = None,
+    method: Literal["rk2", "rk45", "table"] = ...,
+    rtol: float = ...,
+    top_pressure: float = ...,
+    min_temperature: float = ...,
 ) -> Kelvin[np.ndarray[shape[N], np.dtype[_dtype_T]]]: ...
 @overload
 def moist_lapse(
@@ -26,20 +54,33 @@ def moist_lapse(
             np.ndarray[shape[Literal[1], Z], np.dtype[_dtype_T]],
             np.ndarray[shape[N, Z], np.dtype[_dtype_T]],
         ]
-    ],
+    ]
+    | PressureGrid,
     temperature: Kelvin[np.ndarray[shape[N], np.dtype[_dtype_T]]],
     reference_pressure: Pascal[np.ndarray[N, np.dtype[_dtype_T]]] | None = None,
     *,
     step: float = 1000.0,
+    threads: int | None = None,
     dtype: _dtype[_dtype_T] | None = None,
+    out: np.ndarray[shape[N, Z], np.dtype[_dtype_T]] | None = None,
+    method: Literal["rk2", "rk45", "table"] = ...,
+    rtol: float = ...,
+    top_pressure: float = ...,
+    min_temperature: float = ...,
 ) -> Kelvin[np.ndarray[shape[N, Z], np.dtype[_dtype_T]]]: ...
 def moist_lapse(
-    pressure: Pascal[np.ndarray[Any, np.dtype[_dtype_T]]],
+    pressure: Pascal[np.ndarray[Any, np.dtype[_dtype_T]]] | PressureGrid,
     temperature: Kelvin[np.ndarray[Any, np.dtype[_dtype_T]]],
     reference_pressure: Pascal[np.ndarray[Any, np.dtype[_dtype_T]]] | None = None,
     *,
     step: float = 1000.0,
+    threads: int | None = None,
     dtype: _dtype[_dtype_T] | None = None,
+    out: np.ndarray[shape[N, Z], np.dtype[_dtype_T]] | None = None,
+    method: Literal["rk2", "rk45", "table"] = ...,
+    rtol: float = ...,
+    top_pressure: float = ...,
+    min_temperature: float = ...,
 ) -> Kelvin[np.ndarray[shape[N, Z], np.dtype[_dtype_T]]]: ...
 def lcl(
     pressure: Pascal[np.ndarray[shape[N], np.dtype[_dtype_T]]],
@@ -48,5 +89,171 @@ def lcl(
     *,
     max_iters: int = 50,
     tolerance: float = 0.1,
+    threads: int | None = None,
     dtype: _dtype[_dtype_T] | None = None,
+    out: np.ndarray[shape[Literal[2], N], np.dtype[_dtype_T]] | None = None,
+    method: Literal["iterative", "bolton", "romps"] = ...,
 ) -> Pascal[np.ndarray[shape[Literal[2], N], np.dtype[_dtype_T]]]: ...
+def intersect(
+    x: np.ndarray[Any, np.dtype[Any]],
+    a: np.ndarray[shape[N, Z], np.dtype[Any]],
+    b: np.ndarray[shape[N, Z], np.dtype[Any]],
+    *,
+    log_x: bool = False,
+    k: int | None = None,
+    threads: int | None = None,
+    dtype: _dtype[_dtype_T] | None = None,
+) -> np.ndarray[Any, np.dtype[_dtype_T]]: ...
+def interpolate(
+    x: np.ndarray[shape[N], np.dtype[Any]],
+    xp: np.ndarray[shape[Z], np.dtype[Any]],
+    *args: np.ndarray[shape[N, Z], np.dtype[Any]],
+    log_x: bool = False,
+    threads: int | None = None,
+    dtype: _dtype[_dtype_T] | None = None,
+) -> np.ndarray[shape[int, N], np.dtype[_dtype_T]]: ...
+def insert(
+    arr: np.ndarray[shape[N, Z], np.dtype[Any]],
+    values: np.ndarray[shape[N], np.dtype[Any]],
+    z: np.ndarray[shape[Z], np.dtype[Any]],
+    x: np.ndarray[shape[N], np.dtype[Any]] | None = None,
+    *,
+    threads: int | None = None,
+    dtype: _dtype[_dtype_T] | None = None,
+) -> np.ndarray[shape[N, int], np.dtype[_dtype_T]]: ...
+def parcel_profile(
+    pressure: Pascal[np.ndarray[shape[Z] | shape[Literal[1], Z] | shape[N, Z], np.dtype[_dtype_T]]] | PressureGrid,
+    temperature: Kelvin[np.ndarray[shape[N, Z], np.dtype[_dtype_T]]],
+    dewpoint: Kelvin[np.ndarray[shape[N, Z], np.dtype[_dtype_T]]],
+    reference_pressure: Pascal[np.ndarray[shape[N], np.dtype[_dtype_T]]] | None = None,
+    reference_temperature: Kelvin[np.ndarray[shape[N], np.dtype[_dtype_T]]] | None = None,
+    reference_dewpoint: Kelvin[np.ndarray[shape[N], np.dtype[_dtype_T]]] | None = None,
+    *,
+    step: float = 1000.0,
+    max_iters: int = 50,
+    eps: float = 0.1,
+    threads: int | None = None,
+    dtype: _dtype[_dtype_T] | None = None,
+) -> tuple[
+    Pascal[np.ndarray[shape[N, Z], np.dtype[_dtype_T]]],
+    Pascal[np.ndarray[shape[N], np.dtype[_dtype_T]]],
+    Kelvin[np.ndarray[shape[N, Z], np.dtype[_dtype_T]]],
+    Kelvin[np.ndarray[shape[N, Z], np.dtype[_dtype_T]]],
+    Kelvin[np.ndarray[shape[N], np.dtype[_dtype_T]]],
+    Kelvin[np.ndarray[shape[N, Z], np.dtype[_dtype_T]]],
+]: ...
+def elementwise(
+    function: Literal[
+        "saturation_vapor_pressure",
+        "vapor_pressure",
+        "dewpoint",
+        "mixing_ratio",
+        "saturation_mixing_ratio",
+        "virtual_temperature",
+        "potential_temperature",
+        "equivalent_potential_temperature",
+    ],
+    *args: np.ndarray[Any, np.dtype[np.floating[Any]]] | float,
+    ratio: float | None = None,
+    threads: int | None = None,
+    dtype: _dtype[_dtype_T] | None = None,
+    out: np.ndarray[Any, np.dtype[_dtype_T]] | None = None,
+) -> np.ndarray[Any, np.dtype[_dtype_T]]: ...
+def wet_bulb_temperature(
+    pressure: Pascal[np.ndarray[Any, np.dtype[_dtype_T]]],
+    temperature: Kelvin[np.ndarray[Any, np.dtype[_dtype_T]]],
+    dewpoint: Kelvin[np.ndarray[Any, np.dtype[_dtype_T]]],
+    *,
+    method: Literal["normand", "stull"] = ...,
+    step: float = 1000.0,
+    max_iters: int = 50,
+    eps: float = 0.1,
+    threads: int | None = None,
+    dtype: _dtype[_dtype_T] | None = None,
+    out: np.ndarray[Any, np.dtype[_dtype_T]] | None = None,
+) -> Kelvin[np.ndarray[Any, np.dtype[_dtype_T]]]: ...
+def cape_cin(
+    pressure: Pascal[np.ndarray[shape[Z] | shape[Literal[1], Z] | shape[N, Z], np.dtype[_dtype_T]]],
+    temperature: Kelvin[np.ndarray[shape[N, Z], np.dtype[_dtype_T]]],
+    dewpoint: Kelvin[np.ndarray[shape[N, Z], np.dtype[_dtype_T]]],
+    reference_pressure: Pascal[np.ndarray[shape[N], np.dtype[_dtype_T]]] | None = None,
+    reference_temperature: Kelvin[np.ndarray[shape[N], np.dtype[_dtype_T]]] | None = None,
+    reference_dewpoint: Kelvin[np.ndarray[shape[N], np.dtype[_dtype_T]]] | None = None,
+    *,
+    parcel: Literal["surface", "mixed_layer", "most_unstable"] = ...,
+    depth: float | None = ...,
+    step: float = 1000.0,
+    max_iters: int = 50,
+    eps: float = 0.1,
+    threads: int | None = None,
+    dtype: _dtype[_dtype_T] | None = None,
+    out: np.ndarray[shape[Literal[2], N], np.dtype[_dtype_T]] | None = None,
+) -> np.ndarray[shape[Literal[2], N], np.dtype[_dtype_T]]: ...
+def mixed_parcel(
+    pressure: Pascal[np.ndarray[shape[Z] | shape[Literal[1], Z] | shape[N, Z], np.dtype[_dtype_T]]],
+    temperature: Kelvin[np.ndarray[shape[N, Z], np.dtype[_dtype_T]]],
+    dewpoint: Kelvin[np.ndarray[shape[N, Z], np.dtype[_dtype_T]]],
+    *,
+    depth: float = ...,
+    threads: int | None = None,
+    dtype: _dtype[_dtype_T] | None = None,
+    out: np.ndarray[shape[Literal[3], N], np.dtype[_dtype_T]] | None = None,
+) -> np.ndarray[shape[Literal[3], N], np.dtype[_dtype_T]]: ...
+def most_unstable_parcel(
+    pressure: Pascal[np.ndarray[shape[Z] | shape[Literal[1], Z] | shape[N, Z], np.dtype[_dtype_T]]],
+    temperature: Kelvin[np.ndarray[shape[N, Z], np.dtype[_dtype_T]]],
+    dewpoint: Kelvin[np.ndarray[shape[N, Z], np.dtype[_dtype_T]]],
+    *,
+    depth: float = ...,
+    threads: int | None = None,
+    dtype: _dtype[_dtype_T] | None = None,
+    out: np.ndarray[shape[Literal[3], N], np.dtype[_dtype_T]] | None = None,
+) -> np.ndarray[shape[Literal[3], N], np.dtype[_dtype_T]]: ...
+def convective_levels(
+    pressure: Pascal[np.ndarray[shape[Z] | shape[Literal[1], Z] | shape[N, Z], np.dtype[_dtype_T]]],
+    temperature: Kelvin[np.ndarray[shape[N, Z], np.dtype[_dtype_T]]],
+    dewpoint: Kelvin[np.ndarray[shape[N, Z], np.dtype[_dtype_T]]],
+    reference_pressure: Pascal[np.ndarray[shape[N], np.dtype[_dtype_T]]] | None = None,
+    reference_temperature: Kelvin[np.ndarray[shape[N], np.dtype[_dtype_T]]] | None = None,
+    reference_dewpoint: Kelvin[np.ndarray[shape[N], np.dtype[_dtype_T]]] | None = None,
+    *,
+    which_lfc: Literal["bottom", "top", "most_cape"] = ...,
+    which_el: Literal["bottom", "top", "most_cape"] = ...,
+    virtual: bool = ...,
+    step: float = 1000.0,
+    max_iters: int = 50,
+    eps: float = 0.1,
+    threads: int | None = None,
+    dtype: _dtype[_dtype_T] | None = None,
+    out: np.ndarray[shape[Literal[6], N], np.dtype[_dtype_T]] | None = None,
+) -> np.ndarray[shape[Literal[6], N], np.dtype[_dtype_T]]: ...
+def sounding(
+    pressure: Pascal[np.ndarray[shape[Z] | shape[Literal[1], Z] | shape[N, Z], np.dtype[_dtype_T]]],
+    temperature: Kelvin[np.ndarray[shape[N, Z], np.dtype[_dtype_T]]],
+    dewpoint: Kelvin[np.ndarray[shape[N, Z], np.dtype[_dtype_T]]],
+    *,
+    outputs: str | Sequence[str] | None = None,
+    which_lfc: Literal["bottom", "top", "most_cape"] = ...,
+    which_el: Literal["bottom", "top", "most_cape"] = ...,
+    virtual: bool = ...,
+    step: float = 1000.0,
+    max_iters: int = 50,
+    eps: float = 0.1,
+    threads: int | None = None,
+    dtype: _dtype[_dtype_T] | None = None,
+    out: np.ndarray[shape[Literal[14], N], np.dtype[_dtype_T]] | None = None,
+) -> np.ndarray[shape[Literal[14], N], np.dtype[_dtype_T]]: ...
+def downdraft_cape(
+    pressure: Pascal[np.ndarray[shape[Z] | shape[Literal[1], Z] | shape[N, Z], np.dtype[_dtype_T]]] | PressureGrid,
+    temperature: Kelvin[np.ndarray[shape[N, Z], np.dtype[_dtype_T]]],
+    dewpoint: Kelvin[np.ndarray[shape[N, Z], np.dtype[_dtype_T]]],
+    *,
+    step: float = 1000.0,
+    max_iters: int = 50,
+    eps: float = 0.1,
+    threads: int | None = None,
+    dtype: _dtype[_dtype_T] | None = None,
+    out: np.ndarray[shape[N], np.dtype[_dtype_T]] | None = None,
+    batch_size: int | None = None,
+    max_memory: int | None = None,
+) -> np.ndarray[shape[N], np.dtype[_dtype_T]]: ...
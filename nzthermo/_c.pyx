@@ -7,378 +7,4132 @@
 # pyright: reportGeneralTypeIssues=false
 
 from cython.parallel cimport parallel, prange
-from cython.view cimport array as cvarray
+from libc.stdint cimport int64_t, uint64_t
+from libc.stdlib cimport free, malloc
+from libc.string cimport memcpy
+
+import collections
+import hashlib
+import os
+import threading
+import time
 
 import numpy as np
 cimport numpy as np
 
+cdef extern from "_simd.h" nogil:
+    enum: NZT_BLOCK
+    ctypedef struct nzt_constants:
+        double Rd
+        double Lv
+        double Cpd
+        double epsilon
+        double T0
+        double E0
+
+    void nzt_moist_lapse_lanes(
+        double* temperature,
+        size_t n,
+        double pressure,
+        double next_pressure,
+        double step,
+        const nzt_constants* constants,
+    )
+    void nzt_store_rows_d(double* out, Py_ssize_t row_stride, const double* block, size_t n, size_t Z)
+    void nzt_store_rows_f(float* out, Py_ssize_t row_stride, const double* block, size_t n, size_t Z)
+
+cdef extern from "_diagnostics.h" nogil:
+    bint NZT_DIAGNOSTICS
+    enum: NZT_MAX_THREADS
+    enum: NZT_LCL_HISTOGRAM_SIZE
+    enum: NZT_MAX_NONCONVERGED
+    ctypedef struct nzt_diagnostics_t:
+        uint64_t solver_evaluations
+        uint64_t lcl_iterations[NZT_LCL_HISTOGRAM_SIZE]
+        uint64_t lcl_nonconverged
+        uint64_t thread_columns[NZT_MAX_THREADS]
+        int64_t nonconverged[NZT_MAX_NONCONVERGED]
+
+    nzt_diagnostics_t* nzt_get_diagnostics()
+    void nzt_reset_diagnostics()
+    void nzt_diag_columns(int64_t start, uint64_t n)
+    void nzt_diag_column(int64_t i)
+    void nzt_diag_solver(uint64_t n)
+    void nzt_diag_lcl(size_t iterations, bint converged)
+
+cdef extern from *:
+    """
+    /* set by ``_Parallel`` for the calls below the serial threshold, the kernels then run their
+       column loops on the calling thread without entering an OpenMP region */
+    static _Thread_local int nzt_serial = 0;
+    static inline int nzt_get_serial(void) { return nzt_serial; }
+    static inline void nzt_set_serial(int serial) { nzt_serial = serial; }
+    """
+    bint nzt_get_serial() noexcept nogil
+    void nzt_set_serial(bint serial) noexcept nogil
+
 from . import const as _const
 
-np.import_array()
-OPENMP_ENABLED = bool(OPENMP)
+np.import_array()
+OPENMP_ENABLED = bool(OPENMP)
+DIAGNOSTICS_ENABLED = bool(NZT_DIAGNOSTICS)
+
+# -------------------------------------------------------------------------------------------------
+# constant declarations
+# -------------------------------------------------------------------------------------------------
+# The constants are double precision, the float32 specializations cast them with ``<floating>`` so
+# that the arithmetic stays in single precision instead of being promoted to double.
+cdef:
+    double Rd       = _const.Rd
+    double Rv       = _const.Rv
+    double Lv       = _const.Lv
+    double Cpd      = _const.Cpd
+    double epsilon  = _const.epsilon
+    double T0       = _const.T0
+    double E0       = _const.E0
+    double P0       = _const.P0
+    double g        = _const.g
+    double nan      = float('nan')
+    double inf      = float('inf')
+    size_t RK45_MAX_STEPS = 10000
+    # pseudo-adiabat lookup table grid, wet bulb potential temperature (K) by log pressure (Pa)
+    double TABLE_THETA_MIN = 200.0
+    double TABLE_THETA_MAX = 330.0
+    size_t TABLE_THETA_SIZE = 261
+    double TABLE_PRESSURE_MIN = 1000.0
+    double TABLE_PRESSURE_MAX = 110000.0
+    size_t TABLE_PRESSURE_SIZE = 512
+    double TABLE_STEP = 100.0
+
+del _const
+
+cdef nzt_constants SIMD_CONSTANTS
+SIMD_CONSTANTS.Rd = Rd
+SIMD_CONSTANTS.Lv = Lv
+SIMD_CONSTANTS.Cpd = Cpd
+SIMD_CONSTANTS.epsilon = epsilon
+SIMD_CONSTANTS.T0 = T0
+SIMD_CONSTANTS.E0 = E0
+
+
+# -------------------------------------------------------------------------------------------------
+# parallel configuration
+# -------------------------------------------------------------------------------------------------
+# omp_sched_t
+cdef dict SCHEDULE_KINDS = {"static": 1, "dynamic": 2, "guided": 3}
+cdef int _num_threads = 0
+cdef str _schedule = "runtime" if "OMP_SCHEDULE" in os.environ else "auto"
+cdef int _chunk = 0
+cdef size_t _serial_threshold = 1024
+
+
+def set_num_threads(int n = 0):
+    """The number of threads used by the kernels, ``0`` uses the OpenMP default of the calling
+    thread (``OMP_NUM_THREADS`` or the number of cores). The ``threads=`` argument of the kernels
+    takes precedence."""
+    global _num_threads
+
+    if n < 0:
+        raise ValueError(f"the number of threads must be positive, got {n}.")
+    _num_threads = n
+
+
+def get_num_threads() -> int:
+    """The number of threads the kernels run with when ``threads=`` is not given."""
+    return _num_threads if _num_threads > 0 else nzt_get_num_threads()
+
+
+def set_schedule(str kind = "auto", int chunk = 0):
+    """
+    The OpenMP schedule of the column loops:
+
+    - ``"auto"`` (the default) dynamic with a chunk size picked from the number of columns, levels
+      and threads of each call, ``chunk`` overrides it.
+    - ``"static"``, ``"dynamic"`` or ``"guided"`` with ``chunk`` columns, ``0`` for the OpenMP
+      default. The loops over blocks of columns round it up to whole blocks.
+    - ``"runtime"`` leaves the schedule to ``OMP_SCHEDULE``, the default when it is set at import.
+    """
+    global _schedule, _chunk
+
+    if kind not in SCHEDULE_KINDS and kind not in ("auto", "runtime"):
+        raise ValueError(f"schedule must be one of 'auto', 'static', 'dynamic', 'guided' or 'runtime', got {kind!r}.")
+    elif chunk < 0:
+        raise ValueError(f"the chunk size must be positive, got {chunk}.")
+    _schedule = kind
+    _chunk = chunk
+
+
+def get_schedule() -> tuple:
+    """The ``(kind, chunk)`` set with ``set_schedule``."""
+    return _schedule, _chunk
+
+
+def set_serial_threshold(size_t n = 1024):
+    """Calls with fewer than ``n`` levels in total (columns times levels, or elements for the
+    element-wise kernels) run on the calling thread only, so a handful of soundings does not pay
+    for waking the OpenMP team. ``0`` always uses the team, ``threads=`` takes precedence."""
+    global _serial_threshold
+
+    _serial_threshold = n
+
+
+def get_serial_threshold() -> int:
+    """The size set with ``set_serial_threshold``."""
+    return _serial_threshold
+
+
+# -------------------------------------------------------------------------------------------------
+# diagnostics
+# -------------------------------------------------------------------------------------------------
+# the most recent calls of the kernels, only recorded when compiled with ``--diagnostics``
+_DIAGNOSTIC_CALLS = collections.deque(maxlen=1024)
+
+
+def diagnostics() -> dict:
+    """
+    The solver diagnostics recorded since the last ``reset_diagnostics``, only collected by a build
+    with ``python setup.py build_ext --diagnostics``, otherwise ``enabled`` is False and the counts
+    are zero.
+
+    - ``calls`` the columns, levels, threads, schedule, chunk, wall time in seconds and whether the
+      call ran serially below the serial threshold, for the most recent 1024 kernel calls.
+    - ``thread_columns`` the number of columns handled by each OpenMP thread, indexed by thread
+      number, which shows how evenly the schedule divided the work.
+    - ``solver_evaluations`` the number of evaluations of the moist lapse rate ODE, two per RK2
+      sub-step, which scales with ``1 / step``.
+    - ``lcl_iterations`` a histogram of the number of iterations of the iterative LCL, the last bin
+      counts every call with at least as many, which is what ``eps`` and ``max_iters`` control.
+    - ``lcl_nonconverged`` the number of finite parcels whose LCL did not converge within
+      ``max_iters`` and ``nonconverged`` the column indices of the first 4096 of them. The
+      column-batched ``moist_lapse`` blocks attribute their work to the first column of each
+      block, they run no iterative solver so no failure is recorded from them.
+    """
+    cdef nzt_diagnostics_t* d = nzt_get_diagnostics()
+    cdef size_t threads, count
+
+    threads = NZT_MAX_THREADS
+    while threads > 1 and d.thread_columns[threads - 1] == 0:
+        threads -= 1
+    count = min(d.lcl_nonconverged, <uint64_t> NZT_MAX_NONCONVERGED)
+
+    return {
+        "enabled": DIAGNOSTICS_ENABLED,
+        "calls": list(_DIAGNOSTIC_CALLS),
+        "thread_columns": np.array(<uint64_t[:threads]> d.thread_columns, dtype=np.uint64),
+        "solver_evaluations": d.solver_evaluations,
+        "lcl_iterations": np.array(<uint64_t[:NZT_LCL_HISTOGRAM_SIZE]> d.lcl_iterations, dtype=np.uint64),
+        "lcl_nonconverged": d.lcl_nonconverged,
+        "nonconverged": np.array(<int64_t[:count]> d.nonconverged, dtype=np.int64) if count else np.empty(0, np.int64),
+    }
+
+
+def reset_diagnostics() -> None:
+    """Clear the diagnostics, this must not be called while a kernel is running."""
+    nzt_reset_diagnostics()
+    _DIAGNOSTIC_CALLS.clear()
+
+
+def threading_info() -> dict:
+    """The active parallel configuration of the calling thread."""
+    cdef int chunk
+    cdef int kind = nzt_get_schedule(&chunk)
+    cdef int base = kind & 0x7fffffff  # without the monotonic modifier
+
+    return {
+        "openmp": OPENMP_ENABLED,
+        "num_threads": get_num_threads(),
+        "schedule": _schedule,
+        "chunk": _chunk,
+        "serial_threshold": _serial_threshold,
+        "runtime_schedule": {v: k for k, v in SCHEDULE_KINDS.items()}.get(base, "auto" if base else None),
+        "runtime_monotonic": kind != base,
+        "runtime_chunk": chunk,
+    }
+
+
+cdef int _auto_chunk(size_t N, size_t Z, int threads) noexcept:
+    """At least 8 chunks per thread to balance the columns that stop early or iterate longer, but
+    no more than ~4096 levels per chunk are needed to amortize the dynamic dispatch, so cheap
+    columns are not handed out one at a time."""
+    cdef size_t balance, amortize
+
+    balance = N // (8 * <size_t> max(threads, 1))
+    amortize = (4096 + Z - 1) // max(Z, <size_t> 1)
+    return <int> max(min(balance, amortize), <size_t> 1)
+
+
+cdef class _Parallel:
+    """Apply the thread count and schedule for the duration of a kernel call. The OpenMP settings
+    belong to the calling thread, so they are restored on exit and do not leak into other calls
+    such as those of concurrent dask workers.
+
+    Calls below the serial threshold run their column loops in a plain loop on the calling thread,
+    no OpenMP region is entered and the thread count and schedule are left untouched.
+
+    The loops that divide blocks of ``block`` columns between the threads pass it so that the
+    chunk is counted in blocks, of ``block * Z`` levels each, rather than in columns."""
+    cdef int threads, kind, chunk, previous_threads, previous_kind, previous_chunk
+    cdef bint serial, previous_serial
+    cdef size_t N, Z
+    cdef double start
+
+    def __cinit__(self, object threads, size_t N, size_t Z, size_t block = 1):
+        self.threads = self.kind = self.chunk = 0
+        self.N = N
+        self.Z = Z
+        self.serial = threads is None and N * max(Z, <size_t> 1) < _serial_threshold
+        if self.serial:
+            return
+        elif threads is None:
+            self.threads = _num_threads
+        elif threads < 1:
+            raise ValueError(f"threads must be a positive integer, got {threads}.")
+        else:
+            self.threads = threads
+
+        if _schedule == "auto":
+            self.kind = SCHEDULE_KINDS["dynamic"]
+            self.chunk = (
+                (_chunk + block - 1) // block if _chunk
+                else _auto_chunk((N + block - 1) // block, Z * block, self.threads or nzt_get_num_threads())
+            )
+        elif _schedule != "runtime":
+            self.kind = SCHEDULE_KINDS[_schedule]
+            self.chunk = (_chunk + block - 1) // block
+
+    def __enter__(self):
+        self.previous_serial = nzt_get_serial()
+        nzt_set_serial(self.serial)
+        if self.threads > 0:
+            self.previous_threads = nzt_get_num_threads()
+            nzt_set_num_threads(self.threads)
+        if self.kind > 0:
+            self.previous_kind = nzt_get_schedule(&self.previous_chunk)
+            nzt_set_schedule(self.kind, self.chunk)
+        if NZT_DIAGNOSTICS:
+            self.start = time.perf_counter()
+        return self
+
+    def __exit__(self, *args):
+        if NZT_DIAGNOSTICS:
+            _DIAGNOSTIC_CALLS.append({
+                "columns": self.N,
+                "levels": self.Z,
+                "threads": 1 if self.serial else nzt_get_num_threads(),
+                "schedule": threading_info()["runtime_schedule"],
+                "chunk": self.chunk,
+                "seconds": time.perf_counter() - self.start,
+                "serial": bool(self.serial),
+            })
+        if self.threads > 0:
+            nzt_set_num_threads(self.previous_threads)
+        if self.kind > 0:
+            nzt_set_schedule(self.previous_kind, self.previous_chunk)
+        nzt_set_serial(self.previous_serial)
+        return False
+
+
+# -------------------------------------------------------------------------------------------------
+# helpers
+# -------------------------------------------------------------------------------------------------
+cdef np.ndarray _output_array(np.ndarray out, tuple shape, object dtype):
+    """Allocate the output array, or validate the caller supplied ``out`` buffer so that the
+    kernels can write into it directly."""
+    if out is None:
+        return np.empty(shape, dtype=dtype)
+
+    if (<object> out).shape != shape:
+        raise ValueError(f"out must have shape {shape}, got {(<object> out).shape}.")
+    elif out.dtype != dtype:
+        raise ValueError(f"out must have dtype {np.dtype(dtype)}, got {out.dtype}.")
+    elif not out.flags.writeable:
+        raise ValueError("out must be writeable.")
+
+    return out
+
+
+def _batch_rows(Py_ssize_t N, Py_ssize_t column_bytes, object batch_size=None, object max_memory=None):
+    """The number of columns per tile for the kernels that take ``batch_size`` or ``max_memory``,
+    ``column_bytes`` is the size of the temporaries held for one column. ``max_memory`` bounds the
+    temporaries of a tile, a budget the size of the L2 or L3 cache keeps them resident. By default
+    the columns are processed in a single tile."""
+    if batch_size is not None and max_memory is not None:
+        raise ValueError("batch_size and max_memory are mutually exclusive.")
+    elif batch_size is not None:
+        if batch_size < 1:
+            raise ValueError("batch_size must be a positive integer.")
+        return max(1, min(<Py_ssize_t> batch_size, N))
+    elif max_memory is not None:
+        if max_memory < 1:
+            raise ValueError("max_memory must be a positive number of bytes.")
+        return max(1, min(<Py_ssize_t> (max_memory // max(column_bytes, 1)), N))
+
+    return max(1, N)
+
+
+cdef tuple _profile_inputs(np.ndarray pressure, np.ndarray temperature, np.ndarray dewpoint):
+    """Validate and reshape the inputs of the profile kernels, pressure is returned as ``(1, Z)``
+    for the ``BROADCAST`` mode or ``(N, Z)`` for the ``MATRIX`` mode."""
+    cdef size_t N, Z
+
+    # [ temperature, dewpoint ]
+    if temperature.ndim == 1:
+        temperature = temperature.reshape(1, -1)  # (1, Z)
+    elif temperature.ndim != 2:
+        raise ValueError("temperature must be 1D or 2D array.")
+    if dewpoint.ndim == 1:
+        dewpoint = dewpoint.reshape(1, -1)  # (1, Z)
+    if (<object> temperature).shape != (<object> dewpoint).shape:
+        raise ValueError("temperature and dewpoint arrays must be the same shape.")
+
+    N, Z = temperature.shape[0], temperature.shape[1]
+    if not Z:
+        raise ValueError("the profile must have at least one level.")
+
+    # [ pressure ]
+    if pressure.ndim == 1:
+        pressure = pressure.reshape(1, -1)  # (1, Z)
+    elif pressure.ndim != 2:
+        raise ValueError("pressure must be 1D or 2D array.")
+    if Z != <size_t> pressure.shape[1]:
+        raise ValueError("pressure must have the same number of levels as temperature and dewpoint.")
+    elif not (1 == pressure.shape[0] or N == <size_t> pressure.shape[0]):
+        raise ValueError("Unable to determine the broadcast mode.")
+
+    return pressure, temperature, dewpoint
+
+
+cdef tuple _parcel_inputs(
+    np.ndarray pressure,
+    np.ndarray temperature,
+    np.ndarray dewpoint,
+    np.ndarray reference_pressure,
+    np.ndarray reference_temperature,
+    np.ndarray reference_dewpoint,
+):
+    """``_profile_inputs`` with the reference parcel, which defaults to the first level of the
+    profile."""
+    cdef size_t N
+
+    pressure, temperature, dewpoint = _profile_inputs(pressure, temperature, dewpoint)
+    N = temperature.shape[0]
+
+    # [ reference parcel ]
+    if reference_pressure is None:
+        reference_pressure = np.broadcast_to(pressure[:, 0], (N,))
+    if reference_temperature is None:
+        reference_temperature = temperature[:, 0]
+    if reference_dewpoint is None:
+        reference_dewpoint = dewpoint[:, 0]
+    reference_pressure, reference_temperature, reference_dewpoint = (
+        x.reshape(-1) for x in (reference_pressure, reference_temperature, reference_dewpoint)
+    )
+    if not (
+        N == <size_t> reference_pressure.size
+        and N == <size_t> reference_temperature.size
+        and N == <size_t> reference_dewpoint.size
+    ):
+        raise ValueError("the reference pressure, temperature and dewpoint must have shape (N,).")
+
+    return pressure, temperature, dewpoint, reference_pressure, reference_temperature, reference_dewpoint
+
+
+# -------------------------------------------------------------------------------------------------
+# pressure grid
+# -------------------------------------------------------------------------------------------------
+cdef class PressureGrid:
+    """
+    pressure shape ``(Z,)``, finite, positive and strictly decreasing
+
+    A fixed set of pressure levels with its per-level quantities computed once, for pipelines that
+    call the profile kernels many times on the same levels, such as the 37 ERA5 pressure levels.
+    ``moist_lapse``, ``parcel_profile`` and ``downdraft_cape`` accept a grid in place of the
+    pressure array. The levels are shared by every column (the ``BROADCAST`` mode), so the
+    broadcast mode, the default reference pressure and the dtype casts of the levels are resolved
+    without inspecting the array. The kernels read the cached ``log(p)``, the exner function
+    ``(p / P0)^(Rd / Cpd)`` and the bounds of the 700-500 hPa layer instead of computing them for
+    every column.
+
+    >>> grid = nzt.PressureGrid(pressure)  # (Z,)
+    >>> for temperature, dewpoint in batches:  # (N, Z)
+    ...     nzt.downdraft_cape(grid, temperature, dewpoint)
+    """
+    cdef readonly np.ndarray pressure
+    cdef readonly np.ndarray log_pressure
+    cdef readonly np.ndarray exner
+    cdef readonly Py_ssize_t layer_start
+    cdef readonly Py_ssize_t layer_stop
+    cdef np.ndarray _pressure32
+    cdef GridLevels levels
+
+    def __cinit__(self, pressure):
+        cdef const double[::1] log_pressure, exner
+
+        levels = np.array(pressure, dtype=np.float64)  # a private copy
+        if levels.ndim != 1 or levels.size == 0:
+            raise ValueError("pressure must be a non-empty 1D array.")
+        elif not (np.isfinite(levels).all() and (levels > 0.0).all()):
+            raise ValueError("pressure must be finite and positive.")
+        elif (np.diff(levels) >= 0.0).any():
+            raise ValueError("pressure must be strictly decreasing.")
+
+        self.pressure = levels
+        self.log_pressure = np.log(levels)
+        self.exner = (levels / P0) ** (Rd / Cpd)
+        self.layer_start = np.searchsorted(-levels, -7e4, side="left")
+        self.layer_stop = np.searchsorted(-levels, -5e4, side="right")
+        self._pressure32 = levels.astype(np.float32)
+        for x in (self.pressure, self.log_pressure, self.exner, self._pressure32):
+            x.setflags(write=False)
+
+        log_pressure = self.log_pressure
+        exner = self.exner
+        self.levels.log_pressure = &log_pressure[0]
+        self.levels.exner = &exner[0]
+        self.levels.layer_start = self.layer_start
+        self.levels.layer_stop = self.layer_stop
+
+    def __len__(self):
+        return self.pressure.shape[0]
+
+    def __repr__(self):
+        return f"PressureGrid({len(self)} levels, {self.pressure[0]:g} to {self.pressure[-1]:g} Pa)"
+
+    cdef np.ndarray _levels(self, object dtype):
+        """The ``(1, Z)`` levels in ``dtype``, without a copy."""
+        return (self._pressure32 if np.float32 == np.dtype(dtype) else self.pressure).reshape(1, -1)
+
+
+# -------------------------------------------------------------------------------------------------
+# thermodynamic functions
+# -------------------------------------------------------------------------------------------------
+cdef inline floating fexp(floating x) noexcept nogil:
+    if floating is float:
+        return expf(x)
+    else:
+        return exp(x)
+
+
+cdef inline floating flog(floating x) noexcept nogil:
+    if floating is float:
+        return logf(x)
+    else:
+        return log(x)
+
+
+cdef inline floating fpow(floating x, floating y) noexcept nogil:
+    if floating is float:
+        return powf(x, y)
+    else:
+        return pow(x, y)
+
+
+cdef floating saturation_vapor_pressure(floating temperature) noexcept nogil:
+    return <floating> E0 * fexp(
+        <floating> 17.67 * (temperature - <floating> T0) / (temperature - <floating> 29.65)
+    )
+
+
+cdef floating saturation_mixing_ratio(floating pressure, floating temperature) noexcept nogil:
+    cdef floating P
+    P = saturation_vapor_pressure(temperature)
+    return <floating> 0.6219 * P / (pressure - P)
+
+
+cdef floating vapor_pressure(floating pressure, floating mixing_ratio) noexcept nogil:
+    return pressure * mixing_ratio / (<floating> (Rd / Rv) + mixing_ratio)
+
+
+cdef floating _dewpoint(floating vapor_pressure) noexcept nogil:
+    cdef floating ln
+    ln = flog(vapor_pressure / <floating> E0)
+    return <floating> T0 + <floating> 243.5 * ln / (<floating> 17.67 - ln)
+
+
+cdef floating mixing_ratio(
+    floating partial_press, floating total_press, floating molecular_weight_ratio = Rd / Rv
+) noexcept nogil:
+    return molecular_weight_ratio * partial_press / (total_press - partial_press)
+
+
+cdef floating virtual_temperature(floating temperature, floating mixing_ratio) noexcept nogil:
+    cdef floating eps = <floating> epsilon
+    return temperature * ((mixing_ratio + eps) / (eps * (1 + mixing_ratio)))
+
+
+cdef floating potential_temperature(floating pressure, floating temperature) noexcept nogil:
+    return temperature / fpow(pressure / <floating> P0, <floating> (Rd / Cpd))
+
+
+cdef floating equivalent_potential_temperature(
+    floating pressure, floating temperature, floating dewpoint
+) noexcept nogil:
+    cdef floating r, e, t_l, th_l
+
+    r = saturation_mixing_ratio(pressure, dewpoint)
+    e = saturation_vapor_pressure(dewpoint)
+    t_l = 56 + 1 / (1 / (dewpoint - 56) + flog(temperature / dewpoint) / 800)
+    th_l = potential_temperature(pressure - e, temperature) * fpow(temperature / t_l, <floating> 0.28 * r)
+    return th_l * fexp(r * (1 + <floating> 0.448 * r) * (3036 / t_l - <floating> 1.78))
+
+
+# -------------------------------------------------------------------------------------------------
+# element-wise thermodynamics
+# -------------------------------------------------------------------------------------------------
+# the kernel and the number of array arguments of each function
+cdef dict ELEMENTWISE_FUNCTIONS = {
+    "saturation_vapor_pressure": (SATURATION_VAPOR_PRESSURE, 1),
+    "vapor_pressure": (VAPOR_PRESSURE, 2),
+    "dewpoint": (DEWPOINT, 1),
+    "mixing_ratio": (MIXING_RATIO, 2),
+    "saturation_mixing_ratio": (SATURATION_MIXING_RATIO, 2),
+    "virtual_temperature": (VIRTUAL_TEMPERATURE, 2),
+    "potential_temperature": (POTENTIAL_TEMPERATURE, 2),
+    "equivalent_potential_temperature": (EQUIVALENT_POTENTIAL_TEMPERATURE, 3),
+}
+
+
+cdef inline void _elementwise_row(
+    floating[:, :] out,
+    const floating[:, :] a,
+    const floating[:, :] b,
+    const floating[:, :] c,
+    floating ratio,
+    ElementwiseKind kind,
+    size_t i,
+) noexcept nogil:
+    cdef size_t K, j
+    cdef floating e
+
+    K = out.shape[1]
+    if SATURATION_VAPOR_PRESSURE is kind:
+        for j in range(K):
+            out[i, j] = saturation_vapor_pressure(a[i, j])
+    elif VAPOR_PRESSURE is kind:
+        for j in range(K):
+            out[i, j] = a[i, j] * b[i, j] / (ratio + b[i, j])
+    elif DEWPOINT is kind:
+        for j in range(K):
+            e = a[i, j]
+            out[i, j] = _dewpoint(e) if e > 0 else <floating> nan
+    elif MIXING_RATIO is kind:
+        for j in range(K):
+            out[i, j] = mixing_ratio(a[i, j], b[i, j], ratio)
+    elif SATURATION_MIXING_RATIO is kind:
+        for j in range(K):
+            out[i, j] = mixing_ratio(saturation_vapor_pressure(b[i, j]), a[i, j], ratio)
+    elif VIRTUAL_TEMPERATURE is kind:
+        for j in range(K):
+            out[i, j] = a[i, j] * ((b[i, j] + ratio) / (ratio * (1 + b[i, j])))
+    elif POTENTIAL_TEMPERATURE is kind:
+        for j in range(K):
+            out[i, j] = potential_temperature(a[i, j], b[i, j])
+    else: # EQUIVALENT_POTENTIAL_TEMPERATURE
+        for j in range(K):
+            out[i, j] = equivalent_potential_temperature(a[i, j], b[i, j], c[i, j])
+
+
+cdef void _elementwise(
+    floating[:, :] out,
+    const floating[:, :] a,
+    const floating[:, :] b,
+    const floating[:, :] c,
+    floating ratio,
+    ElementwiseKind kind,
+) noexcept nogil:
+    """``out[i, j] = f(a[i, j], b[i, j], c[i, j])``, the unused arguments alias ``a``."""
+    cdef size_t M, i
+
+    M = out.shape[0]
+    if nzt_get_serial():
+        for i in range(M):
+            _elementwise_row(out, a, b, c, ratio, kind, i)
+        return
+
+    with nogil, parallel():
+        for i in prange(M, schedule='runtime'):
+            _elementwise_row(out, a, b, c, ratio, kind, i)
+
+
+def elementwise(
+    str function,
+    *args,
+    object ratio = None,
+    object threads = None,
+    object dtype = None,
+    np.ndarray out = None,
+):
+    """
+    args of any broadcastable shape
+
+    Evaluate one of the element-wise thermodynamic ``function``s in a single fused pass over the
+    broadcast of ``args``, without the temporaries of the equivalent numpy expression:
+
+    - ``"saturation_vapor_pressure"`` (temperature)
+    - ``"vapor_pressure"`` (pressure, mixing_ratio)
+    - ``"dewpoint"`` (vapor_pressure), nan where the vapor pressure is not positive
+    - ``"mixing_ratio"`` (partial_pressure, total_pressure)
+    - ``"saturation_mixing_ratio"`` (pressure, temperature)
+    - ``"virtual_temperature"`` (temperature, mixing_ratio)
+    - ``"potential_temperature"`` (pressure, temperature)
+    - ``"equivalent_potential_temperature"`` (pressure, temperature, dewpoint)
+
+    ``ratio`` is the molecular weight ratio of the mixing ratio functions. The result has the
+    common floating dtype of the array arguments unless ``dtype`` or ``out`` is given, ``out``
+    must have the broadcast shape and may be one of the arguments. The arguments are viewed as
+    ``(M, K)``, the broadcast shape with the leading dimensions collapsed, so that broadcast
+    arguments are read through zero strides instead of being copied.
+    """
+    cdef size_t M, K
+    cdef bint strided
+    cdef np.ndarray x, buffer
+    cdef ElementwiseKind kind
+
+    if function not in ELEMENTWISE_FUNCTIONS:
+        raise ValueError(f"function must be one of {tuple(ELEMENTWISE_FUNCTIONS)}, got {function!r}.")
+    kind, nargs = ELEMENTWISE_FUNCTIONS[function]
+    if len(args) != nargs:
+        raise ValueError(f"{function} takes {nargs} array arguments, got {len(args)}.")
+
+    # python scalars do not take part in the promotion, as with numpy
+    dtypes = [
+        arg.dtype
+        for arg in args
+        if isinstance(arg, (np.ndarray, np.generic)) and np.issubdtype(arg.dtype, np.floating)
+    ]
+    args = tuple(np.asarray(arg) for arg in args)
+    shape = np.broadcast_shapes(*((<object> arg).shape for arg in args))
+    if dtype is None and out is None:
+        dtype = np.result_type(*dtypes) if dtypes else np.dtype(np.float64)
+    else:
+        dtype = np.dtype(dtype if dtype is not None else out.dtype)
+    dtype = np.dtype(np.float32 if np.float32 == dtype else np.float64)
+
+    if ratio is None:
+        ratio = epsilon
+
+    if len(shape) == 0:
+        M, K = 1, 1
+    elif len(shape) == 1:
+        M, K = shape[0], 1
+    else:
+        M, K = int(np.prod(shape[:-1])), shape[-1]
+    args = tuple(np.broadcast_to(arg.astype(dtype, copy=False), shape).reshape(M, K) for arg in args)
+    a, b, c = args[0], args[1 % nargs], args[2 % nargs]
+
+    x = _output_array(out, shape, dtype)
+    # a strided ``out`` is written through a contiguous buffer
+    strided = not x.flags.c_contiguous
+    buffer = np.empty((M, K), dtype=dtype) if strided else x.reshape(M, K)
+    with _Parallel(threads, M, K):
+        if np.float32 == dtype:
+            _elementwise[float](buffer, a, b, c, <float> ratio, kind)
+        else:
+            _elementwise[double](buffer, a, b, c, <double> ratio, kind)
+    if strided:
+        x[...] = buffer.reshape(shape)
+
+    return x
+
+
+# -------------------------------------------------------------------------------------------------
+# moist_lapse
+# -------------------------------------------------------------------------------------------------
+cdef floating moist_lapse_solver(floating pressure, floating temperature) noexcept nogil:
+    cdef floating r, rd, lv
+    rd = <floating> Rd
+    lv = <floating> Lv
+    r = saturation_mixing_ratio(pressure, temperature)
+    r = (rd * temperature + lv * r) / (
+        <floating> Cpd + (lv * lv * r * <floating> epsilon / (rd * temperature * temperature))
+    )
+    r /= pressure
+    return r
+
+
+cdef floating moist_lapse_integrator(
+    floating pressure, floating next_pressure, floating temperature, floating step
+) noexcept nogil:
+    """``2nd order Runge-Kutta (RK2)``
+
+    Integrate the moist lapse rate ODE, using a RK2 method, from an initial pressure lvl
+    to a final one.
+    """
+    cdef int N
+    cdef floating delta, abs_delta, k1
+
+    N = 1
+    delta = next_pressure - pressure
+    if (abs_delta := abs(delta)) > step:
+        N =  <int> ceil(abs_delta / step)
+        delta = delta / <floating> N
+
+    nzt_diag_solver(2 * N)
+    for _ in range(N):
+        k1 = delta * moist_lapse_solver(pressure, temperature)
+        temperature += delta * moist_lapse_solver(
+            pressure + delta * <floating> 0.5, temperature + k1 * <floating> 0.5
+        )
+        pressure += delta
+
+    return temperature
+
+
+cdef floating moist_lapse_adaptive_integrator(
+    floating pressure,
+    floating next_pressure,
+    floating temperature,
+    floating step,
+    floating rtol,
+    floating* accepted = NULL,
+) noexcept nogil:
+    """``Dormand-Prince RK5(4)``
+
+    Integrate the moist lapse rate ODE, using an embedded RK5(4) pair with adaptive step size
+    control, from an initial pressure lvl to a final one. The 5th order solution is propagated and
+    the step size is adapted so that the local error estimate stays within ``rtol`` of the
+    temperature.
+
+    ``accepted`` carries the step size from one level of a column to the next: it is read as the
+    initial step size, ``step`` is used when it is NULL or 0, and the step size proposed after the
+    last accepted step is written back. The final step that is shortened to land on
+    ``next_pressure`` does not shrink the carried step size.
+    """
+    cdef size_t _
+    cdef bint last
+    cdef floating h, dh, k1, k2, k3, k4, k5, k6, k7, t5, err, tol, factor
+
+    if pressure == next_pressure:
+        return temperature
+
+    h = step if accepted == NULL or accepted[0] == 0.0 else accepted[0]
+    if next_pressure < pressure:
+        h = -h
+    k1 = moist_lapse_solver(pressure, temperature)
+    nzt_diag_solver(1)
+    for _ in range(RK45_MAX_STEPS):
+        dh = h
+        if (last := abs(h) >= abs(next_pressure - pressure)):
+            h = next_pressure - pressure
+
+        k2 = moist_lapse_solver(pressure + h * (1.0 / 5.0), temperature + h * (k1 / 5.0))
+        k3 = moist_lapse_solver(
+            pressure + h * (3.0 / 10.0),
+            temperature + h * (3.0 / 40.0 * k1 + 9.0 / 40.0 * k2),
+        )
+        k4 = moist_lapse_solver(
+            pressure + h * (4.0 / 5.0),
+            temperature + h * (44.0 / 45.0 * k1 - 56.0 / 15.0 * k2 + 32.0 / 9.0 * k3),
+        )
+        k5 = moist_lapse_solver(
+            pressure + h * (8.0 / 9.0),
+            temperature + h * (
+                19372.0 / 6561.0 * k1 - 25360.0 / 2187.0 * k2 + 64448.0 / 6561.0 * k3 - 212.0 / 729.0 * k4
+            ),
+        )
+        k6 = moist_lapse_solver(
+            pressure + h,
+            temperature + h * (
+                9017.0 / 3168.0 * k1 - 355.0 / 33.0 * k2 + 46732.0 / 5247.0 * k3 + 49.0 / 176.0 * k4
+                - 5103.0 / 18656.0 * k5
+            ),
+        )
+        t5 = temperature + h * (
+            35.0 / 384.0 * k1 + 500.0 / 1113.0 * k3 + 125.0 / 192.0 * k4 - 2187.0 / 6784.0 * k5 + 11.0 / 84.0 * k6
+        )
+        k7 = moist_lapse_solver(pressure + h, t5) # first same as last
+        nzt_diag_solver(6)
+        err = abs(h * (
+            71.0 / 57600.0 * k1 - 71.0 / 16695.0 * k3 + 71.0 / 1920.0 * k4 - 17253.0 / 339200.0 * k5
+            + 22.0 / 525.0 * k6 - 1.0 / 40.0 * k7
+        ))
+        if isnan(err):
+            return nan
+
+        tol = rtol * fmax(abs(temperature), abs(t5))
+        # the standard step size controller, bounded to avoid wild changes in the step size
+        factor = 5.0 if err == 0.0 else fmin(5.0, fmax(0.2, 0.9 * (tol / err) ** 0.2))
+        if err <= tol: # accept the step
+            if last:
+                if accepted != NULL:
+                    accepted[0] = fmax(abs(dh), abs(h) * factor)
+                return t5
+            pressure += h
+            temperature = t5
+            k1 = k7
+
+        h *= factor
+
+    return nan
+
+
+# .................................................................................................
+# pseudo-adiabat lookup table
+# .................................................................................................
+cdef inline double pseudo_adiabat(const PseudoAdiabats* table, size_t j, double x) noexcept nogil:
+    """Linear interpolation along the j'th pseudo-adiabat at fractional column ``x``."""
+    cdef size_t k
+    cdef const double* row
+
+    k = <size_t> x
+    if k > table.pressure_size - 2:
+        k = table.pressure_size - 2
+    x -= k
+    row = table.data + j * table.pressure_size
+    return row[k] * (1.0 - x) + row[k + 1] * x
+
+
+cdef inline bint pseudo_adiabat_bracket(
+    const PseudoAdiabats* table,
+    double reference_pressure,
+    double temperature,
+    size_t* lo,
+    size_t* hi,
+    double* weight,
+) noexcept nogil:
+    """Locate the parcel between two adjacent pseudo-adiabats at the reference pressure. Returns
+    false if the parcel's reference pressure or temperature is outside of the table."""
+    cdef size_t mid
+    cdef double x, lower, upper
+
+    x = (log(reference_pressure) - table.log_pressure_min) / table.delta_log_pressure
+    if not (0.0 <= x <= table.pressure_size - 1.0):
+        return False
+
+    lo[0] = 0
+    hi[0] = table.theta_size - 1
+    lower = pseudo_adiabat(table, lo[0], x)
+    upper = pseudo_adiabat(table, hi[0], x)
+    if not (lower <= temperature <= upper):
+        return False
+
+    while hi[0] - lo[0] > 1:
+        mid = (lo[0] + hi[0]) // 2
+        if pseudo_adiabat(table, mid, x) <= temperature:
+            lo[0] = mid
+        else:
+            hi[0] = mid
+
+    lower = pseudo_adiabat(table, lo[0], x)
+    upper = pseudo_adiabat(table, hi[0], x)
+    weight[0] = (temperature - lower) / (upper - lower)
+    return True
+
+
+cdef inline double pseudo_adiabat_level(
+    const PseudoAdiabats* table,
+    size_t lo,
+    size_t hi,
+    double weight,
+    double pressure,
+    double next_pressure,
+    double temperature,
+    double step,
+) noexcept nogil:
+    """The temperature at ``next_pressure`` on the bracketed pseudo-adiabat, integrated with the
+    RK2 solver from ``pressure`` when the level is outside of the table."""
+    cdef double x
+
+    x = (log(next_pressure) - table.log_pressure_min) / table.delta_log_pressure
+    if 0.0 <= x <= table.pressure_size - 1.0:
+        return pseudo_adiabat(table, lo, x) * (1.0 - weight) + pseudo_adiabat(table, hi, x) * weight
+
+    return moist_lapse_integrator(pressure, next_pressure, temperature, step)
+
+
+cdef bint pseudo_adiabat_lookup(
+    floating[:] out,
+    const floating[:] pressure,
+    floating reference_pressure,
+    floating temperature,
+    floating step,
+    const PseudoAdiabats* table,
+) noexcept nogil:
+    """Moist ascent by bilinear interpolation in the pseudo-adiabat table.
+
+    The parcel is located between two adjacent pseudo-adiabats at the reference pressure and the
+    same weight is used at every level. Levels outside of the table are integrated with the RK2
+    solver from the previous level. Returns false, without writing to ``out``, if the parcel's
+    reference pressure or temperature is outside of the table.
+    """
+    cdef size_t Z, i, lo, hi
+    cdef double weight, p, t
+
+    if not pseudo_adiabat_bracket(table, reference_pressure, temperature, &lo, &hi, &weight):
+        return False
+
+    Z = pressure.shape[0]
+    p = reference_pressure
+    t = temperature
+    for i in range(Z):
+        if isnan(pressure[i]):
+            out[i] = nan
+            continue
+
+        t = pseudo_adiabat_level(table, lo, hi, weight, p, pressure[i], t, step)
+        p = pressure[i]
+        out[i] = <floating> t
+
+    return True
+
+
+cdef inline void fill_nan(floating[:] out, size_t start, size_t stop) noexcept nogil:
+    cdef size_t i
+
+    for i in range(start, stop):
+        out[i] = nan
+
+
+cdef void moist_lapse_1d_(
+    floating[:] out,
+    const floating[:] pressure,
+    floating reference_pressure,
+    floating temperature,
+    floating step,
+    IntegrationMethod method,
+    floating rtol,
+    const PseudoAdiabats* table,
+    floating top_pressure = 0.0,
+    floating min_temperature = 0.0,
+) noexcept nogil:
+    """Moist adiabatic lapse rate for a 1D array of pressure levels. The column is always serial,
+    this is called from within the ``prange`` over the columns and must not open a parallel region
+    of its own.
+
+    Only the levels ``[start, stop)`` are integrated, ``start`` is the first level that is not nan
+    and ``stop`` the first level above ``top_pressure``. The integration also stops after the first
+    level where the parcel is colder than ``min_temperature``, every level that is not integrated
+    is nan."""
+    cdef size_t Z, i, start, stop
+    cdef floating next_pressure, accepted = 0.0
+
+    Z = pressure.shape[0]
+    if isnan(temperature) or isnan(reference_pressure): # don't bother with the computation
+        for i in range(Z):
+            out[i] = nan
+        return
+
+    # - leading nan levels mask out the levels below the surface (or the lcl) of a column, they
+    # are skipped once so the loop below does not test them level by level
+    start = 0
+    while start < Z and isnan(pressure[start]):
+        out[start] = nan
+        start += 1
+    stop = start
+    while stop < Z and not pressure[stop] < top_pressure:
+        stop += 1
+    for i in range(stop, Z):
+        out[i] = nan
+
+    if TABLE is method and pseudo_adiabat_lookup(
+        out[start:stop], pressure[start:stop], reference_pressure, temperature, step, table
+    ):
+        if min_temperature > 0.0:
+            for i in range(start, stop):
+                if out[i] < min_temperature:
+                    fill_nan(out, i + 1, stop)
+                    break
+        return
+
+    for i in range(start, stop):
+        if isnan(next_pressure := pressure[i]):
+            out[i] = nan
+            continue
+        elif RK45 is method:
+            out[i] = temperature = moist_lapse_adaptive_integrator(
+                reference_pressure, next_pressure, temperature, step=step, rtol=rtol, accepted=&accepted
+            )
+        else: # RK2
+            out[i] = temperature = moist_lapse_integrator(
+                reference_pressure, next_pressure, temperature, step=step
+            )
+        reference_pressure = next_pressure
+
+        if temperature < min_temperature:
+            fill_nan(out, i + 1, stop)
+            return
+
+
+cdef floating moist_lapse_element_(
+    floating pressure,
+    floating reference_pressure,
+    floating temperature,
+    floating step,
+    IntegrationMethod method,
+    floating rtol,
+    const PseudoAdiabats* table,
+    floating top_pressure = 0.0,
+) noexcept nogil:
+    """Moist adiabatic lapse rate from ``reference_pressure`` to a single pressure level, the same
+    result as ``moist_lapse_1d_`` for one level on scalars rather than memoryview slices. The
+    temperature threshold of ``moist_lapse_1d_`` only masks the levels above the first cold one
+    and has no effect on a single level."""
+    cdef size_t lo, hi
+    cdef double weight
+
+    if isnan(temperature) or isnan(reference_pressure) or isnan(pressure) or pressure < top_pressure:
+        return nan
+    elif TABLE is method and pseudo_adiabat_bracket(table, reference_pressure, temperature, &lo, &hi, &weight):
+        return <floating> pseudo_adiabat_level(
+            table, lo, hi, weight, reference_pressure, pressure, temperature, step
+        )
+    elif RK45 is method:
+        return moist_lapse_adaptive_integrator(reference_pressure, pressure, temperature, step=step, rtol=rtol)
+
+    return moist_lapse_integrator(reference_pressure, pressure, temperature, step=step)
+
+
+cdef void moist_lapse_broadcast_(
+    floating[:, :] out,
+    const floating[:] pressure,
+    const floating[:] reference_pressure,
+    const floating[:] temperature,
+    size_t start,
+    floating step,
+    double* block,
+    floating top_pressure,
+    floating min_temperature,
+) noexcept nogil:
+    """Level-major moist adiabatic lapse rate for a block of up to ``NZT_BLOCK`` columns sharing
+    the same ``pressure`` levels.
+
+    Each parcel is lifted from its own reference pressure to the first level, after which the whole
+    block is advanced level by level with the vectorized RK2 kernel in ``_simd.h``. The levels are
+    accumulated in the ``(Z, n)`` double precision ``block`` buffer and transposed into the output
+    rows once the column is complete.
+
+    The levels above ``top_pressure`` are not integrated, and a lane that is colder than
+    ``min_temperature`` is set to nan at the next level so it drops out of the block.
+    """
+    cdef size_t Z, n, i, k, valid, stop
+    cdef double p
+    cdef double* level
+    cdef double* previous = NULL
+
+    Z = pressure.shape[0]
+    n = min(<size_t> NZT_BLOCK, <size_t> temperature.shape[0] - start)
+    if Z == 0:
+        return
+
+    valid = 0
+    stop = 0
+    while stop < Z and not pressure[stop] < top_pressure:
+        stop += 1
+
+    for k in range(Z):
+        level = block + k * n
+        if k >= stop or isnan(pressure[k]):
+            for i in range(n):
+                level[i] = nan
+            continue
+
+        if previous == NULL: # lift each parcel from its reference pressure to the first level
+            valid = 0
+            for i in range(n):
+                if isnan(temperature[start + i]) or isnan(reference_pressure[start + i]):
+                    level[i] = nan
+                else:
+                    valid += 1
+                    level[i] = moist_lapse_integrator(
+                        <double> reference_pressure[start + i],
+                        <double> pressure[k],
+                        <double> temperature[start + i],
+                        <double> step,
+                    )
+        elif valid == 0: # a fully masked block, skip the integration
+            for i in range(n):
+                level[i] = nan
+        else:
+            memcpy(level, previous, n * sizeof(double))
+            if min_temperature > 0.0:
+                valid = 0
+                for i in range(n):
+                    if level[i] < min_temperature:
+                        level[i] = nan
+                    elif not isnan(level[i]):
+                        valid += 1
+            nzt_moist_lapse_lanes(level, n, p, pressure[k], step, &SIMD_CONSTANTS)
+
+        previous = level
+        p = pressure[k]
+
+    if <size_t> out.strides[1] == sizeof(floating):
+        if floating is double:
+            nzt_store_rows_d(&out[start, 0], out.strides[0] // <Py_ssize_t> sizeof(double), block, n, Z)
+        else:
+            nzt_store_rows_f(&out[start, 0], out.strides[0] // <Py_ssize_t> sizeof(float), block, n, Z)
+    else:
+        for i in range(n):
+            for k in range(Z):
+                out[start + i, k] = <floating> block[k * n + i]
+
+
+cdef inline void _moist_lapse_block(
+    floating[:, :] out,
+    const floating[:] pressure,
+    const floating[:] reference_pressure,
+    const floating[:] temperature,
+    floating step,
+    IntegrationMethod method,
+    floating rtol,
+    const PseudoAdiabats* table,
+    floating top_pressure,
+    floating min_temperature,
+    double* block,
+    size_t i,
+) noexcept nogil:
+    """The ``i``'th block of ``NZT_BLOCK`` columns of the ``BROADCAST`` RK2 path. The diagnostics
+    see the block as its first column, the fallback attributes each column on its own."""
+    cdef size_t N, j
+
+    N = temperature.shape[0]
+    nzt_diag_columns(i * NZT_BLOCK, min(N - i * NZT_BLOCK, <size_t> NZT_BLOCK))
+    if block != NULL:
+        moist_lapse_broadcast_(
+            out, pressure, reference_pressure, temperature, i * NZT_BLOCK, step, block,
+            top_pressure, min_temperature
+        )
+    else: # unable to allocate the buffer, fall back to the per-column kernel
+        for j in range(i * NZT_BLOCK, min(N, (i + 1) * NZT_BLOCK)):
+            nzt_diag_columns(j, 0)
+            moist_lapse_1d_(
+                out[j], pressure, reference_pressure[j], temperature[j],
+                step, method, rtol, table, top_pressure, min_temperature
+            )
+
+
+cdef void _moist_lapse_broadcast(
+    floating[:, :] out,
+    const floating[:] pressure,
+    const floating[:] reference_pressure,
+    const floating[:] temperature,
+    floating step,
+    IntegrationMethod method,
+    floating rtol,
+    const PseudoAdiabats* table,
+    floating top_pressure,
+    floating min_temperature,
+):
+    """``(1, Z) (N,) (N,)``, the ``(Z,)`` levels shared by every column are sliced once."""
+    cdef size_t N, Z, i
+    cdef double* block
+
+    N = temperature.shape[0]
+    Z = pressure.shape[0]
+    if nzt_get_serial():
+        with nogil:
+            if RK2 is method:
+                block = <double*> malloc(NZT_BLOCK * Z * sizeof(double))
+                for i in range((N + NZT_BLOCK - 1) // NZT_BLOCK):
+                    _moist_lapse_block(
+                        out, pressure, reference_pressure, temperature, step, method, rtol, table,
+                        top_pressure, min_temperature, block, i
+                    )
+                free(block)
+            else:
+                for i in range(N):
+                    nzt_diag_column(i)
+                    moist_lapse_1d_(
+                        out[i], pressure, reference_pressure[i], temperature[i],
+                        step, method, rtol, table, top_pressure, min_temperature
+                    )
+        return
+
+    with nogil, parallel():
+        if RK2 is method:
+            # the columns share the pressure levels, so blocks of columns are advanced level by
+            # level, each thread reuses its own (Z, NZT_BLOCK) buffer
+            block = <double*> malloc(NZT_BLOCK * Z * sizeof(double))
+            for i in prange((N + NZT_BLOCK - 1) // NZT_BLOCK, schedule='runtime'):
+                _moist_lapse_block(
+                    out, pressure, reference_pressure, temperature, step, method, rtol, table,
+                    top_pressure, min_temperature, block, i
+                )
+            free(block)
+        else:
+            for i in prange(N, schedule='runtime'):
+                nzt_diag_column(i)
+                moist_lapse_1d_(
+                    out[i], pressure, reference_pressure[i], temperature[i],
+                    step, method, rtol, table, top_pressure, min_temperature
+                )
+
+
+cdef void _moist_lapse_matrix(
+    floating[:, :] out,
+    const floating[:, :] pressure,
+    const floating[:] reference_pressure,
+    const floating[:] temperature,
+    floating step,
+    IntegrationMethod method,
+    floating rtol,
+    const PseudoAdiabats* table,
+    floating top_pressure,
+    floating min_temperature,
+):
+    """``(N, Z) (N,) (N,)``"""
+    cdef size_t N, i
+
+    N = temperature.shape[0]
+    if nzt_get_serial():
+        with nogil:
+            for i in range(N):
+                nzt_diag_column(i)
+                moist_lapse_1d_(
+                    out[i], pressure[i, :], reference_pressure[i], temperature[i],
+                    step, method, rtol, table, top_pressure, min_temperature
+                )
+        return
+
+    with nogil, parallel():
+        for i in prange(N, schedule='runtime'):
+            nzt_diag_column(i)
+            moist_lapse_1d_(
+                out[i], pressure[i, :], reference_pressure[i], temperature[i],
+                step, method, rtol, table, top_pressure, min_temperature
+            )
+
+
+cdef void _moist_lapse_element_wise(
+    floating[:] out,
+    const floating[:] pressure,
+    const floating[:] reference_pressure,
+    const floating[:] temperature,
+    floating step,
+    IntegrationMethod method,
+    floating rtol,
+    const PseudoAdiabats* table,
+    floating top_pressure,
+):
+    """``(N,) (N,) (N,)``, every element is computed on scalars without any memoryview slices."""
+    cdef size_t N, i
+
+    N = temperature.shape[0]
+    if nzt_get_serial():
+        with nogil:
+            for i in range(N):
+                nzt_diag_column(i)
+                out[i] = moist_lapse_element_(
+                    pressure[i], reference_pressure[i], temperature[i], step, method, rtol, table, top_pressure
+                )
+        return
+
+    with nogil, parallel():
+        for i in prange(N, schedule='runtime'):
+            nzt_diag_column(i)
+            out[i] = moist_lapse_element_(
+                pressure[i], reference_pressure[i], temperature[i], step, method, rtol, table, top_pressure
+            )
+
+
+cdef void _moist_lapse(
+    floating[:, :] out,
+    const floating[:, :] pressure, 
+    const floating[:] reference_pressure, 
+    const floating[:] temperature, 
+    floating step,
+    BroadcastMode mode,
+    IntegrationMethod method,
+    floating rtol,
+    const PseudoAdiabats* table,
+    floating top_pressure = 0.0,
+    floating min_temperature = 0.0,
+):
+    # the mode is resolved once per call rather than in the parallel region, each mode has its own
+    # kernel with a single parallel region and only the batch dimension is divided between the
+    # threads, the column kernels are serial
+    if BROADCAST is mode:
+        _moist_lapse_broadcast(
+            out, pressure[0, :], reference_pressure, temperature,
+            step, method, rtol, table, top_pressure, min_temperature
+        )
+    elif MATRIX is mode:
+        _moist_lapse_matrix(
+            out, pressure, reference_pressure, temperature,
+            step, method, rtol, table, top_pressure, min_temperature
+        )
+    else: # ELEMENT_WISE
+        _moist_lapse_element_wise(
+            out[:, 0], pressure[:, 0], reference_pressure, temperature,
+            step, method, rtol, table, top_pressure
+        )
+
+
+_PSEUDO_ADIABATS = None
+# the table is built with the GIL released, concurrent first calls wait for a single build
+_PSEUDO_ADIABATS_LOCK = threading.Lock()
+
+
+def _pseudo_adiabat_parameters():
+    """Everything the pseudo-adiabat table depends on, bump ``version`` when the solver changes."""
+    return {
+        "version": 2,
+        "Rd": Rd, "Rv": Rv, "Lv": Lv, "Cpd": Cpd, "epsilon": epsilon, "T0": T0, "E0": E0, "P0": P0,
+        "theta": (TABLE_THETA_MIN, TABLE_THETA_MAX, TABLE_THETA_SIZE),
+        "pressure": (TABLE_PRESSURE_MIN, TABLE_PRESSURE_MAX, TABLE_PRESSURE_SIZE),
+        "step": TABLE_STEP,
+    }
+
+
+def _pseudo_adiabat_cache(parameters=None):
+    """The cache file of the table, keyed on a hash of the constants and grid it was built with so
+    that a table built by a different version or configuration is never loaded."""
+    if parameters is None:
+        parameters = _pseudo_adiabat_parameters()
+    root = os.environ.get("NZTHERMO_CACHE_DIR") or os.path.join(
+        os.environ.get("XDG_CACHE_HOME") or os.path.expanduser("~/.cache"), "nzthermo"
+    )
+    key = hashlib.sha256(repr(sorted(parameters.items())).encode()).hexdigest()[:16]
+    return os.path.join(root, f"pseudo_adiabats_{key}.npy")
+
+
+cdef np.ndarray _pseudo_adiabat_table():
+    """The ``(theta, log(pressure))`` pseudo-adiabat table, built once and cached to disk.
+
+    Each row is the temperature of a saturated parcel lifted from ``P0`` at the wet bulb potential
+    temperature of that row, integrated with the RK2 solver and a ``TABLE_STEP`` Pa sub-step.
+    """
+    global _PSEUDO_ADIABATS
+
+    if _PSEUDO_ADIABATS is not None:
+        return _PSEUDO_ADIABATS
+
+    with _PSEUDO_ADIABATS_LOCK:
+        if _PSEUDO_ADIABATS is None:
+            _PSEUDO_ADIABATS = _build_pseudo_adiabat_table()
+    return _PSEUDO_ADIABATS
+
+
+cdef np.ndarray _build_pseudo_adiabat_table():
+    cdef np.ndarray table, pressure, theta
+
+    shape = (TABLE_THETA_SIZE, TABLE_PRESSURE_SIZE)
+    path = _pseudo_adiabat_cache()
+    try:
+        table = np.load(path)
+        if (<object> table).shape != shape or table.dtype != np.float64:
+            raise ValueError
+    except (OSError, ValueError):
+        theta = np.linspace(TABLE_THETA_MIN, TABLE_THETA_MAX, TABLE_THETA_SIZE)
+        pressure = np.geomspace(TABLE_PRESSURE_MAX, TABLE_PRESSURE_MIN, TABLE_PRESSURE_SIZE)
+        table = np.empty(shape, dtype=np.float64)
+        _moist_lapse[double](
+            table,
+            pressure.reshape(1, -1),
+            np.full(TABLE_THETA_SIZE, P0, dtype=np.float64),
+            theta,
+            step=TABLE_STEP,
+            mode=BROADCAST,
+            method=RK2,
+            rtol=0.0,
+            table=NULL,
+        )
+        # the table is integrated from high to low pressure but stored by increasing log(pressure)
+        table = np.ascontiguousarray(table[:, ::-1])
+        try:
+            os.makedirs(os.path.dirname(path), exist_ok=True)
+            # unique per thread so that concurrent interpreters sharing the cache never interleave writes
+            tmp = f"{path}.{os.getpid()}.{threading.get_ident()}.tmp"
+            with open(tmp, "wb") as f:
+                np.save(f, table)
+            os.replace(tmp, path)
+        except OSError: # a read-only cache is not an error, the table is rebuilt next session
+            pass
+
+    table.setflags(write=False)
+    return table
+
+
+def moist_lapse(
+    object pressure,
+    np.ndarray temperature,
+    np.ndarray reference_pressure = None,
+    *,
+    floating step = 1000.0,
+    object threads = None,
+    object dtype = None,
+    np.ndarray out = None,
+    str method = "rk2",
+    floating rtol = 1e-5,
+    double top_pressure = 0.0,
+    double min_temperature = 0.0,
+):
+    """
+    pressure shape ``(N,) | (Z,) | (1, Z) | (N, Z)`` or a ``PressureGrid``
+
+    This function attempts to automaticly resolve the broadcast mode. If all 3 arrays have the same
+    shape, and you want to broadcast ``N x Z`` reshape the ``pressure`` array to ``(1, Z)``,
+    otherwise the function will execute element-wise.
+
+    >>> import numpy as np
+    >>> import nzthermo as nzt
+    >>> pressure = np.linspace(100000, 31000, 20)
+    >>> temperature = np.random.uniform(300, 220, 20)
+    >>> refrence_pressures = np.random.uniform(1001325, 100001, 20)
+    >>> nzt.moist_lapse(pressure, temperature, refrence_pressures)
+    array([136.21, 193.77, 154.62, ..., 112.51, 155.1 , 119.41])
+    >>> nzt.moist_lapse(pressure[np.newaxis, :], temperature, refrence_pressures)
+    array([[136.21, 134.78, 133.31, ..., 103.52, 100.61,  97.47],
+           [195.83, 193.77, 191.66, ..., 148.83, 144.65, 140.14],
+           [157.99, 156.33, 154.62, ..., 120.07, 116.7 , 113.06],
+           ...,
+           [148.05, 146.49, 144.89, ..., 112.51, 109.35, 105.94],
+           [209.97, 207.76, 205.5 , ..., 159.58, 155.1 , 150.27],
+           [166.86, 165.11, 163.31, ..., 126.81, 123.25, 119.41]])
+
+
+    If ``reference_pressure`` is not provided and the pressure array is 2D, the reference pressure
+    will be determined by finding the first non-nan value in each row.
+
+    >>> pressure = np.array([
+        [1013.12, 1000, 975, 950, 925, 900, ...],
+        [1013.93, 1000, 975, 950, 925, 900, ...],
+        [np.nan, np.nan, 975, 950, 925, 900, ...]
+    ]) * 100.0 # (N, Z) :: pressure profile
+    >>> reference_pressure = pressure[np.arange(len(pressure)), np.argmin(np.isnan(pressure), axis=1)]
+    >>> reference_pressure
+    array([101312., 101393.,  97500.  ])
+
+    The results are written directly into ``out`` when it is provided, otherwise a single output
+    array is allocated. ``out`` must have the shape of the result, ``(N,)`` for element-wise and
+    ``(N, Z)`` otherwise, and its dtype is used when ``dtype`` is not provided.
+
+    >>> out = np.empty((20, 20), dtype=np.float64)
+    >>> nzt.moist_lapse(pressure[np.newaxis, :], temperature, refrence_pressures, out=out) is out
+    True
+
+    Inputs that already have the requested dtype are passed to the kernel without a copy. The
+    kernel operates on strided memoryviews, so model output stored as ``(Z, N)`` can be passed as
+    ``pressure.T`` without first being made contiguous.
+
+    The integration ``method`` is either ``"rk2"``, a fixed step 2nd order Runge-Kutta with
+    sub-steps of at most ``step`` Pa, or ``"rk45"``, an adaptive Dormand-Prince RK5(4) pair that
+    starts from ``step`` and adapts the step size to keep the local error within ``rtol``. The
+    accepted step size is carried from one level of a column to the next, so ``step`` only sets the
+    first step of each column. The adaptive method takes far fewer steps where the lapse rate is
+    nearly dry.
+
+    >>> nzt.moist_lapse(pressure[np.newaxis, :], temperature, refrence_pressures, method="rk45", rtol=1e-6)
+
+    The ``"table"`` method replaces the ODE solve with a bilinear lookup in a precomputed table of
+    pseudo-adiabats, 261 wet bulb potential temperatures from 200 to 330 K by 512 levels evenly
+    spaced in ``log(p)`` from 10 to 1100 hPa. The table is integrated with a 100 Pa step, built on
+    first use and cached to ``$NZTHERMO_CACHE_DIR`` (default ``~/.cache/nzthermo``). The bilinear
+    interpolation error is bounded by ``(dθ² max|∂²T/∂θ²| + d(ln p)² max|∂²T/∂(ln p)²|) / 8``,
+    which over this grid stays below 0.01 K of a finely stepped solution; the difference against
+    the default ``"rk2"`` path is dominated by the 1000 Pa RK2 step error and is below 0.1 K.
+    Parcels outside of the table and levels outside of its pressure range fall back to ``"rk2"``.
+
+    The integration can be stopped early, for products that only need the parcel up to a target
+    level. Levels above ``top_pressure`` (Pa) are not integrated, and each parcel stops after the
+    first level where it is colder than ``min_temperature`` (K). Both are off by default, the
+    levels that are not integrated are nan. Leading nan levels of a column are skipped before the
+    integration starts.
+
+    >>> nzt.moist_lapse(pressure[np.newaxis, :], temperature, refrence_pressures, top_pressure=50000.0)
+
+    """
+    cdef size_t N, Z, ndim
+    cdef np.ndarray x
+    cdef BroadcastMode mode
+    cdef IntegrationMethod integration_method
+    cdef PseudoAdiabats table
+    cdef const double[:, ::1] table_view
+
+    if method == "rk2":
+        integration_method = RK2
+    elif method == "rk45":
+        integration_method = RK45
+    elif method == "table":
+        integration_method = TABLE
+        table_view = _pseudo_adiabat_table()
+        table.data = &table_view[0, 0]
+        table.theta_size = table_view.shape[0]
+        table.pressure_size = table_view.shape[1]
+        table.log_pressure_min = log(TABLE_PRESSURE_MIN)
+        table.delta_log_pressure = (
+            (log(TABLE_PRESSURE_MAX) - log(TABLE_PRESSURE_MIN)) / (TABLE_PRESSURE_SIZE - 1)
+        )
+    else:
+        raise ValueError(f"method must be one of 'rk2', 'rk45' or 'table', got {method!r}.")
+
+    if isinstance(pressure, PressureGrid):
+        # the levels of a grid are shared by every column, so it is always the broadcast mode
+        if dtype is None and out is None:
+            dtype = temperature.dtype
+        pressure = (<PressureGrid> pressure)._levels(dtype if dtype is not None else out.dtype)
+
+    if dtype is None:
+        dtype = pressure.dtype if out is None else out.dtype
+    else:
+        dtype = np.dtype(dtype)
+
+    # [ pressure ]
+    if (ndim := pressure.ndim) == 1:
+        pressure = pressure.reshape(1, -1) # (1, Z)
+    elif ndim != 2:
+        raise ValueError("pressure must be 1D or 2D array.")
+
+    # [ temperature ]
+    temperature = temperature.reshape(-1)  # (N,)
+    if not (N := temperature.shape[0]):
+        # no columns, the empty result is still validated against or written to ``out``
+        if ndim == 1 and pressure.size == 0 and reference_pressure is not None:
+            return _output_array(out, (0,), dtype)  # (N,) (N,) (N,)
+        return _output_array(out, (0, pressure.shape[1]), dtype)
+
+    # [ reference_pressure ]
+    if reference_pressure is not None:
+        reference_pressure = reference_pressure.reshape(-1)
+        if (
+            ndim == <size_t> temperature.ndim == <size_t> reference_pressure.ndim
+            and pressure.size == temperature.size == reference_pressure.size
+        ):
+            mode = ELEMENT_WISE  # (N,) (N,) (N,)
+            pressure = pressure.reshape(N, 1)
+        elif N != <size_t> reference_pressure.shape[0]:
+            raise ValueError("reference_pressure and temperature arrays must be the same size.")
+        elif 1 == <size_t> pressure.shape[0]:
+            mode = BROADCAST    # (1, Z) (N,) (N,)
+        elif N == <size_t> pressure.shape[0]:
+            mode = MATRIX       # (N, Z) (N,) (N,)
+        else:
+            raise ValueError("Unable to determine the broadcast mode.")
+    # no reference_pressure provided can only be MATRIX or BROADCAST
+    elif 2 == ndim and N == <size_t> pressure.shape[0]:
+        mode = MATRIX           # (N, Z) (N,)
+        reference_pressure = pressure[np.arange(N), np.argmin(np.isnan(pressure), axis=1)]
+    elif 1 == pressure.shape[0]:
+        mode = BROADCAST        # (1, Z) (N,)
+        reference_pressure = np.repeat(pressure[0, np.argmin(np.isnan(pressure[0]))], N)
+    else:
+        raise ValueError("Unable to determine the broadcast mode.")
+
+    Z = pressure.shape[1]
+
+    if mode == ELEMENT_WISE:
+        x = _output_array(out, (N,), dtype)
+    else:
+        x = _output_array(out, (N, Z), dtype)
+
+    # the BROADCAST RK2 path divides blocks of NZT_BLOCK columns between the threads
+    block = NZT_BLOCK if BROADCAST is mode and RK2 is integration_method else 1
+    with _Parallel(threads, N, Z, block):
+        if np.float32 == dtype:
+            _moist_lapse[float](
+                x.reshape(N, Z),
+                pressure.astype(np.float32, copy=False), 
+                reference_pressure.astype(np.float32, copy=False),
+                temperature.astype(np.float32, copy=False), 
+                step=step,
+                mode=mode,
+                method=integration_method,
+                rtol=rtol,
+                table=&table,
+                top_pressure=top_pressure,
+                min_temperature=min_temperature,
+            )
+        else:
+            _moist_lapse[double](
+                x.reshape(N, Z),
+                pressure.astype(np.float64, copy=False),
+                reference_pressure.astype(np.float64, copy=False),
+                temperature.astype(np.float64, copy=False),
+                step=step,
+                mode=mode,
+                method=integration_method,
+                rtol=rtol,
+                table=&table,
+                top_pressure=top_pressure,
+                min_temperature=min_temperature,
+            )
+
+    return x
+
+# -------------------------------------------------------------------------------------------------
+# lcl
+# -------------------------------------------------------------------------------------------------
+cdef floating lcl_solver(
+    floating pressure, floating reference_pressure, floating temperature, floating mixing_ratio
+) noexcept nogil:
+    cdef floating Td, P
+
+    Td = _dewpoint(vapor_pressure(pressure, mixing_ratio))
+    if isnan(P := reference_pressure * fpow(Td / temperature, <floating> (Cpd / Rd))):
+        return pressure
+
+    return P
+
+
+cdef floating lcl_integrator(
+    floating pressure, floating temperature, floating mixing_ratio, size_t max_iters, floating eps
+) noexcept nogil:
+    cdef size_t N, i
+    cdef floating p0, p1, p2, delta, err
+
+    p0 = pressure
+    for i in range(max_iters):
+        p1 = lcl_solver(p0, pressure, temperature, mixing_ratio)
+        p2 = lcl_solver(p1, pressure, temperature, mixing_ratio)
+
+        if (delta := p2 - 2.0 * p1 + p0):
+            p2 = p0 - (p1 - p0) ** 2 / delta    # delta squared
+
+        err = abs((p2 - p0) / p0) if p0 else p2 # absolute relative error
+
+        if err < eps:
+            nzt_diag_lcl(i + 1, True)
+            return p2
+
+        p0 = p2
+
+    if NZT_DIAGNOSTICS and not isnan(pressure + temperature + mixing_ratio):
+        nzt_diag_lcl(max_iters, False)
+    return nan
+
+
+# Romps (2017) uses its own set of thermodynamic constants, which are kept here so that the
+# results match the reference implementation from the paper.
+cdef:
+    double ROMPS_T_TRIP = 273.16     # (K) triple point temperature
+    double ROMPS_P_TRIP = 611.65     # (Pa) triple point vapor pressure
+    double ROMPS_E0V = 2.3740e6      # (J/kg) internal energy difference between vapor and liquid
+    double ROMPS_RGASA = 287.04      # (J/kg/K) dry air gas constant
+    double ROMPS_RGASV = 461.0       # (J/kg/K) water vapor gas constant
+    double ROMPS_CVA = 719.0         # (J/kg/K) dry air isochoric specific heat
+    double ROMPS_CVV = 1418.0        # (J/kg/K) water vapor isochoric specific heat
+    double ROMPS_CVL = 4119.0        # (J/kg/K) liquid water isochoric specific heat
+
+
+cdef inline double lambert_wm1(double x) noexcept nogil:
+    """The lower branch ``W_{-1}`` of the Lambert W function for ``x`` close to ``0-``.
+
+    Starts from the asymptotic expansion ``L1 - L2 + L2 / L1`` and takes a fixed number of Halley
+    iterations, which converges to double precision for ``-0.32 <= x < 0`` without any branching.
+    ``lcl_romps`` calls it with ``-0.22 < x < -0.02`` for parcels from 190 to 340 K at any relative
+    humidity down to 1e-4; closer to the branch point at ``-1/e`` more iterations would be needed.
+    """
+    cdef double w, L1, L2, ew, f
+    L1 = log(-x)
+    L2 = log(-L1)
+    w = L1 - L2 + L2 / L1
+    for _ in range(3):
+        ew = exp(w)
+        f = w * ew - x
+        w = w - f / (ew * (w + 1.0) - (w + 2.0) * f / (2.0 * w + 2.0))
+    return w
+
+
+cdef inline void lcl_bolton(
+    floating pressure, floating temperature, floating dewpoint, floating* lcl_p, floating* lcl_t
+) noexcept nogil:
+    """Bolton (1980) eq. 15 for the LCL temperature and a dry adiabat for the LCL pressure."""
+    lcl_t[0] = 56 + 1 / (1 / (dewpoint - 56) + flog(temperature / dewpoint) / 800)
+    lcl_p[0] = pressure * fpow(lcl_t[0] / temperature, <floating> (Cpd / Rd))
+
+
+cdef inline void lcl_romps(
+    floating pressure, floating temperature, floating dewpoint, floating* lcl_p, floating* lcl_t
+) noexcept nogil:
+    """Romps (2017) exact analytic LCL in terms of the ``W_{-1}`` branch of the Lambert W function."""
+    cdef double cpa, cpv, e, q, cpm, Rm, rh, a, b, c, T, Tl
+
+    T = temperature
+    cpa = ROMPS_CVA + ROMPS_RGASA
+    cpv = ROMPS_CVV + ROMPS_RGASV
+    # specific humidity and the moist air heat capacity and gas constant
+    e = saturation_vapor_pressure(<double> dewpoint)
+    q = epsilon * e / (pressure - (1.0 - epsilon) * e)
+    cpm = (1.0 - q) * cpa + q * cpv
+    Rm = (1.0 - q) * ROMPS_RGASA + q * ROMPS_RGASV
+    # relative humidity with respect to liquid, using the saturation vapor pressure from the paper
+    rh = fmin(1.0, exp(
+        (cpv - ROMPS_CVL) / ROMPS_RGASV * log(dewpoint / T)
+        + (ROMPS_E0V - (ROMPS_CVV - ROMPS_CVL) * ROMPS_T_TRIP) / ROMPS_RGASV * (1.0 / T - 1.0 / dewpoint)
+    ))
+
+    a = cpm / Rm + (ROMPS_CVL - cpv) / ROMPS_RGASV
+    b = -(ROMPS_E0V - (ROMPS_CVV - ROMPS_CVL) * ROMPS_T_TRIP) / (ROMPS_RGASV * T)
+    c = b / a
+    Tl = c / lambert_wm1(rh ** (1.0 / a) * c * exp(c)) * T
+    lcl_t[0] = <floating> Tl
+    lcl_p[0] = <floating> (pressure * (Tl / T) ** (cpm / Rm))
+
+
+cdef inline void lcl_element_(
+    floating[:, :] out,
+    const floating[:] pressure,
+    const floating[:] temperature,
+    const floating[:] dewpoint,
+    size_t max_iters,
+    floating eps,
+    LCLMethod method,
+    size_t i,
+) noexcept nogil:
+    cdef floating P, lcl_p, r
+
+    if BOLTON is method:
+        lcl_bolton(pressure[i], temperature[i], dewpoint[i], &out[0, i], &out[1, i])
+    elif ROMPS is method:
+        lcl_romps(pressure[i], temperature[i], dewpoint[i], &out[0, i], &out[1, i])
+    else: # ITERATIVE
+        P = pressure[i]
+        r = mixing_ratio(saturation_vapor_pressure(dewpoint[i]), P)
+        out[0, i] = lcl_p = lcl_integrator(P, temperature[i], r, max_iters, eps=eps)
+        out[1, i] = _dewpoint(vapor_pressure(lcl_p, r))
+
+
+cdef void _lcl(
+    floating[:, :] out,
+    const floating[:] pressure,
+    const floating[:] temperature,
+    const floating[:] dewpoint,
+    size_t max_iters,
+    floating eps,
+    LCLMethod method,
+):
+    cdef size_t N, i
+
+    N = pressure.shape[0]
+    if nzt_get_serial():
+        with nogil:
+            for i in range(N):
+                nzt_diag_column(i)
+                lcl_element_(out, pressure, temperature, dewpoint, max_iters, eps, method, i)
+        return
+
+    with nogil, parallel():
+        if ITERATIVE is method:
+            for i in prange(N, schedule='runtime'):
+                nzt_diag_column(i)
+                lcl_element_(out, pressure, temperature, dewpoint, max_iters, eps, method, i)
+        else: # the closed form methods take the same time for every element
+            for i in prange(N, schedule='static'):
+                lcl_element_(out, pressure, temperature, dewpoint, max_iters, eps, method, i)
+
+
+def lcl(
+    np.ndarray pressure,
+    np.ndarray temperature,
+    np.ndarray dewpoint,
+    *,
+    size_t max_iters = 50,
+    floating eps = 0.1,
+    object threads = None,
+    object dtype = None,
+    np.ndarray out = None,
+    str method = "iterative",
+):
+    """
+    The Lifting Condensation Level (LCL) is the level at which a parcel becomes saturated.
+    It is a reasonable estimate of cloud base height when parcels experience forced ascent.
+    The height difference between this parameter and the LFC is important when determining
+    convection initiation. The smaller the difference between the LCL and the LFC, the more likely
+    deep convection becomes. The LFC-LCL difference is similar to CIN (convective inhibition).
+    LCL heights from approximately 500 m (1600 ft) to 800 m (2600 ft) above ground level are
+    associated with F2 to F5 tornadoes. Low LCL heights and low surface dewpoint depressions
+    (high low level RH) suggest a warm RFD which may play a role in tornado development.
+
+    The LCL pressure and temperature are written into the rows of ``out`` when it is provided,
+    which must be a ``(2, N)`` array.
+
+    The ``method`` is one of:
+
+    - ``"iterative"`` the default, an Aitken accelerated fixed point iteration for the pressure at
+      which the dry adiabat meets the parcel's mixing ratio, matching MetPy.
+    - ``"bolton"`` the closed form LCL temperature of Bolton (1980) eq. 15 and a dry adiabat for the
+      pressure, within about 0.1 K and 0.05% of ``"iterative"`` for surface based parcels.
+    - ``"romps"`` the exact analytic solution of Romps (2017) using the Lambert W function, within
+      about 0.1 K and 0.2% of ``"iterative"``, the difference being the paper's constants and
+      saturation vapor pressure.
+
+    The closed form methods have no iteration or convergence test, ``max_iters`` and ``eps`` are only
+    used by ``"iterative"``.
+    """
+    cdef size_t N
+    cdef np.ndarray x
+    cdef LCLMethod lcl_method
+
+    if method == "iterative":
+        lcl_method = ITERATIVE
+    elif method == "bolton":
+        lcl_method = BOLTON
+    elif method == "romps":
+        lcl_method = ROMPS
+    else:
+        raise ValueError(f"method must be one of 'iterative', 'bolton' or 'romps', got {method!r}.")
+    # reshape rather than ravel so strided 1D inputs are passed to the kernel as views
+    pressure, temperature, dewpoint = (x.reshape(-1) for x in (pressure, temperature, dewpoint))
+    if not pressure.size == temperature.size == dewpoint.size:
+        raise ValueError("pressure, temperature, and dewpoint arrays must be the same size.")
+
+    if dtype is None:
+        dtype = pressure.dtype if out is None else out.dtype
+    else:
+        dtype = np.dtype(dtype)
+    N = pressure.size
+
+    x = _output_array(out, (2, N), dtype)
+    with _Parallel(threads, N, 1):
+        if np.float32 == dtype:
+            _lcl[float](
+                x,
+                pressure.astype(np.float32, copy=False), 
+                temperature.astype(np.float32, copy=False),
+                dewpoint.astype(np.float32, copy=False),
+                max_iters,
+                eps,
+                lcl_method,
+            )
+        else:
+            _lcl[double](
+                x,
+                pressure.astype(np.float64, copy=False),
+                temperature.astype(np.float64, copy=False),
+                dewpoint.astype(np.float64, copy=False),
+                max_iters,
+                eps,
+                lcl_method,
+            )
+
+    return x
+
+
+# -------------------------------------------------------------------------------------------------
+# wet_bulb_temperature
+# -------------------------------------------------------------------------------------------------
+cdef floating wet_bulb_normand(
+    floating pressure, floating temperature, floating dewpoint, floating step, size_t max_iters, floating eps
+) noexcept nogil:
+    """Normand's rule, lift the parcel dry adiabatically to its lcl and descend moist adiabatically
+    back to the starting pressure."""
+    cdef floating r, lcl_p, lcl_t
+
+    r = mixing_ratio(saturation_vapor_pressure(dewpoint), pressure)
+    lcl_p = lcl_integrator(pressure, temperature, r, max_iters, eps)
+    lcl_t = _dewpoint(vapor_pressure(lcl_p, r))
+    return moist_lapse_integrator(lcl_p, pressure, lcl_t, step)
+
+
+cdef floating wet_bulb_stull(floating temperature, floating dewpoint) noexcept nogil:
+    """Stull (2011) empirical fit in relative humidity and temperature, for sea level pressure and
+    ``5% <= rh <= 99%``, ``-20 <= T <= 50 C``, accurate to about 0.3 K in that range."""
+    cdef double t, rh
+
+    t = temperature - T0
+    rh = 100.0 * saturation_vapor_pressure(dewpoint) / saturation_vapor_pressure(temperature)
+    return T0 + (
+        t * atan(0.151977 * (rh + 8.313659) ** 0.5)
+        + atan(t + rh)
+        - atan(rh - 1.676331)
+        + 0.00391838 * rh ** 1.5 * atan(0.023101 * rh)
+        - 4.686035
+    )
+
+
+cdef void _wet_bulb_temperature(
+    floating[:] out,
+    const floating[:] pressure,
+    const floating[:] temperature,
+    const floating[:] dewpoint,
+    floating step,
+    size_t max_iters,
+    floating eps,
+    WetBulbMethod method,
+):
+    cdef size_t N, i
+
+    N = pressure.shape[0]
+    if nzt_get_serial():
+        with nogil:
+            for i in range(N):
+                nzt_diag_column(i)
+                if STULL is method:
+                    out[i] = wet_bulb_stull(temperature[i], dewpoint[i])
+                else: # NORMAND
+                    out[i] = wet_bulb_normand(pressure[i], temperature[i], dewpoint[i], step, max_iters, eps)
+        return
+
+    with nogil, parallel():
+        if STULL is method:
+            for i in prange(N, schedule='static'):
+                out[i] = wet_bulb_stull(temperature[i], dewpoint[i])
+        else: # NORMAND
+            for i in prange(N, schedule='runtime'):
+                nzt_diag_column(i)
+                out[i] = wet_bulb_normand(pressure[i], temperature[i], dewpoint[i], step, max_iters, eps)
+
+
+def wet_bulb_temperature(
+    np.ndarray pressure,
+    np.ndarray temperature,
+    np.ndarray dewpoint,
+    *,
+    str method = "normand",
+    floating step = 1000.0,
+    size_t max_iters = 50,
+    floating eps = 0.1,
+    object threads = None,
+    object dtype = None,
+    np.ndarray out = None,
+):
+    """
+    pressure, temperature and dewpoint of any broadcastable shape
+
+    The wet bulb temperature of each element, computed in a single element-wise pass:
+
+    - ``"normand"`` the lcl and the moist adiabatic descent back to ``pressure`` (Normand's rule),
+      as in MetPy.
+    - ``"stull"`` the closed form fit of Stull (2011), which ignores the pressure and is only valid
+      near sea level for relative humidity between 5% and 99%, about 0.3 K from ``"normand"``.
+
+    The inputs are flattened so that the kernel sees one contiguous ``(N,)`` batch and the result is
+    reshaped to the broadcast shape, ``out`` must have that shape.
+    """
+    cdef size_t N
+    cdef bint strided
+    cdef np.ndarray x, buffer
+    cdef WetBulbMethod wet_bulb_method
+
+    if method == "normand":
+        wet_bulb_method = NORMAND
+    elif method == "stull":
+        wet_bulb_method = STULL
+    else:
+        raise ValueError(f"method must be one of 'normand' or 'stull', got {method!r}.")
+
+    shape = np.broadcast_shapes((<object> pressure).shape, (<object> temperature).shape, (<object> dewpoint).shape)
+    pressure, temperature, dewpoint = (
+        np.broadcast_to(x, shape).reshape(-1) for x in (pressure, temperature, dewpoint)
+    )
+
+    if dtype is None:
+        dtype = temperature.dtype if out is None else out.dtype
+    else:
+        dtype = np.dtype(dtype)
+    N = temperature.size
+
+    x = _output_array(out, shape, dtype)
+    # a strided ``out`` is written through a contiguous buffer, its reshape would be a copy
+    strided = not x.flags.c_contiguous
+    buffer = np.empty(N, dtype=dtype) if strided else x.reshape(-1)
+    with _Parallel(threads, N, 1):
+        if np.float32 == dtype:
+            _wet_bulb_temperature[float](
+                buffer,
+                pressure.astype(np.float32, copy=False),
+                temperature.astype(np.float32, copy=False),
+                dewpoint.astype(np.float32, copy=False),
+                step=step,
+                max_iters=max_iters,
+                eps=eps,
+                method=wet_bulb_method,
+            )
+        else:
+            _wet_bulb_temperature[double](
+                buffer,
+                pressure.astype(np.float64, copy=False),
+                temperature.astype(np.float64, copy=False),
+                dewpoint.astype(np.float64, copy=False),
+                step=step,
+                max_iters=max_iters,
+                eps=eps,
+                method=wet_bulb_method,
+            )
+
+    if strided:
+        x[...] = buffer.reshape(shape)
+
+    return x
+
+
+# -------------------------------------------------------------------------------------------------
+# intersect
+# -------------------------------------------------------------------------------------------------
+cdef inline int sign_code(double value) noexcept nogil:
+    """The sign of ``value`` as ``-1, 0, 1``, or ``2`` for nan which differs from every sign."""
+    if isnan(value):
+        return 2
+    return (value > 0.0) - (value < 0.0)
+
+
+cdef inline void intersect_point(
+    const floating[:] x,
+    const floating[:] a,
+    const floating[:] b,
+    size_t z0,
+    bint log_x,
+    double* out_x,
+    double* out_y,
+) noexcept nogil:
+    """The linear (or log-linear) crossing of ``a`` and ``b`` between ``z0`` and ``z0 + 1``."""
+    cdef size_t z1
+    cdef double x0, x1, d0, d1, value
+
+    z1 = min(z0 + 1, <size_t> x.shape[0] - 1)
+    x0, x1 = x[z0], x[z1]
+    if log_x:
+        x0, x1 = log(x0), log(x1)
+
+    d0 = a[z0] - b[z0]
+    d1 = a[z1] - b[z1]
+    value = (d1 * x0 - d0 * x1) / (d1 - d0)
+    out_y[0] = ((value - x0) / (x1 - x0)) * (a[z1] - a[z0]) + a[z0]
+    out_x[0] = exp(value) if log_x else value
+
+
+cdef void intersect_1d_(
+    floating[:] out,
+    const floating[:] x,
+    const floating[:] a,
+    const floating[:] b,
+    bint log_x,
+) noexcept nogil:
+    """Scan a column once for the levels where the sign of ``a - b`` changes and interpolate the
+    lower and upper crossing, ``out = [lower_x, lower_y, upper_x, upper_y]``.
+
+    The last level counts as a crossing unless ``a > b`` there, and when there are no crossings at
+    all every level does, so that a column without an intersection is extrapolated from its lowest
+    and highest layers. A nan upper crossing falls back to the one before it.
+    """
+    cdef size_t Z, z, first, last, previous, count
+    cdef int s0, s1
+    cdef double px, py
+
+    Z = x.shape[0]
+    count = first = previous = last = 0
+    s0 = sign_code(a[0] - b[0])
+    for z in range(Z):
+        s1 = sign_code(a[z + 1] - b[z + 1]) if z + 1 < Z else 1
+        if s0 != s1 or s0 == 2:
+            if count == 0:
+                first = z
+            previous = last
+            last = z
+            count += 1
+        s0 = s1
+
+    if count == 0: # no crossing, extrapolate from the first and last layers
+        first, previous, last, count = 0, Z - 2, Z - 1, Z
+
+    intersect_point(x, a, b, first, log_x, &px, &py)
+    out[0] = px
+    out[1] = py
+
+    intersect_point(x, a, b, last, log_x, &px, &py)
+    if isnan(px) and count > 1:
+        intersect_point(x, a, b, previous, log_x, &px, &py)
+    out[2] = px
+    out[3] = py
+
+
+cdef void intersections_1d_(
+    floating[:] out_x,
+    floating[:] out_y,
+    const floating[:] x,
+    const floating[:] a,
+    const floating[:] b,
+    bint log_x,
+) noexcept nogil:
+    """The first ``k`` proper crossings of ``a`` and ``b``, between two valid levels, padded with nan."""
+    cdef size_t Z, K, z, n
+    cdef int s0, s1
+    cdef double px, py
+
+    Z = x.shape[0]
+    K = out_x.shape[0]
+    n = 0
+    s0 = sign_code(a[0] - b[0])
+    for z in range(Z - 1):
+        if n == K:
+            break
+        s1 = sign_code(a[z + 1] - b[z + 1])
+        if s0 != 2 and s1 != 2 and s0 != s1 and not (s0 == 0 and z > 0):
+            intersect_point(x, a, b, z, log_x, &px, &py)
+            out_x[n] = px
+            out_y[n] = py
+            n += 1
+        s0 = s1
+
+    for z in range(n, K):
+        out_x[z] = out_y[z] = nan
+
+
+cdef void _intersect(
+    floating[:, :] out,
+    floating[:, :, :] out_k,
+    const floating[:, :] x,
+    const floating[:, :] a,
+    const floating[:, :] b,
+    bint log_x,
+    BroadcastMode mode,
+):
+    cdef size_t N, i, stride
+    cdef bint first_k = out_k is not None
+
+    N = a.shape[0]
+    stride = 0 if BROADCAST is mode else 1  # the BROADCAST columns all read the first row of x
+    if nzt_get_serial():
+        with nogil:
+            for i in range(N):
+                if not first_k:
+                    intersect_1d_(out[:, i], x[i * stride, :], a[i], b[i], log_x)
+                else:
+                    intersections_1d_(out_k[0, i], out_k[1, i], x[i * stride, :], a[i], b[i], log_x)
+        return
+
+    with nogil, parallel():
+        if not first_k:
+            for i in prange(N, schedule='static'):
+                intersect_1d_(out[:, i], x[i * stride, :], a[i], b[i], log_x)
+        else:
+            for i in prange(N, schedule='static'):
+                intersections_1d_(out_k[0, i], out_k[1, i], x[i * stride, :], a[i], b[i], log_x)
+
+
+def intersect(
+    np.ndarray x,
+    np.ndarray a,
+    np.ndarray b,
+    *,
+    bint log_x = False,
+    object k = None,
+    object threads = None,
+    object dtype = None,
+):
+    """
+    x shape ``(Z,) | (1, Z) | (N, Z)``, a and b shape ``(N, Z)``
+
+    Interpolate the points on ``x`` where ``a`` and ``b`` intersect, in ``log(x)`` when ``log_x``
+    is true, with a single scan of each column.
+
+    Returns:
+        ``(4, N)`` array of the ``[lower_x, lower_y, upper_x, upper_y]`` crossings when ``k`` is
+        None, or the ``(2, N, k)`` ``x`` and ``y`` of the first ``k`` crossings padded with nan.
+    """
+    cdef size_t N, Z
+    cdef np.ndarray out, out_k
+
+    if a.ndim == 1:
+        a = a.reshape(1, -1)
+    if b.ndim == 1:
+        b = b.reshape(1, -1)
+    if x.ndim == 1:
+        x = x.reshape(1, -1)
+
+    if a.ndim != 2 or b.ndim != 2 or x.ndim != 2:
+        raise ValueError("x, a and b must be 1D or 2D arrays.")
+    elif (<object> a).shape != (<object> b).shape:
+        raise ValueError("a and b must have the same shape.")
+    N, Z = a.shape[0], a.shape[1]
+    if <size_t> x.shape[1] != Z:
+        raise ValueError("a, b, and x must have the same number of elements along the last axis.")
+    elif x.shape[0] != 1 and <size_t> x.shape[0] != N:
+        raise ValueError("x must have a leading dimension of 1 or N.")
+    elif Z < 2:
+        raise ValueError("at least 2 levels are required.")
+
+    dtype = np.result_type(a.dtype, b.dtype, np.float32) if dtype is None else np.dtype(dtype)
+    if k is None:
+        out, out_k = np.empty((4, N), dtype=dtype), None
+    elif k < 1:
+        raise ValueError("k must be a positive integer.")
+    else:
+        out, out_k = None, np.empty((2, N, k), dtype=dtype)
+
+    with _Parallel(threads, N, Z):
+        if np.float32 == dtype:
+            _intersect[float](
+                out,
+                out_k,
+                x.astype(np.float32, copy=False),
+                a.astype(np.float32, copy=False),
+                b.astype(np.float32, copy=False),
+                log_x,
+                BROADCAST if 1 == x.shape[0] else MATRIX,
+            )
+        else:
+            _intersect[double](
+                out,
+                out_k,
+                x.astype(np.float64, copy=False),
+                a.astype(np.float64, copy=False),
+                b.astype(np.float64, copy=False),
+                log_x,
+                BROADCAST if 1 == x.shape[0] else MATRIX,
+            )
+
+    return out if k is None else out_k
+
+
+# -------------------------------------------------------------------------------------------------
+# interpolate & insert
+# -------------------------------------------------------------------------------------------------
+cdef inline Py_ssize_t bracket(const floating[:] xp, floating x, bint decreasing) noexcept nogil:
+    """Binary search of a monotone ``xp`` for the index ``k`` of the levels ``xp[k], xp[k + 1]``
+    that bracket ``x``, or -1 when ``x`` is nan or outside of ``xp``."""
+    cdef Py_ssize_t lo, hi, mid
+
+    hi = xp.shape[0] - 1
+    if hi < 1 or isnan(x):
+        return -1
+    elif decreasing and (x > xp[0] or x < xp[hi]):
+        return -1
+    elif not decreasing and (x < xp[0] or x > xp[hi]):
+        return -1
+
+    lo = 0
+    while hi - lo > 1:
+        mid = (lo + hi) >> 1
+        if (xp[mid] >= x) if decreasing else (xp[mid] <= x):
+            lo = mid
+        else:
+            hi = mid
+
+    return lo
+
+
+cdef inline void _bracket_row(
+    Py_ssize_t[:] k,
+    floating[:] w,
+    const floating[:] x,
+    const floating[:] xp,
+    bint log_x,
+    bint decreasing,
+    size_t i,
+) noexcept nogil:
+    k[i] = bracket(xp, x[i], decreasing)
+    if k[i] < 0:
+        w[i] = nan
+    elif log_x:
+        w[i] = (flog(x[i]) - flog(xp[k[i]])) / (flog(xp[k[i] + 1]) - flog(xp[k[i]]))
+    else:
+        w[i] = (x[i] - xp[k[i]]) / (xp[k[i] + 1] - xp[k[i]])
+
+
+cdef void _bracket(
+    Py_ssize_t[:] k,
+    floating[:] w,
+    const floating[:] x,
+    const floating[:] xp,
+    bint log_x,
+) noexcept nogil:
+    """The bracketing level ``k`` and interpolation weight ``w`` of each ``x``, shared by every
+    field that is interpolated at ``x``."""
+    cdef size_t N, i
+    cdef bint decreasing
+
+    N = x.shape[0]
+    decreasing = xp[0] > xp[xp.shape[0] - 1]
+    if nzt_get_serial():
+        for i in range(N):
+            _bracket_row(k, w, x, xp, log_x, decreasing, i)
+        return
+
+    with nogil, parallel():
+        for i in prange(N, schedule='runtime'):
+            _bracket_row(k, w, x, xp, log_x, decreasing, i)
+
+
+cdef void _interpolate(
+    floating[:] out,
+    const floating[:, :] fp,
+    const Py_ssize_t[:] k,
+    const floating[:] w,
+) noexcept nogil:
+    """Interpolate a single ``(N, Z)`` field with the brackets of ``_bracket``."""
+    cdef size_t N, i
+
+    N = fp.shape[0]
+    if nzt_get_serial():
+        for i in range(N):
+            out[i] = nan if k[i] < 0 else fp[i, k[i]] + w[i] * (fp[i, k[i] + 1] - fp[i, k[i]])
+        return
+
+    with nogil, parallel():
+        for i in prange(N, schedule='static'):
+            out[i] = nan if k[i] < 0 else fp[i, k[i]] + w[i] * (fp[i, k[i] + 1] - fp[i, k[i]])
+
+
+def interpolate(
+    np.ndarray x,
+    np.ndarray xp,
+    *args,
+    bint log_x = False,
+    object threads = None,
+    object dtype = None,
+):
+    """
+    x shape ``(N,)``, xp shape ``(Z,)`` monotone, args shape ``(N, Z)``
+
+    Interpolate each of ``args`` at ``x``, in ``log(x)`` when ``log_x`` is true. The levels that
+    bracket each ``x`` are found once by binary search and shared by all of the fields, ``x`` that
+    is nan or outside of ``xp`` is nan. The fields are read in place, only those that do not have
+    the result dtype are converted.
+
+    Returns:
+        ``(B, N)`` array of the ``B = len(args)`` interpolated fields.
+    """
+    cdef size_t N, Z, b
+    cdef np.ndarray out, k, w
+
+    if x.ndim != 1 or xp.ndim != 1:
+        raise ValueError("x and xp must be 1D arrays.")
+    elif not args:
+        raise ValueError("at least one field is required.")
+    N, Z = x.shape[0], xp.shape[0]
+
+    args = tuple(np.asarray(fp) for fp in args)
+    for fp in args:
+        if fp.shape != (N, Z):
+            raise ValueError(f"the fields must have shape {(N, Z)}, got {fp.shape}.")
+
+    dtype = np.result_type(x.dtype, *(fp.dtype for fp in args), np.float32) if dtype is None else np.dtype(dtype)
+    out = np.empty((len(args), N), dtype=dtype)
+    if Z == 0:
+        out[...] = np.nan
+        return out
+
+    k = np.empty(N, dtype=np.intp)
+    w = np.empty(N, dtype=dtype)
+    with _Parallel(threads, N, len(args)):
+        if np.float32 == dtype:
+            _bracket[float](k, w, x.astype(np.float32, copy=False), xp.astype(np.float32, copy=False), log_x)
+            for b in range(len(args)):
+                _interpolate[float](out[b], args[b].astype(np.float32, copy=False), k, w)
+        else:
+            _bracket[double](k, w, x.astype(np.float64, copy=False), xp.astype(np.float64, copy=False), log_x)
+            for b in range(len(args)):
+                _interpolate[double](out[b], args[b].astype(np.float64, copy=False), k, w)
+
+    return out
+
+
+cdef inline void _insert_row(
+    floating[:, ::1] out,
+    const floating[:, ::1] arr,
+    const floating[:] values,
+    const floating[:] z,
+    const floating[:] x,
+    bint decreasing,
+    size_t i,
+) noexcept nogil:
+    cdef size_t Z, idx
+    cdef Py_ssize_t k
+
+    Z = arr.shape[1]
+    k = bracket(z, x[i], decreasing)
+    if k >= 0:
+        idx = k + 1
+    elif Z > 0 and ((x[i] > z[0]) if decreasing else (x[i] < z[0])):
+        idx = 0
+    else:
+        idx = Z
+
+    memcpy(&out[i, 0], &arr[i, 0], idx * sizeof(floating))
+    out[i, idx] = values[i]
+    memcpy(&out[i, 0] + idx + 1, &arr[i, 0] + idx, (Z - idx) * sizeof(floating))
+
+
+cdef void _insert(
+    floating[:, ::1] out,
+    const floating[:, ::1] arr,
+    const floating[:] values,
+    const floating[:] z,
+    const floating[:] x,
+) noexcept nogil:
+    """Copy each row of ``arr`` into ``out`` around the new level, which is placed after the levels
+    of ``z`` that bracket ``x``, first when ``x`` is below ``z[0]`` and last otherwise."""
+    cdef size_t N, Z, i
+    cdef bint decreasing
+
+    N = arr.shape[0]
+    Z = arr.shape[1]
+    decreasing = Z > 1 and z[0] > z[Z - 1]
+    if nzt_get_serial():
+        for i in range(N):
+            _insert_row(out, arr, values, z, x, decreasing, i)
+        return
+
+    with nogil, parallel():
+        for i in prange(N, schedule='runtime'):
+            _insert_row(out, arr, values, z, x, decreasing, i)
+
+
+def insert(
+    np.ndarray arr,
+    np.ndarray values,
+    np.ndarray z,
+    np.ndarray x = None,
+    *,
+    object threads = None,
+    object dtype = None,
+):
+    """
+    arr shape ``(N, Z)``, values shape ``(N,)``, z shape ``(Z,)`` monotone, x shape ``(N,)``
+
+    Insert ``values`` into each row of ``arr`` at the position of ``x`` (``values`` by default)
+    along ``z``, found by binary search so that the rows stay sorted on ``z``.
+
+    Returns:
+        ``(N, Z + 1)`` array.
+    """
+    cdef size_t N, Z
+    cdef np.ndarray out
+
+    if x is None:
+        x = values
+    if arr.ndim != 2 or values.ndim != 1 or z.ndim != 1:
+        raise ValueError("arr must be a 2D array, values and z 1D arrays.")
+    N, Z = arr.shape[0], arr.shape[1]
+    if x.ndim == 2 and x.shape[1] == 1:
+        x = x.reshape(-1)
+    if values.shape[0] != <Py_ssize_t> N or x.ndim != 1 or x.shape[0] != <Py_ssize_t> N:
+        raise ValueError(f"values and x must have shape {(N,)}.")
+    elif z.shape[0] != <Py_ssize_t> Z:
+        raise ValueError(f"z must have shape {(Z,)}.")
+
+    dtype = np.result_type(arr.dtype, np.float32) if dtype is None else np.dtype(dtype)
+    out = np.empty((N, Z + 1), dtype=dtype)
+    with _Parallel(threads, N, Z):
+        if np.float32 == dtype:
+            _insert[float](
+                out,
+                np.ascontiguousarray(arr, dtype=np.float32),
+                values.astype(np.float32, copy=False),
+                z.astype(np.float32, copy=False),
+                x.astype(np.float32, copy=False),
+            )
+        else:
+            _insert[double](
+                out,
+                np.ascontiguousarray(arr, dtype=np.float64),
+                values.astype(np.float64, copy=False),
+                z.astype(np.float64, copy=False),
+                x.astype(np.float64, copy=False),
+            )
+
+    return out
+
+
+# -------------------------------------------------------------------------------------------------
+# parcel_profile
+# -------------------------------------------------------------------------------------------------
+cdef void parcel_profile_1d_(
+    floating[:] pressure_out,
+    floating[:] temperature_out,
+    floating[:] parcel_temperature_out,
+    floating[:] dewpoint_out,
+    floating[:] lcl_out,
+    const floating[:] pressure,
+    const floating[:] temperature,
+    const floating[:] dewpoint,
+    floating reference_pressure,
+    floating reference_temperature,
+    floating reference_dewpoint,
+    floating step,
+    size_t max_iters,
+    floating eps,
+    const GridLevels* grid,
+) noexcept nogil:
+    """Lift a parcel dry adiabatically to the LCL and moist adiabatically above it. The LCL is
+    inserted into the profile, so each of the outputs has ``Z + 1`` levels. With a ``grid`` the dry
+    ascent is the potential temperature of the parcel times the cached exner function."""
+    cdef size_t Z, i, k
+    cdef floating r, lcl_p, lcl_t, p, t, weight
+    cdef double theta
+
+    Z = pressure.shape[0]
+    r = mixing_ratio(saturation_vapor_pressure(reference_dewpoint), reference_pressure)
+    lcl_out[0] = lcl_p = lcl_integrator(reference_pressure, reference_temperature, r, max_iters, eps)
+    lcl_out[1] = lcl_t = _dewpoint(vapor_pressure(lcl_p, r))
+
+    # the index of the first level above the lcl, nan levels below it are treated as below the lcl
+    k = 0
+    while k < Z and not pressure[k] < lcl_p:
+        k += 1
+
+    # - dry ascent below the lcl
+    theta = reference_temperature / (<double> reference_pressure / P0) ** (Rd / Cpd) if grid != NULL else nan
+    for i in range(k):
+        pressure_out[i] = p = pressure[i]
+        temperature_out[i] = temperature[i]
+        dewpoint_out[i] = dewpoint[i]
+        if grid != NULL:
+            parcel_temperature_out[i] = <floating> (theta * grid.exner[i])
+        else:
+            parcel_temperature_out[i] = reference_temperature * fpow(p / reference_pressure, <floating> (Rd / Cpd))
+
+    # - insert the lcl, the environment is interpolated linearly in pressure between the two levels
+    # that bracket the lcl and clipped to the nearest level otherwise
+    pressure_out[k] = lcl_p
+    parcel_temperature_out[k] = lcl_t
+    if k == Z:
+        temperature_out[k] = temperature[Z - 1]
+        dewpoint_out[k] = dewpoint[Z - 1]
+    elif k == 0 or isnan(pressure[k - 1]):
+        temperature_out[k] = temperature[k]
+        dewpoint_out[k] = dewpoint[k]
+    else:
+        weight = (lcl_p - pressure[k - 1]) / (pressure[k] - pressure[k - 1])
+        temperature_out[k] = temperature[k - 1] + weight * (temperature[k] - temperature[k - 1])
+        dewpoint_out[k] = dewpoint[k - 1] + weight * (dewpoint[k] - dewpoint[k - 1])
+
+    # - moist ascent above the lcl, starting from the lcl and skipping any nan levels
+    p = lcl_p
+    t = lcl_t
+    for i in range(k, Z):
+        pressure_out[i + 1] = pressure[i]
+        temperature_out[i + 1] = temperature[i]
+        dewpoint_out[i + 1] = dewpoint[i]
+        if isnan(pressure[i]):
+            parcel_temperature_out[i + 1] = nan
+        else:
+            parcel_temperature_out[i + 1] = t = moist_lapse_integrator(p, pressure[i], t, step)
+            p = pressure[i]
+
+
+cdef void _parcel_profile(
+    floating[:, :] pressure_out,
+    floating[:, :] temperature_out,
+    floating[:, :] parcel_temperature_out,
+    floating[:, :] dewpoint_out,
+    floating[:, :] lcl_out,
+    const floating[:, :] pressure,
+    const floating[:, :] temperature,
+    const floating[:, :] dewpoint,
+    const floating[:] reference_pressure,
+    const floating[:] reference_temperature,
+    const floating[:] reference_dewpoint,
+    floating step,
+    size_t max_iters,
+    floating eps,
+    BroadcastMode mode,
+    const GridLevels* grid,
+):
+    cdef size_t N, i, stride
+
+    N = temperature.shape[0]
+    # the BROADCAST columns all read the first row of pressure, the grid only applies to them
+    stride = 0 if BROADCAST is mode else 1
+    if MATRIX is mode:
+        grid = NULL
+    if nzt_get_serial():
+        with nogil:
+            for i in range(N):
+                nzt_diag_column(i)
+                parcel_profile_1d_(
+                    pressure_out[i], temperature_out[i], parcel_temperature_out[i], dewpoint_out[i], lcl_out[:, i],
+                    pressure[i * stride, :], temperature[i], dewpoint[i],
+                    reference_pressure[i], reference_temperature[i], reference_dewpoint[i],
+                    step=step, max_iters=max_iters, eps=eps, grid=grid,
+                )
+        return
+
+    with nogil, parallel():
+        for i in prange(N, schedule='runtime'):
+            nzt_diag_column(i)
+            parcel_profile_1d_(
+                pressure_out[i], temperature_out[i], parcel_temperature_out[i], dewpoint_out[i], lcl_out[:, i],
+                pressure[i * stride, :], temperature[i], dewpoint[i],
+                reference_pressure[i], reference_temperature[i], reference_dewpoint[i],
+                step=step, max_iters=max_iters, eps=eps, grid=grid,
+            )
+
+
+def parcel_profile(
+    object pressure,
+    np.ndarray temperature,
+    np.ndarray dewpoint,
+    np.ndarray reference_pressure = None,
+    np.ndarray reference_temperature = None,
+    np.ndarray reference_dewpoint = None,
+    *,
+    floating step = 1000.0,
+    size_t max_iters = 50,
+    floating eps = 0.1,
+    object threads = None,
+    object dtype = None,
+):
+    """
+    pressure shape ``(Z,) | (1, Z) | (N, Z)`` or a ``PressureGrid``, temperature and dewpoint shape
+    ``(N, Z)``
+
+    Lift a parcel from ``reference_pressure``, ``reference_temperature`` and ``reference_dewpoint``
+    (each of shape ``(N,)``, defaulting to the first level of the profile) in a single pass over
+    each column. The parcel ascends dry adiabatically to the LCL and moist adiabatically above it.
+    The LCL is inserted into the profile, so the profile outputs have the shape ``(N, Z + 1)``.
+
+    Returns:
+        ``(pressure, lcl_pressure, temperature, parcel_temperature, lcl_temperature, dewpoint)``
+        where ``temperature`` and ``dewpoint`` are the environment interpolated to the LCL.
+    """
+    cdef size_t N, Z
+    cdef BroadcastMode mode
+    cdef np.ndarray p_out, t_out, pt_out, td_out, lcl_out
+    cdef PressureGrid grid = pressure if isinstance(pressure, PressureGrid) else None
+
+    if dtype is None:
+        dtype = temperature.dtype
+    else:
+        dtype = np.dtype(dtype)
+    if grid is not None:
+        pressure = grid._levels(dtype)
+
+    pressure, temperature, dewpoint, reference_pressure, reference_temperature, reference_dewpoint = (
+        _parcel_inputs(pressure, temperature, dewpoint, reference_pressure, reference_temperature, reference_dewpoint)
+    )
+    N, Z = temperature.shape[0], temperature.shape[1]
+    mode = BROADCAST if 1 == pressure.shape[0] else MATRIX
+
+    p_out = np.empty((N, Z + 1), dtype=dtype)
+    t_out = np.empty((N, Z + 1), dtype=dtype)
+    pt_out = np.empty((N, Z + 1), dtype=dtype)
+    td_out = np.empty((N, Z + 1), dtype=dtype)
+    lcl_out = np.empty((2, N), dtype=dtype)
+    with _Parallel(threads, N, Z):
+        if np.float32 == dtype:
+            _parcel_profile[float](
+                p_out, t_out, pt_out, td_out, lcl_out,
+                pressure.astype(np.float32, copy=False),
+                temperature.astype(np.float32, copy=False),
+                dewpoint.astype(np.float32, copy=False),
+                reference_pressure.astype(np.float32, copy=False),
+                reference_temperature.astype(np.float32, copy=False),
+                reference_dewpoint.astype(np.float32, copy=False),
+                step=step,
+                max_iters=max_iters,
+                eps=eps,
+                mode=mode,
+                grid=&grid.levels if grid is not None else NULL,
+            )
+        else:
+            _parcel_profile[double](
+                p_out, t_out, pt_out, td_out, lcl_out,
+                pressure.astype(np.float64, copy=False),
+                temperature.astype(np.float64, copy=False),
+                dewpoint.astype(np.float64, copy=False),
+                reference_pressure.astype(np.float64, copy=False),
+                reference_temperature.astype(np.float64, copy=False),
+                reference_dewpoint.astype(np.float64, copy=False),
+                step=step,
+                max_iters=max_iters,
+                eps=eps,
+                mode=mode,
+                grid=&grid.levels if grid is not None else NULL,
+            )
+
+    return p_out, lcl_out[0], t_out, pt_out, lcl_out[1], td_out
+
+
+# -------------------------------------------------------------------------------------------------
+# parcel selection
+# -------------------------------------------------------------------------------------------------
+cdef void mixed_layer_parcel(
+    const floating[:] pressure,
+    const floating[:] temperature,
+    const floating[:] dewpoint,
+    floating depth,
+    floating* parcel_pressure,
+    floating* parcel_temperature,
+    floating* parcel_dewpoint,
+) noexcept nogil:
+    """The pressure weighted mean potential temperature and mixing ratio of the ``depth`` Pa layer
+    above the first valid level, integrated with the trapezoid rule in a single sweep. The top of
+    the layer is interpolated linearly in log pressure."""
+    cdef size_t Z, i
+    cdef bint started
+    cdef floating p, theta, r, p0, p_top, p_prev, theta_prev, r_prev, weight
+    cdef double theta_sum, r_sum
+
+    Z = pressure.shape[0]
+    started = 0
+    p0 = p_top = p_prev = theta_prev = r_prev = nan
+    theta_sum = r_sum = 0.0
+    for i in range(Z):
+        p = pressure[i]
+        if isnan(p) or isnan(temperature[i]) or isnan(dewpoint[i]):
+            continue
+
+        theta = potential_temperature(p, temperature[i])
+        r = saturation_mixing_ratio(p, dewpoint[i])
+        if not started:
+            started = 1
+            p0 = p
+            p_top = p0 - depth
+        else:
+            if p < p_top:
+                weight = flog(p_top / p_prev) / flog(p / p_prev)
+                theta = theta_prev + weight * (theta - theta_prev)
+                r = r_prev + weight * (r - r_prev)
+                p = p_top
+            theta_sum += 0.5 * (theta + theta_prev) * (p_prev - p)
+            r_sum += 0.5 * (r + r_prev) * (p_prev - p)
+        p_prev = p
+        theta_prev = theta
+        r_prev = r
+        if p <= p_top:
+            break
+
+    if not started or p_prev == p0:
+        parcel_pressure[0] = parcel_temperature[0] = parcel_dewpoint[0] = nan
+        return
+
+    # a profile that ends within the layer is averaged over the levels it has
+    parcel_pressure[0] = p0
+    parcel_temperature[0] = <floating> (theta_sum / (p0 - p_prev)) * fpow(p0 / <floating> P0, <floating> (Rd / Cpd))
+    parcel_dewpoint[0] = _dewpoint(vapor_pressure(p0, <floating> (r_sum / (p0 - p_prev))))
+
+
+cdef void most_unstable_parcel(
+    const floating[:] pressure,
+    const floating[:] temperature,
+    const floating[:] dewpoint,
+    floating depth,
+    floating* parcel_pressure,
+    floating* parcel_temperature,
+    floating* parcel_dewpoint,
+) noexcept nogil:
+    """The level of maximum equivalent potential temperature within the ``depth`` Pa layer above the
+    first valid level, nan values are never selected."""
+    cdef size_t Z, i, k
+    cdef floating p, p_top, theta_e, theta_e_max
+
+    Z = pressure.shape[0]
+    k = Z
+    p_top = nan
+    theta_e_max = -inf
+    for i in range(Z):
+        p = pressure[i]
+        if isnan(p) or isnan(temperature[i]) or isnan(dewpoint[i]):
+            continue
+        if isnan(p_top):
+            p_top = p - depth
+        elif p < p_top:
+            break
+
+        theta_e = equivalent_potential_temperature(p, temperature[i], dewpoint[i])
+        if theta_e > theta_e_max:
+            theta_e_max = theta_e
+            k = i
+
+    if k == Z:
+        parcel_pressure[0] = parcel_temperature[0] = parcel_dewpoint[0] = nan
+        return
+
+    parcel_pressure[0] = pressure[k]
+    parcel_temperature[0] = temperature[k]
+    parcel_dewpoint[0] = dewpoint[k]
+
+
+cdef void parcel_1d_(
+    floating[:] out,
+    const floating[:] pressure,
+    const floating[:] temperature,
+    const floating[:] dewpoint,
+    ParcelKind parcel,
+    floating depth,
+) noexcept nogil:
+    cdef floating p, t, td
+
+    if MIXED_LAYER is parcel:
+        mixed_layer_parcel(pressure, temperature, dewpoint, depth, &p, &t, &td)
+    else: # MOST_UNSTABLE
+        most_unstable_parcel(pressure, temperature, dewpoint, depth, &p, &t, &td)
+
+    out[0] = p
+    out[1] = t
+    out[2] = td
+
+
+cdef void _parcel(
+    floating[:, :] out,
+    const floating[:, :] pressure,
+    const floating[:, :] temperature,
+    const floating[:, :] dewpoint,
+    ParcelKind parcel,
+    floating depth,
+    BroadcastMode mode,
+):
+    cdef size_t N, i, stride
+
+    N = temperature.shape[0]
+    stride = 0 if BROADCAST is mode else 1  # the BROADCAST columns all read the first row of pressure
+    if nzt_get_serial():
+        with nogil:
+            for i in range(N):
+                parcel_1d_(out[:, i], pressure[i * stride, :], temperature[i], dewpoint[i], parcel, depth)
+        return
+
+    with nogil, parallel():
+        for i in prange(N, schedule='runtime'):
+            parcel_1d_(out[:, i], pressure[i * stride, :], temperature[i], dewpoint[i], parcel, depth)
+
+
+cdef np.ndarray _select_parcel(
+    np.ndarray pressure,
+    np.ndarray temperature,
+    np.ndarray dewpoint,
+    ParcelKind parcel,
+    double depth,
+    object threads,
+    object dtype,
+    np.ndarray out,
+):
+    cdef size_t N
+    cdef np.ndarray x
+
+    if dtype is None:
+        dtype = temperature.dtype if out is None else out.dtype
+    else:
+        dtype = np.dtype(dtype)
+
+    pressure, temperature, dewpoint = _profile_inputs(pressure, temperature, dewpoint)
+    N = temperature.shape[0]
+
+    x = _output_array(out, (3, N), dtype)
+    with _Parallel(threads, N, temperature.shape[1]):
+        if np.float32 == dtype:
+            _parcel[float](
+                x,
+                pressure.astype(np.float32, copy=False),
+                temperature.astype(np.float32, copy=False),
+                dewpoint.astype(np.float32, copy=False),
+                parcel=parcel,
+                depth=depth,
+                mode=BROADCAST if 1 == pressure.shape[0] else MATRIX,
+            )
+        else:
+            _parcel[double](
+                x,
+                pressure.astype(np.float64, copy=False),
+                temperature.astype(np.float64, copy=False),
+                dewpoint.astype(np.float64, copy=False),
+                parcel=parcel,
+                depth=depth,
+                mode=BROADCAST if 1 == pressure.shape[0] else MATRIX,
+            )
+
+    return x
+
+
+def mixed_parcel(
+    np.ndarray pressure,
+    np.ndarray temperature,
+    np.ndarray dewpoint,
+    *,
+    double depth = 10000.0,
+    object threads = None,
+    object dtype = None,
+    np.ndarray out = None,
+):
+    """
+    pressure shape ``(Z,) | (1, Z) | (N, Z)``, temperature and dewpoint shape ``(N, Z)``
+
+    The mixed layer parcel, from the pressure weighted mean potential temperature and mixing ratio
+    of the lowest ``depth`` Pa of each column. The layer is reduced in a single sweep per column
+    and the parcel starts at the bottom of the layer.
+
+    Returns:
+        ``(3, N)`` array of the parcel ``pressure``, ``temperature`` and ``dewpoint``, which can be
+        passed as the reference parcel of ``cape_cin`` and ``convective_levels``.
+    """
+    return _select_parcel(pressure, temperature, dewpoint, MIXED_LAYER, depth, threads, dtype, out)
+
+
+def most_unstable_parcel(
+    np.ndarray pressure,
+    np.ndarray temperature,
+    np.ndarray dewpoint,
+    *,
+    double depth = 30000.0,
+    object threads = None,
+    object dtype = None,
+    np.ndarray out = None,
+):
+    """
+    pressure shape ``(Z,) | (1, Z) | (N, Z)``, temperature and dewpoint shape ``(N, Z)``
+
+    The most unstable parcel, the level of maximum equivalent potential temperature in the lowest
+    ``depth`` Pa of each column.
+
+    Returns:
+        ``(3, N)`` array of the parcel ``pressure``, ``temperature`` and ``dewpoint``, which can be
+        passed as the reference parcel of ``cape_cin`` and ``convective_levels``.
+    """
+    return _select_parcel(pressure, temperature, dewpoint, MOST_UNSTABLE, depth, threads, dtype, out)
+
+
+# -------------------------------------------------------------------------------------------------
+# cape_cin
+# -------------------------------------------------------------------------------------------------
+cdef struct Crossing:
+    # the log pressure, environment temperature and cumulative areas at a buoyancy crossing
+    bint valid
+    double x
+    double t
+    double area
+    double negative
+
+
+cdef struct Buoyancy:
+    # the log pressure, buoyancy and environment temperature of the previous node, and whether it
+    # was at or above the lcl
+    double x
+    double y
+    double t
+    bint above
+    bint started
+    # the cumulative signed and negative area of the buoyancy with respect to log pressure
+    double area
+    double negative
+    # the level of free convection selected by ``which_lfc`` (bottom or top) and the first, last
+    # and most cape equilibrium levels above it
+    ConvectiveLevel which_lfc
+    Crossing lfc
+    bint lfc_is_lcl
+    Crossing el_first
+    Crossing el_last
+    Crossing el_max
+    # the buoyant layer pair with the most cape, a maximum subarray over the crossings: the start
+    # with the least cumulative area so far and the best (start, end) pair
+    Crossing start_min
+    Crossing start_min_end
+    Crossing best_lfc
+    Crossing best_lfc_end
+    Crossing best_el
+    double best
+    Crossing last_down
+
+
+cdef inline void crossing_set(Crossing* c, double x, double t, double area, double negative) noexcept nogil:
+    c.valid = 1
+    c.x = x
+    c.t = t
+    c.area = area
+    c.negative = negative
+
+
+cdef void buoyancy_init(Buoyancy* b, ConvectiveLevel which_lfc) noexcept nogil:
+    b.x = b.y = b.t = b.area = b.negative = b.best = 0.0
+    b.above = b.started = b.lfc_is_lcl = 0
+    b.which_lfc = which_lfc
+    b.lfc.valid = b.el_first.valid = b.el_last.valid = b.el_max.valid = 0
+    b.start_min.valid = b.start_min_end.valid = b.best_lfc.valid = b.best_lfc_end.valid = 0
+    b.best_el.valid = b.last_down.valid = 0
+
+
+cdef inline void buoyancy_accumulate(Buoyancy* b, double area) noexcept nogil:
+    b.area += area
+    if area < 0.0:
+        b.negative += area
+
+
+cdef void buoyancy_start(Buoyancy* b, double x, double t, bint is_lcl) noexcept nogil:
+    """The parcel becomes buoyant at ``x``, either at the lcl or crossing from negative to positive
+    above it."""
+    if b.which_lfc == TOP or not b.lfc.valid or (b.lfc_is_lcl and not is_lcl):
+        crossing_set(&b.lfc, x, t, b.area, b.negative)
+        b.lfc_is_lcl = is_lcl
+        b.el_first.valid = b.el_last.valid = b.el_max.valid = 0
+
+    if not b.start_min.valid or b.area < b.start_min.area:
+        crossing_set(&b.start_min, x, t, b.area, b.negative)
+        b.start_min_end.valid = 0
+
+
+cdef void buoyancy_end(Buoyancy* b, double x, double t) noexcept nogil:
+    """The parcel crosses from positive to negative buoyancy at ``x``, above a buoyant start."""
+    cdef Crossing c
+
+    crossing_set(&c, x, t, b.area, b.negative)
+    b.last_down = c
+    if b.lfc.valid:
+        b.el_last = c
+        if not b.el_first.valid:
+            b.el_first = c
+        if not b.el_max.valid or c.area > b.el_max.area:
+            b.el_max = c
+
+    if not b.start_min_end.valid:
+        b.start_min_end = c
+    if not b.best_lfc.valid or c.area - b.start_min.area > b.best:
+        b.best = c.area - b.start_min.area
+        b.best_lfc = b.start_min
+        b.best_lfc_end = b.start_min_end
+        b.best_el = c
+
+
+cdef void buoyancy_step(Buoyancy* b, double x, double y, double t, bint above, bint is_lcl) noexcept nogil:
+    """Accumulate the trapezoid between the previous node and ``(x, y)``. Segments that cross zero
+    are split at the interpolated crossing so the positive and negative areas are kept apart.
+
+    The bottom level of free convection is the lcl when the parcel is already buoyant there,
+    otherwise the first crossing from negative to positive above the lcl, and the top one is the
+    last such crossing. The equilibrium levels are the crossings from positive to negative above
+    the level of free convection.
+    """
+    cdef double dx, f, tc
+
+    if b.started:
+        dx = b.x - x # pressure decreases with height, so the trapezoids are positive for y > 0
+        if (b.y > 0.0) != (y > 0.0):
+            f = b.y / (b.y - y)
+            tc = b.t + f * (t - b.t)
+            buoyancy_accumulate(b, 0.5 * b.y * f * dx)
+            if y > 0.0:
+                if b.above:
+                    buoyancy_start(b, b.x + f * (x - b.x), tc, 0)
+            elif b.start_min.valid:
+                buoyancy_end(b, b.x + f * (x - b.x), tc)
+            buoyancy_accumulate(b, 0.5 * y * (1.0 - f) * dx)
+        else:
+            buoyancy_accumulate(b, 0.5 * (b.y + y) * dx)
+    else:
+        b.started = 1
+
+    if is_lcl and y > 0.0 and not b.lfc.valid:
+        buoyancy_start(b, x, t, 1)
+
+    b.x = x
+    b.y = y
+    b.t = t
+    b.above = above
+
+
+cdef void buoyancy_levels(
+    Buoyancy* b, ConvectiveLevel which_el, Crossing* lfc, Crossing* el, double* cape, double* cin
+) noexcept nogil:
+    """Select the level of free convection and equilibrium level once the profile is complete, and
+    integrate the cape between them and the cin below the level of free convection."""
+    cdef double open_layer
+
+    lfc.valid = el.valid = 0
+    if not b.start_min.valid:
+        cape[0] = cin[0] = 0.0
+        return
+
+    if b.which_lfc == MOST_CAPE:
+        # a layer that is still buoyant at the top of the profile has no equilibrium level
+        open_layer = b.area - b.start_min.area if b.y > 0.0 else -inf
+        if not b.best_lfc.valid or open_layer > b.best:
+            lfc[0] = b.start_min
+            el[0] = b.start_min_end if BOTTOM == which_el else b.last_down
+            if MOST_CAPE == which_el or not el.valid or el.x > lfc.x:
+                el.valid = 0
+        else:
+            lfc[0] = b.best_lfc
+            if BOTTOM == which_el:
+                el[0] = b.best_lfc_end
+            elif TOP == which_el:
+                el[0] = b.last_down
+            else:
+                el[0] = b.best_el
+    else:
+        lfc[0] = b.lfc
+        if BOTTOM == which_el:
+            el[0] = b.el_first
+        elif TOP == which_el:
+            el[0] = b.el_last
+        else:
+            el[0] = b.el_max
+
+    cape[0] = (el.area if el.valid else b.area) - lfc.area
+    cin[0] = fmin(lfc.negative, 0.0)
+
+
+cdef struct ParcelTrace:
+    # the lcl of the parcel and the lifted index, the difference between the environment and the
+    # parcel temperature at 500 hPa
+    double lcl_pressure
+    double lcl_temperature
+    double lifted_index
+
+
+cdef bint parcel_buoyancy_1d_(
+    Buoyancy* b,
+    ParcelTrace* trace,
+    const floating[:] pressure,
+    const floating[:] temperature,
+    const floating[:] dewpoint,
+    floating reference_pressure,
+    floating reference_temperature,
+    floating reference_dewpoint,
+    floating step,
+    size_t max_iters,
+    floating eps,
+    bint virtual,
+) noexcept nogil:
+    """Lift a parcel through a 1D profile and feed its buoyancy, the (virtual) temperature difference
+    between the parcel and the environment, to ``b`` on the fly. The parcel, the lcl and the
+    environment are only ever held in registers. Returns false if the parcel can not be lifted.
+
+    When ``trace`` is not null it is filled with the lcl and the lifted index of the same ascent.
+    """
+    cdef size_t Z, i
+    cdef bint lcl_done
+    cdef floating r, lcl_p, lcl_t, p, t, td, p_prev, t_prev, td_prev, p_moist, t_parcel
+    cdef floating weight, t_env, td_env, t_lifted, tv_env, tv_parcel, t_500
+
+    Z = pressure.shape[0]
+    r = mixing_ratio(saturation_vapor_pressure(reference_dewpoint), reference_pressure)
+    lcl_p = lcl_integrator(reference_pressure, reference_temperature, r, max_iters, eps)
+    lcl_t = _dewpoint(vapor_pressure(lcl_p, r))
+    if trace is not NULL:
+        trace.lcl_pressure = lcl_p
+        trace.lcl_temperature = lcl_t
+        trace.lifted_index = nan
+    if isnan(lcl_p) or isnan(reference_temperature):
+        return 0
+
+    lcl_done = reference_pressure <= lcl_p # the parcel is saturated at the reference pressure
+    p_moist = lcl_p
+    t_parcel = lcl_t
+    p_prev = t_prev = td_prev = nan
+    for i in range(Z):
+        p = pressure[i]
+        t = temperature[i]
+        td = dewpoint[i]
+        if isnan(p) or isnan(t) or isnan(td) or p > reference_pressure:
+            continue
+
+        if not lcl_done and p < lcl_p:
+            # - the lcl node, with the environment interpolated linearly in pressure
+            lcl_done = 1
+            if not isnan(p_prev):
+                weight = (lcl_p - p_prev) / (p - p_prev)
+                t_env = t_prev + weight * (t - t_prev)
+                td_env = td_prev + weight * (td - td_prev)
+            else:
+                t_env = t
+                td_env = td
+            if virtual:
+                tv_env = virtual_temperature(t_env, saturation_mixing_ratio(lcl_p, td_env))
+                tv_parcel = virtual_temperature(lcl_t, saturation_mixing_ratio(lcl_p, lcl_t))
+            else:
+                tv_env = t_env
+                tv_parcel = lcl_t
+            buoyancy_step(b, log(lcl_p), tv_parcel - tv_env, t_env, 1, 1)
+
+        if trace is not NULL and p <= 5e4 and p_prev > 5e4:
+            # - the lifted index, from the parcel at exactly 500 hPa and the environment
+            # interpolated linearly in log pressure
+            if lcl_done and p_moist >= 5e4:
+                t_500 = moist_lapse_integrator(p_moist, <floating> 5e4, t_parcel, step)
+            else:
+                t_500 = reference_temperature * fpow(<floating> 5e4 / reference_pressure, <floating> (Rd / Cpd))
+            weight = flog(<floating> 5e4 / p_prev) / flog(p / p_prev)
+            trace.lifted_index = t_prev + weight * (t - t_prev) - t_500
+
+        if lcl_done:
+            # - moist ascent above the lcl
+            t_parcel = moist_lapse_integrator(p_moist, p, t_parcel, step)
+            p_moist = p
+            t_lifted = t_parcel
+            tv_parcel = virtual_temperature(t_parcel, saturation_mixing_ratio(p, t_parcel))
+        else:
+            # - dry ascent below the lcl
+            t_lifted = reference_temperature * fpow(p / reference_pressure, <floating> (Rd / Cpd))
+            tv_parcel = virtual_temperature(t_lifted, r)
+
+        if virtual:
+            tv_env = virtual_temperature(t, saturation_mixing_ratio(p, td))
+        else:
+            tv_env = t
+            tv_parcel = t_lifted
+        # a parcel that is saturated at the reference pressure starts at its lcl
+        buoyancy_step(b, log(p), tv_parcel - tv_env, t, lcl_done, lcl_done and not b.started)
+        p_prev = p
+        t_prev = t
+        td_prev = td
+
+    return 1
+
+
+cdef void cape_cin_1d_(
+    floating[:] out,
+    const floating[:] pressure,
+    const floating[:] temperature,
+    const floating[:] dewpoint,
+    floating reference_pressure,
+    floating reference_temperature,
+    floating reference_dewpoint,
+    floating step,
+    size_t max_iters,
+    floating eps,
+    ParcelKind parcel,
+    floating depth,
+) noexcept nogil:
+    """The cape (bottom lfc to top el) and cin of a parcel integrated with virtual temperature. The
+    mixed layer and most unstable parcels are selected from the column before it is lifted, in
+    place of the reference parcel."""
+    cdef Buoyancy b
+    cdef Crossing lfc, el
+    cdef double cape, cin
+
+    if MIXED_LAYER is parcel:
+        mixed_layer_parcel(
+            pressure, temperature, dewpoint, depth, &reference_pressure, &reference_temperature, &reference_dewpoint
+        )
+    elif MOST_UNSTABLE is parcel:
+        most_unstable_parcel(
+            pressure, temperature, dewpoint, depth, &reference_pressure, &reference_temperature, &reference_dewpoint
+        )
+
+    buoyancy_init(&b, BOTTOM)
+    if not parcel_buoyancy_1d_(
+        &b, NULL, pressure, temperature, dewpoint, reference_pressure, reference_temperature, reference_dewpoint,
+        step, max_iters, eps, 1,
+    ):
+        out[0] = out[1] = nan
+        return
+
+    buoyancy_levels(&b, TOP, &lfc, &el, &cape, &cin)
+    out[0] = Rd * cape
+    out[1] = Rd * cin
+
+
+cdef void convective_levels_1d_(
+    floating[:] out,
+    const floating[:] pressure,
+    const floating[:] temperature,
+    const floating[:] dewpoint,
+    floating reference_pressure,
+    floating reference_temperature,
+    floating reference_dewpoint,
+    floating step,
+    size_t max_iters,
+    floating eps,
+    ConvectiveLevel which_lfc,
+    ConvectiveLevel which_el,
+    bint virtual,
+) noexcept nogil:
+    """``out = [lfc_p, lfc_t, el_p, el_t, cape, cin]`` from a single lift of the parcel."""
+    cdef Buoyancy b
+    cdef Crossing lfc, el
+    cdef double cape, cin
+
+    buoyancy_init(&b, which_lfc)
+    if not parcel_buoyancy_1d_(
+        &b, NULL, pressure, temperature, dewpoint, reference_pressure, reference_temperature, reference_dewpoint,
+        step, max_iters, eps, virtual,
+    ):
+        out[0] = out[1] = out[2] = out[3] = out[4] = out[5] = nan
+        return
+
+    buoyancy_levels(&b, which_el, &lfc, &el, &cape, &cin)
+    out[0] = exp(lfc.x) if lfc.valid else nan
+    out[1] = lfc.t if lfc.valid else nan
+    out[2] = exp(el.x) if el.valid else nan
+    out[3] = el.t if el.valid else nan
+    out[4] = Rd * cape
+    out[5] = Rd * cin
+
+
+cdef void _cape_cin(
+    floating[:, :] out,
+    const floating[:, :] pressure,
+    const floating[:, :] temperature,
+    const floating[:, :] dewpoint,
+    const floating[:] reference_pressure,
+    const floating[:] reference_temperature,
+    const floating[:] reference_dewpoint,
+    floating step,
+    size_t max_iters,
+    floating eps,
+    ParcelKind parcel,
+    floating depth,
+    BroadcastMode mode,
+):
+    cdef size_t N, i, stride
+
+    N = temperature.shape[0]
+    stride = 0 if BROADCAST is mode else 1  # the BROADCAST columns all read the first row of pressure
+    if nzt_get_serial():
+        with nogil:
+            for i in range(N):
+                nzt_diag_column(i)
+                cape_cin_1d_(
+                    out[:, i], pressure[i * stride, :], temperature[i], dewpoint[i],
+                    reference_pressure[i], reference_temperature[i], reference_dewpoint[i],
+                    step=step, max_iters=max_iters, eps=eps, parcel=parcel, depth=depth,
+                )
+        return
+
+    with nogil, parallel():
+        for i in prange(N, schedule='runtime'):
+            nzt_diag_column(i)
+            cape_cin_1d_(
+                out[:, i], pressure[i * stride, :], temperature[i], dewpoint[i],
+                reference_pressure[i], reference_temperature[i], reference_dewpoint[i],
+                step=step, max_iters=max_iters, eps=eps, parcel=parcel, depth=depth,
+            )
+
+
+def cape_cin(
+    np.ndarray pressure,
+    np.ndarray temperature,
+    np.ndarray dewpoint,
+    np.ndarray reference_pressure = None,
+    np.ndarray reference_temperature = None,
+    np.ndarray reference_dewpoint = None,
+    *,
+    str parcel = "surface",
+    object depth = None,
+    floating step = 1000.0,
+    size_t max_iters = 50,
+    floating eps = 0.1,
+    object threads = None,
+    object dtype = None,
+    np.ndarray out = None,
+):
+    """
+    pressure shape ``(Z,) | (1, Z) | (N, Z)``, temperature and dewpoint shape ``(N, Z)``
+
+    Convective Available Potential Energy (CAPE) and Convective Inhibition (CIN) of a parcel lifted
+    from ``reference_pressure``, ``reference_temperature`` and ``reference_dewpoint`` (each of
+    shape ``(N,)``, defaulting to the first level of the profile, i.e. surface based).
+
+    Each column is integrated in a single streaming pass: the parcel ascends with the same dry /
+    moist scheme as ``parcel_profile``, the virtual temperature of the parcel and environment is
+    computed on the fly and the trapezoid integral in log pressure is accumulated in registers, so
+    the memory use is ``O(N)``. Mixed layer and most unstable values are obtained by passing the
+    corresponding parcel as the reference, or by selecting it from each column in the same pass:
+
+    - ``parcel="mixed_layer"`` the pressure weighted mean of the lowest ``depth`` (100 hPa) as in
+      ``mixed_parcel``.
+    - ``parcel="most_unstable"`` the maximum equivalent potential temperature in the lowest
+      ``depth`` (300 hPa) as in ``most_unstable_parcel``.
+
+    ``depth`` raises a ``ValueError`` for the default ``parcel="surface"``.
+
+    ``cape`` is the signed area between the bottom level of free convection and the top
+    equilibrium level, as in ``metpy.calc.cape_cin``. ``cin`` is the sum of only the negatively
+    buoyant areas between the parcel's starting level and the level of free convection. MetPy
+    instead integrates the signed area below the LFC and clips it at 0, so the two differ where a
+    positively buoyant layer lies below the LFC, e.g. a superadiabatic surface layer under a
+    capping inversion: MetPy subtracts that layer from the inhibition and ``cape_cin`` does not.
+    Both are 0 for a parcel without a level of free convection.
+
+    Returns:
+        ``(2, N)`` array of ``cape`` and ``cin`` in ``J/kg``.
+    """
+    cdef size_t N
+    cdef np.ndarray x
+    cdef ParcelKind kind
+
+    if parcel == "surface":
+        kind = SURFACE
+    elif parcel == "mixed_layer":
+        kind = MIXED_LAYER
+    elif parcel == "most_unstable":
+        kind = MOST_UNSTABLE
+    else:
+        raise ValueError(f"parcel must be one of 'surface', 'mixed_layer' or 'most_unstable', got {parcel!r}.")
+
+    if SURFACE is not kind and not (
+        reference_pressure is None and reference_temperature is None and reference_dewpoint is None
+    ):
+        raise ValueError(f"a reference parcel can not be combined with parcel={parcel!r}.")
+    elif SURFACE is kind and depth is not None:
+        raise ValueError("depth only applies to parcel='mixed_layer' or parcel='most_unstable'.")
+    if depth is None:
+        depth = 30000.0 if MOST_UNSTABLE is kind else 10000.0
+
+    if dtype is None:
+        dtype = temperature.dtype if out is None else out.dtype
+    else:
+        dtype = np.dtype(dtype)
+
+    pressure, temperature, dewpoint, reference_pressure, reference_temperature, reference_dewpoint = (
+        _parcel_inputs(pressure, temperature, dewpoint, reference_pressure, reference_temperature, reference_dewpoint)
+    )
+    N = temperature.shape[0]
 
-# -------------------------------------------------------------------------------------------------
-# constant declarations
-# -------------------------------------------------------------------------------------------------
-cdef:
-    float Rd        = _const.Rd
-    float Rv        = _const.Rv
-    float Lv        = _const.Lv
-    float Cpd       = _const.Cpd
-    float epsilon   = _const.epsilon
-    float T0        = _const.T0
-    float E0        = _const.E0
-    float nan       = float('nan')
-    float inf       = float('inf')
+    x = _output_array(out, (2, N), dtype)
+    with _Parallel(threads, N, temperature.shape[1]):
+        if np.float32 == dtype:
+            _cape_cin[float](
+                x,
+                pressure.astype(np.float32, copy=False),
+                temperature.astype(np.float32, copy=False),
+                dewpoint.astype(np.float32, copy=False),
+                reference_pressure.astype(np.float32, copy=False),
+                reference_temperature.astype(np.float32, copy=False),
+                reference_dewpoint.astype(np.float32, copy=False),
+                step=step,
+                max_iters=max_iters,
+                eps=eps,
+                parcel=kind,
+                depth=depth,
+                mode=BROADCAST if 1 == pressure.shape[0] else MATRIX,
+            )
+        else:
+            _cape_cin[double](
+                x,
+                pressure.astype(np.float64, copy=False),
+                temperature.astype(np.float64, copy=False),
+                dewpoint.astype(np.float64, copy=False),
+                reference_pressure.astype(np.float64, copy=False),
+                reference_temperature.astype(np.float64, copy=False),
+                reference_dewpoint.astype(np.float64, copy=False),
+                step=step,
+                max_iters=max_iters,
+                eps=eps,
+                parcel=kind,
+                depth=depth,
+                mode=BROADCAST if 1 == pressure.shape[0] else MATRIX,
+            )
 
-del _const
+    return x
 
-# -------------------------------------------------------------------------------------------------
-# thermodynamic functions
-# -------------------------------------------------------------------------------------------------
-cdef floating saturation_mixing_ratio(floating pressure, floating temperature) noexcept nogil:
-    cdef floating P
-    P = E0 * exp(17.67 * (temperature - T0) / (temperature - 29.65)) # saturation vapor pressure
-    return 0.6219 * P / (pressure - P)
 
+cdef void _convective_levels(
+    floating[:, :] out,
+    const floating[:, :] pressure,
+    const floating[:, :] temperature,
+    const floating[:, :] dewpoint,
+    const floating[:] reference_pressure,
+    const floating[:] reference_temperature,
+    const floating[:] reference_dewpoint,
+    floating step,
+    size_t max_iters,
+    floating eps,
+    ConvectiveLevel which_lfc,
+    ConvectiveLevel which_el,
+    bint virtual,
+    BroadcastMode mode,
+):
+    cdef size_t N, i, stride
 
-cdef floating vapor_pressure(floating pressure, floating mixing_ratio) noexcept nogil:
-    return pressure * mixing_ratio / (Rd / Rv + mixing_ratio)
+    N = temperature.shape[0]
+    stride = 0 if BROADCAST is mode else 1  # the BROADCAST columns all read the first row of pressure
+    if nzt_get_serial():
+        with nogil:
+            for i in range(N):
+                nzt_diag_column(i)
+                convective_levels_1d_(
+                    out[:, i], pressure[i * stride, :], temperature[i], dewpoint[i],
+                    reference_pressure[i], reference_temperature[i], reference_dewpoint[i],
+                    step=step, max_iters=max_iters, eps=eps,
+                    which_lfc=which_lfc, which_el=which_el, virtual=virtual,
+                )
+        return
 
+    with nogil, parallel():
+        for i in prange(N, schedule='runtime'):
+            nzt_diag_column(i)
+            convective_levels_1d_(
+                out[:, i], pressure[i * stride, :], temperature[i], dewpoint[i],
+                reference_pressure[i], reference_temperature[i], reference_dewpoint[i],
+                step=step, max_iters=max_iters, eps=eps,
+                which_lfc=which_lfc, which_el=which_el, virtual=virtual,
+            )
 
-cdef floating _dewpoint(floating vapor_pressure) noexcept nogil:
-    cdef floating ln
-    ln = log(vapor_pressure / E0)
-    return T0 + 243.5 * ln / (17.67 - ln)
 
+cdef ConvectiveLevel _convective_level(str which) except *:
+    if which == "bottom":
+        return BOTTOM
+    elif which == "top":
+        return TOP
+    elif which == "most_cape":
+        return MOST_CAPE
 
-cdef floating mixing_ratio(
-    floating partial_press, floating total_press, floating molecular_weight_ratio = Rd / Rv
-) noexcept nogil:
-    return molecular_weight_ratio * partial_press / (total_press - partial_press)
+    raise ValueError(f"which must be one of 'bottom', 'top' or 'most_cape', got {which!r}.")
 
 
-cdef floating saturation_vapor_pressure(floating temperature) noexcept nogil:    
-    return E0 * exp(17.67 * (temperature - T0) / (temperature - 29.65))
+def convective_levels(
+    np.ndarray pressure,
+    np.ndarray temperature,
+    np.ndarray dewpoint,
+    np.ndarray reference_pressure = None,
+    np.ndarray reference_temperature = None,
+    np.ndarray reference_dewpoint = None,
+    *,
+    str which_lfc = "top",
+    str which_el = "top",
+    bint virtual = False,
+    floating step = 1000.0,
+    size_t max_iters = 50,
+    floating eps = 0.1,
+    object threads = None,
+    object dtype = None,
+    np.ndarray out = None,
+):
+    """
+    pressure shape ``(Z,) | (1, Z) | (N, Z)``, temperature and dewpoint shape ``(N, Z)``
 
+    The Level of Free Convection (LFC), Equilibrium Level (EL), CAPE and CIN of a parcel lifted
+    from ``reference_pressure``, ``reference_temperature`` and ``reference_dewpoint`` (each of
+    shape ``(N,)``, defaulting to the first level of the profile).
 
-# -------------------------------------------------------------------------------------------------
-# moist_lapse
-# -------------------------------------------------------------------------------------------------
-cdef floating moist_lapse_solver(floating pressure, floating temperature) noexcept nogil:
-    cdef floating r
-    r = saturation_mixing_ratio(pressure, temperature)
-    r = (Rd * temperature + Lv * r) / (Cpd + (Lv * Lv * r * epsilon / (Rd * temperature**2)))
-    r /= pressure
-    return r
+    The parcel is lifted once per column with the same streaming scheme as ``cape_cin``, and every
+    crossing of the parcel and environment is interpolated in log pressure as it is passed, so the
+    levels and the energy between them come from the same integral. ``which_lfc`` and ``which_el``
+    select the ``"bottom"``, ``"top"`` or ``"most_cape"`` crossing:
 
+    - ``"bottom"`` the lfc is the lcl when the parcel is buoyant there, otherwise the first crossing
+      from negative to positive above the lcl, and the el is the first crossing from positive to
+      negative above the lfc.
+    - ``"top"`` the last of those crossings.
+    - ``"most_cape"`` the lfc and el that bound the most positive area.
 
-cdef floating moist_lapse_integrator(
-    floating pressure, floating next_pressure, floating temperature, floating step
-) noexcept nogil:
-    """``2nd order Runge-Kutta (RK2)``
+    With ``virtual=False`` (the default, as in MetPy's ``lfc`` and ``el``) the crossings and the
+    area are computed from the temperature, otherwise from the virtual temperature as in
+    ``cape_cin``.
 
-    Integrate the moist lapse rate ODE, using a RK2 method, from an initial pressure lvl
-    to a final one.
+    Returns:
+        ``(6, N)`` array of ``lfc_pressure``, ``lfc_temperature``, ``el_pressure``,
+        ``el_temperature``, ``cape`` and ``cin``. The levels are ``nan`` where they do not exist.
     """
-    cdef int N
-    cdef floating delta, abs_delta, k1
+    cdef size_t N
+    cdef np.ndarray x
+    cdef ConvectiveLevel lfc_mode, el_mode
 
-    N = 1
-    delta = next_pressure - pressure
-    if (abs_delta := abs(delta)) > step:
-        N =  <int> ceil(abs_delta / step)
-        delta = delta / <floating> N
+    lfc_mode = _convective_level(which_lfc)
+    el_mode = _convective_level(which_el)
 
-    for _ in range(N):
-        k1 = delta * moist_lapse_solver(pressure, temperature)
-        temperature += delta * moist_lapse_solver(pressure + delta * 0.5, temperature + k1 * 0.5)
-        pressure += delta
+    if dtype is None:
+        dtype = temperature.dtype if out is None else out.dtype
+    else:
+        dtype = np.dtype(dtype)
 
-    return temperature
+    pressure, temperature, dewpoint, reference_pressure, reference_temperature, reference_dewpoint = (
+        _parcel_inputs(pressure, temperature, dewpoint, reference_pressure, reference_temperature, reference_dewpoint)
+    )
+    N = temperature.shape[0]
+
+    x = _output_array(out, (6, N), dtype)
+    with _Parallel(threads, N, temperature.shape[1]):
+        if np.float32 == dtype:
+            _convective_levels[float](
+                x,
+                pressure.astype(np.float32, copy=False),
+                temperature.astype(np.float32, copy=False),
+                dewpoint.astype(np.float32, copy=False),
+                reference_pressure.astype(np.float32, copy=False),
+                reference_temperature.astype(np.float32, copy=False),
+                reference_dewpoint.astype(np.float32, copy=False),
+                step=step,
+                max_iters=max_iters,
+                eps=eps,
+                which_lfc=lfc_mode,
+                which_el=el_mode,
+                virtual=virtual,
+                mode=BROADCAST if 1 == pressure.shape[0] else MATRIX,
+            )
+        else:
+            _convective_levels[double](
+                x,
+                pressure.astype(np.float64, copy=False),
+                temperature.astype(np.float64, copy=False),
+                dewpoint.astype(np.float64, copy=False),
+                reference_pressure.astype(np.float64, copy=False),
+                reference_temperature.astype(np.float64, copy=False),
+                reference_dewpoint.astype(np.float64, copy=False),
+                step=step,
+                max_iters=max_iters,
+                eps=eps,
+                which_lfc=lfc_mode,
+                which_el=el_mode,
+                virtual=virtual,
+                mode=BROADCAST if 1 == pressure.shape[0] else MATRIX,
+            )
+
+    return x
 
 
-cdef void moist_lapse_1d_(
-    floating[:] out, floating[:] pressure, floating reference_pressure, floating temperature, floating step
+# -------------------------------------------------------------------------------------------------
+# downdraft_cape
+# -------------------------------------------------------------------------------------------------
+cdef floating downdraft_cape_1d_(
+    const floating[:] pressure,
+    const floating[:] temperature,
+    const floating[:] dewpoint,
+    floating step,
+    size_t max_iters,
+    floating eps,
+    const GridLevels* grid,
 ) noexcept nogil:
-    """Moist adiabatic lapse rate for a 1D array of pressure levels."""
-    cdef size_t Z, i
-    cdef floating next_pressure
+    """The downdraft parcel starts at the minimum theta_e in the 700-500 hPa layer, from its wet
+    bulb temperature, and descends moist adiabatically to the bottom of the profile. With a ``grid``
+    only the cached levels of the layer are searched and ``log(p)`` is read from the cache."""
+    cdef size_t Z, i, k, start, stop
+    cdef floating p, t, td, p_prev, trace, theta_e, theta_e_min
+    cdef double delta, delta_prev, logp, logp_prev, dcape
 
     Z = pressure.shape[0]
-    if isnan(temperature) or isnan(reference_pressure): # don't bother with the computation
-        for i in prange(Z):
-            out[i] = nan
-        return
+    start = grid.layer_start if grid != NULL else 0
+    stop = grid.layer_stop if grid != NULL else Z
 
-    for i in range(Z):
-        if isnan(next_pressure := pressure[i]): 
-            # This can be usefull in 2D case where we might want to mask out some 
-            # values below the lcl for a particular column.
-            # The solver will start at the first non nan value
-            out[i] = nan
-        else:
-            out[i] = temperature = moist_lapse_integrator(
-                reference_pressure, next_pressure, temperature, step=step
-            )
-            reference_pressure = next_pressure
+    # - the source level, nan values are never selected
+    k = Z
+    theta_e_min = inf
+    for i in range(start, stop):
+        p = pressure[i]
+        if p <= 7e4 and p >= 5e4:
+            theta_e = equivalent_potential_temperature(p, temperature[i], dewpoint[i])
+            if theta_e < theta_e_min:
+                theta_e_min = theta_e
+                k = i
+
+    if k == Z:
+        return nan
+
+    # - the wet bulb temperature at the source level
+    p = pressure[k]
+    trace = wet_bulb_normand(p, temperature[k], dewpoint[k], step, max_iters, eps)
+
+    # - descend from the source level integrating the difference in virtual temperature, which is
+    # positive where the environment is warmer than the parcel
+    dcape = 0.0
+    delta_prev = (
+        virtual_temperature(temperature[k], saturation_mixing_ratio(p, dewpoint[k]))
+        - virtual_temperature(trace, saturation_mixing_ratio(p, trace))
+    )
+    logp_prev = grid.log_pressure[k] if grid != NULL else log(p)
+    p_prev = p
+    i = k
+    while i > 0:
+        i -= 1
+        p = pressure[i]
+        t = temperature[i]
+        td = dewpoint[i]
+        if isnan(p) or isnan(t) or isnan(td):
+            continue
 
+        trace = moist_lapse_integrator(p_prev, p, trace, step)
+        delta = (
+            virtual_temperature(t, saturation_mixing_ratio(p, td))
+            - virtual_temperature(trace, saturation_mixing_ratio(p, trace))
+        )
+        logp = grid.log_pressure[i] if grid != NULL else log(p)
+        dcape += 0.5 * (delta + delta_prev) * (logp - logp_prev)
+        delta_prev = delta
+        logp_prev = logp
+        p_prev = p
+
+    return Rd * dcape
 
-cdef floating[:, :] _moist_lapse(
-    floating[:, :] pressure, 
-    floating[:] reference_pressure, 
-    floating[:] temperature, 
+
+cdef void _downdraft_cape(
+    floating[:] out,
+    const floating[:, :] pressure,
+    const floating[:, :] temperature,
+    const floating[:, :] dewpoint,
     floating step,
+    size_t max_iters,
+    floating eps,
     BroadcastMode mode,
+    const GridLevels* grid,
 ):
-    cdef size_t N, Z, i
-    cdef floating[:, :] out
+    cdef size_t N, i, stride
 
-    N, Z = temperature.shape[0], pressure.shape[1]
-    if pressure.itemsize == sizeof(float):
-        out = cvarray((N, Z), itemsize=sizeof(float), format='f', mode='c')
-    else:
-        out = cvarray((N, Z), itemsize=sizeof(double), format='d', mode='c')
+    N = temperature.shape[0]
+    # the BROADCAST columns all read the first row of pressure, the grid only applies to them
+    stride = 0 if BROADCAST is mode else 1
+    if MATRIX is mode:
+        grid = NULL
+    if nzt_get_serial():
+        with nogil:
+            for i in range(N):
+                nzt_diag_column(i)
+                out[i] = downdraft_cape_1d_(
+                    pressure[i * stride, :], temperature[i], dewpoint[i],
+                    step=step, max_iters=max_iters, eps=eps, grid=grid,
+                )
+        return
 
     with nogil, parallel():
-        if BROADCAST is mode:
-            for i in prange(N, schedule='dynamic'):
-                moist_lapse_1d_(out[i], pressure[0, :], reference_pressure[i], temperature[i], step=step)
-        elif MATRIX is mode:
-            for i in prange(N, schedule='dynamic'):
-                moist_lapse_1d_(out[i], pressure[i, :], reference_pressure[i], temperature[i], step=step)
-        else: # ELEMENT_WISE
-            for i in prange(N, schedule='dynamic'):
-                moist_lapse_1d_(out[i], pressure[i:i + 1, 0], reference_pressure[i], temperature[i], step=step)
-
-    return out
+        for i in prange(N, schedule='runtime'):
+            nzt_diag_column(i)
+            out[i] = downdraft_cape_1d_(
+                pressure[i * stride, :], temperature[i], dewpoint[i],
+                step=step, max_iters=max_iters, eps=eps, grid=grid,
+            )
 
 
-def moist_lapse(
-    np.ndarray pressure,
+def downdraft_cape(
+    object pressure,
     np.ndarray temperature,
-    np.ndarray reference_pressure = None,
+    np.ndarray dewpoint,
     *,
     floating step = 1000.0,
+    size_t max_iters = 50,
+    floating eps = 0.1,
+    object threads = None,
     object dtype = None,
+    np.ndarray out = None,
+    object batch_size = None,
+    object max_memory = None,
 ):
     """
-    pressure shape ``(N,) | (Z,) | (1, Z) | (N, Z)``
-
-    This function attempts to automaticly resolve the broadcast mode. If all 3 arrays have the same
-    shape, and you want to broadcast ``N x Z`` reshape the ``pressure`` array to ``(1, Z)``,
-    otherwise the function will execute element-wise.
-
-    >>> import numpy as np
-    >>> import nzthermo as nzt
-    >>> pressure = np.linspace(100000, 31000, 20)
-    >>> temperature = np.random.uniform(300, 220, 20)
-    >>> refrence_pressures = np.random.uniform(1001325, 100001, 20)
-    >>> nzt.moist_lapse(pressure, temperature, refrence_pressures)
-    array([136.21, 193.77, 154.62, ..., 112.51, 155.1 , 119.41])
-    >>> nzt.moist_lapse(pressure[np.newaxis, :], temperature, refrence_pressures)
-    array([[136.21, 134.78, 133.31, ..., 103.52, 100.61,  97.47],
-           [195.83, 193.77, 191.66, ..., 148.83, 144.65, 140.14],
-           [157.99, 156.33, 154.62, ..., 120.07, 116.7 , 113.06],
-           ...,
-           [148.05, 146.49, 144.89, ..., 112.51, 109.35, 105.94],
-           [209.97, 207.76, 205.5 , ..., 159.58, 155.1 , 150.27],
-           [166.86, 165.11, 163.31, ..., 126.81, 123.25, 119.41]])
-
+    pressure shape ``(Z,) | (1, Z) | (N, Z)`` or a ``PressureGrid``, temperature and dewpoint shape
+    ``(N, Z)``
 
-    If ``reference_pressure`` is not provided and the pressure array is 2D, the reference pressure
-    will be determined by finding the first non-nan value in each row.
+    Downdraft Convective Available Potential Energy (DCAPE). The source of the downdraft is the
+    level of minimum equivalent potential temperature in the 700-500 hPa layer. The parcel descends
+    moist adiabatically from the wet bulb temperature at the source level to the bottom of the
+    profile, and the difference in virtual temperature with the environment is integrated along
+    the way. Each column is computed in a single pass, a ``(Z,)`` pressure profile is shared by all
+    of the columns without being replicated.
 
-    >>> pressure = np.array([
-        [1013.12, 1000, 975, 950, 925, 900, ...],
-        [1013.93, 1000, 975, 950, 925, 900, ...],
-        [np.nan, np.nan, 975, 950, 925, 900, ...]
-    ]) * 100.0 # (N, Z) :: pressure profile
-    >>> reference_pressure = pressure[np.arange(len(pressure)), np.argmin(np.isnan(pressure), axis=1)]
-    >>> reference_pressure
-    array([101312., 101393.,  97500.  ])
+    The columns are processed in tiles of ``batch_size`` columns, or as many as fit in
+    ``max_memory`` bytes, when the inputs are cast to ``dtype``, so that only one tile of the cast
+    copies is alive at a time. The result is a single contiguous ``(N,)`` array.
 
+    Returns:
+        ``(N,)`` array of ``dcape`` in ``J/kg``, ``nan`` where the profile has no levels in the
+        700-500 hPa layer.
     """
-    cdef size_t N, Z, ndim
-    cdef np.ndarray x
+    cdef size_t N, Z, rows, start, stop
     cdef BroadcastMode mode
+    cdef np.ndarray x, p
+    cdef PressureGrid grid = pressure if isinstance(pressure, PressureGrid) else None
 
     if dtype is None:
-        dtype = pressure.dtype
+        dtype = temperature.dtype if out is None else out.dtype
     else:
         dtype = np.dtype(dtype)
+    if grid is not None:
+        pressure = grid._levels(dtype)
 
-    # [ pressure ]
-    if (ndim := pressure.ndim) == 1:
-        pressure = pressure.reshape(1, -1) # (1, Z)
-    elif ndim != 2:
-        raise ValueError("pressure must be 1D or 2D array.")
-
-    # [ temperature ]
-    temperature = temperature.ravel()  # (N,)
-    if not (N := temperature.shape[0]):
-        return np.full_like(pressure, nan, dtype=dtype)
-
-    # [ reference_pressure ]
-    if reference_pressure is not None:
-        reference_pressure = reference_pressure.ravel()
-        if (
-            ndim == <size_t> temperature.ndim == <size_t> reference_pressure.ndim
-            and pressure.size == temperature.size == reference_pressure.size
-        ):
-            mode = ELEMENT_WISE  # (N,) (N,) (N,)
-            pressure = pressure.reshape(N, 1)
-        elif N != <size_t> reference_pressure.shape[0]:
-            raise ValueError("reference_pressure and temperature arrays must be the same size.")
-        elif 1 == <size_t> pressure.shape[0]:
-            mode = BROADCAST    # (1, Z) (N,) (N,)
-        elif N == <size_t> pressure.shape[0]:
-            mode = MATRIX       # (N, Z) (N,) (N,)
-        else:
-            raise ValueError("Unable to determine the broadcast mode.")
-    # no reference_pressure provided can only be MATRIX or BROADCAST
-    elif 2 == ndim and N == <size_t> pressure.shape[0]:
-        mode = MATRIX           # (N, Z) (N,)
-        reference_pressure = pressure[np.arange(N), np.argmin(np.isnan(pressure), axis=1)]
-    elif 1 == pressure.shape[0]:
-        mode = BROADCAST        # (1, Z) (N,)
-        reference_pressure = np.repeat(pressure[0, np.argmin(np.isnan(pressure[0]))], N)
-    else:
-        raise ValueError("Unable to determine the broadcast mode.")
-
-    Z = pressure.shape[1]
+    pressure, temperature, dewpoint = _profile_inputs(pressure, temperature, dewpoint)
+    N, Z = temperature.shape[0], temperature.shape[1]
+    mode = BROADCAST if 1 == pressure.shape[0] else MATRIX
 
-    x = np.empty((N, Z), dtype=dtype)
-    if np.float32 == dtype:
-        x[...] = _moist_lapse[float](
-            pressure.astype(np.float32), 
-            reference_pressure.astype(np.float32),
-            temperature.astype(np.float32), 
-            step=step,
-            mode=mode,
-        )
-    else:
-        x[...] = _moist_lapse[double](
-            pressure.astype(np.float64),
-            reference_pressure.astype(np.float64),
-            temperature.astype(np.float64),
-            step=step,
-            mode=mode,
-        )
-    if mode == ELEMENT_WISE:
-        x = x.squeeze(1)
+    # the temperature and dewpoint, and the pressure in the MATRIX mode, are cast one tile at a time
+    rows = _batch_rows(N, Z * dtype.itemsize * (2 if mode == BROADCAST else 3), batch_size, max_memory)
+    x = _output_array(out, (N,), dtype)
+    with _Parallel(threads, N, Z):
+        start = 0
+        while start < N:
+            stop = min(start + rows, N)
+            p = pressure if mode == BROADCAST else pressure[start:stop]
+            if np.float32 == dtype:
+                _downdraft_cape[float](
+                    x[start:stop],
+                    p.astype(np.float32, copy=False),
+                    temperature[start:stop].astype(np.float32, copy=False),
+                    dewpoint[start:stop].astype(np.float32, copy=False),
+                    step=step,
+                    max_iters=max_iters,
+                    eps=eps,
+                    mode=mode,
+                    grid=&grid.levels if grid is not None else NULL,
+                )
+            else:
+                _downdraft_cape[double](
+                    x[start:stop],
+                    p.astype(np.float64, copy=False),
+                    temperature[start:stop].astype(np.float64, copy=False),
+                    dewpoint[start:stop].astype(np.float64, copy=False),
+                    step=step,
+                    max_iters=max_iters,
+                    eps=eps,
+                    mode=mode,
+                    grid=&grid.levels if grid is not None else NULL,
+                )
+            start = stop
 
     return x
 
+
 # -------------------------------------------------------------------------------------------------
-# lcl
+# sounding
 # -------------------------------------------------------------------------------------------------
-cdef floating lcl_solver(
-    floating pressure, floating reference_pressure, floating temperature, floating mixing_ratio
+SOUNDING_FIELDS = (
+    "lcl_pressure",
+    "lcl_temperature",
+    "lfc_pressure",
+    "lfc_temperature",
+    "el_pressure",
+    "el_temperature",
+    "cape",
+    "cin",
+    "dcape",
+    "ccl_pressure",
+    "ccl_temperature",
+    "convective_temperature",
+    "lifted_index",
+    "precipitable_water",
+)
+# the pass of the column scan that computes each field
+cdef dict SOUNDING_PASSES = {
+    "lcl_pressure": PARCEL,
+    "lcl_temperature": PARCEL,
+    "lfc_pressure": PARCEL,
+    "lfc_temperature": PARCEL,
+    "el_pressure": PARCEL,
+    "el_temperature": PARCEL,
+    "cape": PARCEL,
+    "cin": PARCEL,
+    "dcape": DOWNDRAFT,
+    "ccl_pressure": CONDENSATION,
+    "ccl_temperature": CONDENSATION,
+    "convective_temperature": CONDENSATION,
+    "lifted_index": PARCEL,
+    "precipitable_water": MOISTURE,
+}
+
+
+cdef void ccl_1d_(
+    const floating[:] pressure,
+    const floating[:] temperature,
+    const floating[:] dewpoint,
+    double* ccl_p,
+    double* ccl_t,
+    double* convective_t,
 ) noexcept nogil:
-    cdef floating Td, P
+    """The lower intersection of the temperature and the dewpoint along the saturation mixing
+    ratio line through the surface dewpoint, with the same rules as ``intersect_1d_`` but without
+    materializing the ``(Z,)`` line."""
+    cdef size_t Z, z, z0, z1
+    cdef int s0, s1
+    cdef floating r, a0, a1, d0, d1, x0, x1, value
 
-    Td = _dewpoint(vapor_pressure(pressure, mixing_ratio))
-    if isnan(P := reference_pressure * (Td / temperature) ** (1.0 / (Rd / Cpd))):
-        return pressure
+    Z = pressure.shape[0]
+    r = mixing_ratio(saturation_vapor_pressure(dewpoint[0]), pressure[0])
 
-    return P
+    z0 = 0
+    s0 = sign_code(_dewpoint(vapor_pressure(pressure[0], r)) - temperature[0])
+    for z in range(Z):
+        s1 = sign_code(_dewpoint(vapor_pressure(pressure[z + 1], r)) - temperature[z + 1]) if z + 1 < Z else 1
+        if s0 != s1 or s0 == 2:
+            z0 = z
+            break
+        s0 = s1
 
+    z1 = min(z0 + 1, Z - 1)
+    x0 = flog(pressure[z0])
+    x1 = flog(pressure[z1])
+    a0 = _dewpoint(vapor_pressure(pressure[z0], r))
+    a1 = _dewpoint(vapor_pressure(pressure[z1], r))
+    d0 = a0 - temperature[z0]
+    d1 = a1 - temperature[z1]
+    value = (d1 * x0 - d0 * x1) / (d1 - d0)
+    ccl_p[0] = fexp(value)
+    ccl_t[0] = ((value - x0) / (x1 - x0)) * (a1 - a0) + a0
+    convective_t[0] = ccl_t[0] * fpow(pressure[0] / ccl_p[0], <floating> (Rd / Cpd))
 
-cdef floating lcl_integrator(
-    floating pressure, floating temperature, floating mixing_ratio, size_t max_iters, floating eps
-) noexcept nogil:
-    cdef size_t N, i
-    cdef floating p0, p1, p2, delta, err
 
-    p0 = pressure
-    for _ in range(max_iters):
-        p1 = lcl_solver(p0, pressure, temperature, mixing_ratio)
-        p2 = lcl_solver(p1, pressure, temperature, mixing_ratio)
+cdef double precipitable_water_1d_(const floating[:] pressure, const floating[:] dewpoint) noexcept nogil:
+    """``-1/g ∫ w dp`` over the valid levels of the profile in ``kg/m^2``, which is ``mm``."""
+    cdef size_t Z, i
+    cdef bint started
+    cdef double p, w, p_prev, w_prev, pw
 
-        if (delta := p2 - 2.0 * p1 + p0):
-            p2 = p0 - (p1 - p0) ** 2 / delta    # delta squared
+    Z = pressure.shape[0]
+    pw = 0.0
+    started = 0
+    p_prev = w_prev = 0.0
+    for i in range(Z):
+        p = pressure[i]
+        if isnan(p) or isnan(dewpoint[i]):
+            continue
+        w = mixing_ratio(saturation_vapor_pressure(dewpoint[i]), pressure[i])
+        if started:
+            pw += 0.5 * (w + w_prev) * (p_prev - p)
+        started = 1
+        p_prev = p
+        w_prev = w
 
-        err = abs((p2 - p0) / p0) if p0 else p2 # absolute relative error
+    return pw / g
 
-        if err < eps:
-            return p2
 
-        p0 = p2
+cdef void sounding_1d_(
+    floating[:] out,
+    const floating[:] pressure,
+    const floating[:] temperature,
+    const floating[:] dewpoint,
+    floating step,
+    size_t max_iters,
+    floating eps,
+    int passes,
+    ConvectiveLevel which_lfc,
+    ConvectiveLevel which_el,
+    bint virtual,
+) noexcept nogil:
+    """Every requested diagnostic of one column, in the order of ``SOUNDING_FIELDS``. The surface
+    parcel is lifted once for the lcl, lfc, el, cape, cin and lifted index and the other passes
+    rescan the column while it is still in cache. Every field is written, those of passes that are
+    not requested are nan."""
+    cdef Buoyancy b
+    cdef ParcelTrace trace
+    cdef Crossing lfc, el
+    cdef double cape, cin, ccl_p, ccl_t, convective_t
 
-    return nan
+    if passes & PARCEL:
+        buoyancy_init(&b, which_lfc)
+        if parcel_buoyancy_1d_(
+            &b, &trace, pressure, temperature, dewpoint, pressure[0], temperature[0], dewpoint[0],
+            step, max_iters, eps, virtual,
+        ):
+            buoyancy_levels(&b, which_el, &lfc, &el, &cape, &cin)
+            out[2] = exp(lfc.x) if lfc.valid else nan
+            out[3] = lfc.t if lfc.valid else nan
+            out[4] = exp(el.x) if el.valid else nan
+            out[5] = el.t if el.valid else nan
+            out[6] = Rd * cape
+            out[7] = Rd * cin
+        else:
+            out[2] = out[3] = out[4] = out[5] = out[6] = out[7] = nan
+        out[0] = trace.lcl_pressure
+        out[1] = trace.lcl_temperature
+        out[12] = trace.lifted_index
+    else:
+        out[0] = out[1] = out[2] = out[3] = out[4] = out[5] = out[6] = out[7] = out[12] = nan
+
+    if passes & DOWNDRAFT:
+        out[8] = downdraft_cape_1d_(pressure, temperature, dewpoint, step, max_iters, eps, NULL)
+    else:
+        out[8] = nan
 
+    if passes & CONDENSATION:
+        ccl_1d_(pressure, temperature, dewpoint, &ccl_p, &ccl_t, &convective_t)
+        out[9] = ccl_p
+        out[10] = ccl_t
+        out[11] = convective_t
+    else:
+        out[9] = out[10] = out[11] = nan
+
+    out[13] = precipitable_water_1d_(pressure, dewpoint) if passes & MOISTURE else nan
 
-cdef floating[:, :] _lcl(
-    floating[:] pressure, floating[:] temperature, floating[:] dewpoint, size_t max_iters, floating eps
+
+cdef void _sounding(
+    floating[:, :] out,
+    const floating[:, :] pressure,
+    const floating[:, :] temperature,
+    const floating[:, :] dewpoint,
+    floating step,
+    size_t max_iters,
+    floating eps,
+    int passes,
+    ConvectiveLevel which_lfc,
+    ConvectiveLevel which_el,
+    bint virtual,
+    BroadcastMode mode,
 ):
-    cdef size_t N, i
-    cdef floating P, lcl_p, r
-    cdef floating[:, :] out
+    cdef size_t N, i, stride
 
-    N = pressure.shape[0]
-    if pressure.itemsize == sizeof(float):
-        out = cvarray((2, N), itemsize=sizeof(float), format='f', mode='c')
-    else:
-        out = cvarray((2, N), itemsize=sizeof(double), format='d', mode='c')
+    N = temperature.shape[0]
+    stride = 0 if BROADCAST is mode else 1  # the BROADCAST columns all read the first row of pressure
+    if nzt_get_serial():
+        with nogil:
+            for i in range(N):
+                nzt_diag_column(i)
+                sounding_1d_(
+                    out[:, i], pressure[i * stride, :], temperature[i], dewpoint[i],
+                    step=step, max_iters=max_iters, eps=eps, passes=passes,
+                    which_lfc=which_lfc, which_el=which_el, virtual=virtual,
+                )
+        return
 
     with nogil, parallel():
-        for i in prange(N, schedule='dynamic'):
-            P = pressure[i]
-            r = mixing_ratio(saturation_vapor_pressure(dewpoint[i]), P)
-            out[0, i] = lcl_p = lcl_integrator(P, temperature[i], r, max_iters, eps=eps)
-            out[1, i] = _dewpoint(vapor_pressure(lcl_p, r))
-
-    return out
+        for i in prange(N, schedule='runtime'):
+            nzt_diag_column(i)
+            sounding_1d_(
+                out[:, i], pressure[i * stride, :], temperature[i], dewpoint[i],
+                step=step, max_iters=max_iters, eps=eps, passes=passes,
+                which_lfc=which_lfc, which_el=which_el, virtual=virtual,
+            )
 
 
-def lcl(
+def sounding(
     np.ndarray pressure,
     np.ndarray temperature,
     np.ndarray dewpoint,
     *,
+    object outputs = None,
+    str which_lfc = "bottom",
+    str which_el = "top",
+    bint virtual = True,
+    floating step = 1000.0,
     size_t max_iters = 50,
     floating eps = 0.1,
+    object threads = None,
     object dtype = None,
+    np.ndarray out = None,
 ):
     """
-    The Lifting Condensation Level (LCL) is the level at which a parcel becomes saturated.
-    It is a reasonable estimate of cloud base height when parcels experience forced ascent.
-    The height difference between this parameter and the LFC is important when determining
-    convection initiation. The smaller the difference between the LCL and the LFC, the more likely
-    deep convection becomes. The LFC-LCL difference is similar to CIN (convective inhibition).
-    LCL heights from approximately 500 m (1600 ft) to 800 m (2600 ft) above ground level are
-    associated with F2 to F5 tornadoes. Low LCL heights and low surface dewpoint depressions
-    (high low level RH) suggest a warm RFD which may play a role in tornado development.
+    pressure shape ``(Z,) | (1, Z) | (N, Z)``, temperature and dewpoint shape ``(N, Z)``
+
+    Compute many diagnostics of a surface based parcel in one fused pass per column. ``outputs``
+    is a sequence of names from ``SOUNDING_FIELDS`` (defaulting to all of them); the column is
+    only scanned by the passes those fields need:
+
+    - the parcel ascent: ``lcl_*``, ``lfc_*``, ``el_*``, ``cape``, ``cin`` and ``lifted_index``,
+      which are all taken from a single lift of the parcel as in ``convective_levels``.
+    - ``dcape`` as in ``downdraft_cape``.
+    - ``ccl_pressure``, ``ccl_temperature`` and ``convective_temperature``, the lower ``ccl``.
+    - ``precipitable_water`` in ``kg/m^2`` over the whole profile.
+
+    The defaults ``which_lfc="bottom"``, ``which_el="top"`` and ``virtual=True`` give the same
+    ``cape`` and ``cin`` as ``cape_cin``.
+
+    Returns:
+        ``(len(SOUNDING_FIELDS), N)`` array with a row per field, rows that are not requested are
+        ``nan``.
     """
     cdef size_t N
+    cdef int passes
     cdef np.ndarray x
-    pressure, temperature, dewpoint = map(np.ravel, (pressure, temperature, dewpoint))
-    if not pressure.size == temperature.size == dewpoint.size:
-        raise ValueError("pressure, temperature, and dewpoint arrays must be the same size.")
+    cdef ConvectiveLevel lfc_mode, el_mode
+
+    if outputs is None:
+        outputs = SOUNDING_FIELDS
+    elif isinstance(outputs, str):
+        outputs = (outputs,)
+
+    passes = 0
+    for field in outputs:
+        if field not in SOUNDING_PASSES:
+            raise ValueError(f"unknown sounding output {field!r}, expected one of {SOUNDING_FIELDS}.")
+        passes |= SOUNDING_PASSES[field]
+
+    lfc_mode = _convective_level(which_lfc)
+    el_mode = _convective_level(which_el)
 
     if dtype is None:
-        dtype = pressure.dtype
+        dtype = temperature.dtype if out is None else out.dtype
     else:
         dtype = np.dtype(dtype)
-    N = pressure.size
 
-    x = np.empty((2, N), dtype=dtype)
-    if np.float32 == dtype:
-        x[...] = _lcl[float](
-            pressure.astype(np.float32), 
-            temperature.astype(np.float32),
-            dewpoint.astype(np.float32),
-            max_iters,
-            eps,
-        )
-    else:
-        x[...] = _lcl[double](
-            pressure.astype(np.float64),
-            temperature.astype(np.float64),
-            dewpoint.astype(np.float64),
-            max_iters,
-            eps,
-        )
+    pressure, temperature, dewpoint = _profile_inputs(pressure, temperature, dewpoint)
+    N = temperature.shape[0]
+
+    # every field of every column is written by the kernel, the rows that are not requested as nan
+    x = _output_array(out, (len(SOUNDING_FIELDS), N), dtype)
+    with _Parallel(threads, N, temperature.shape[1]):
+        if np.float32 == dtype:
+            _sounding[float](
+                x,
+                pressure.astype(np.float32, copy=False),
+                temperature.astype(np.float32, copy=False),
+                dewpoint.astype(np.float32, copy=False),
+                step=step,
+                max_iters=max_iters,
+                eps=eps,
+                passes=passes,
+                which_lfc=lfc_mode,
+                which_el=el_mode,
+                virtual=virtual,
+                mode=BROADCAST if 1 == pressure.shape[0] else MATRIX,
+            )
+        else:
+            _sounding[double](
+                x,
+                pressure.astype(np.float64, copy=False),
+                temperature.astype(np.float64, copy=False),
+                dewpoint.astype(np.float64, copy=False),
+                step=step,
+                max_iters=max_iters,
+                eps=eps,
+                passes=passes,
+                which_lfc=lfc_mode,
+                which_el=el_mode,
+                virtual=virtual,
+                mode=BROADCAST if 1 == pressure.shape[0] else MATRIX,
+            )
 
     return x
@@ -0,0 +1,479 @@
+"""
+Optional CUDA backend for the column kernels.
+
+``moist_lapse``, ``lcl`` and ``downdraft_cape`` dispatch here when any of their array arguments is
+a ``cupy.ndarray``, so the inputs and results stay on the device between calls. Each column is
+independent, the kernels map one column to one GPU thread and port the same RK2
+``moist_lapse_integrator``, Aitken accelerated ``lcl_integrator`` and Normand's rule wet bulb as
+the CPU kernels in ``_c.pyx``, so the results agree to the rounding of the device ``libm``.
+
+>>> import cupy as cp
+>>> import nzthermo as nzt
+>>> pressure = cp.asarray(pressure)  # (Z,)
+>>> T, Td = cp.asarray(temperature), cp.asarray(dewpoint)  # (N, Z)
+>>> dcape = nzt.downdraft_cape(pressure, T, Td)  # (N,) cupy.ndarray
+
+Only the defaults of the CPU kernels are implemented, ``method="rk2"`` for ``moist_lapse`` and
+``method="iterative"`` for ``lcl``. ``threads`` is accepted and ignored. ``cupy`` is only imported
+when a device array is passed and the module is compiled with NVRTC on first use.
+"""
+
+from __future__ import annotations
+
+import functools
+from typing import Any, Callable, TypeVar
+
+import numpy as np
+
+from ._c import PressureGrid
+from .const import E0, P0, T0, Cpd, Lv, Rd, Rv, epsilon
+
+F = TypeVar("F", bound=Callable[..., Any])
+
+THREADS_PER_BLOCK = 128
+
+_SOURCE = r"""
+template <typename T> __device__ T not_a_number() { return T(nan("")); }
+template <typename T> __device__ T infinity() { return T(__longlong_as_double(0x7ff0000000000000LL)); }
+
+template <typename T> __device__ T saturation_vapor_pressure(T temperature) {
+    return T(NZT_E0) * exp(T(17.67) * (temperature - T(NZT_T0)) / (temperature - T(29.65)));
+}
+
+template <typename T> __device__ T saturation_mixing_ratio(T pressure, T temperature) {
+    const T e = saturation_vapor_pressure(temperature);
+    return T(0.6219) * e / (pressure - e);
+}
+
+template <typename T> __device__ T vapor_pressure(T pressure, T mixing_ratio) {
+    return pressure * mixing_ratio / (T(NZT_Rd / NZT_Rv) + mixing_ratio);
+}
+
+template <typename T> __device__ T dewpoint(T vapor_pressure) {
+    const T ln = log(vapor_pressure / T(NZT_E0));
+    return T(NZT_T0) + T(243.5) * ln / (T(17.67) - ln);
+}
+
+template <typename T> __device__ T mixing_ratio(T partial_press, T total_press) {
+    return T(NZT_Rd / NZT_Rv) * partial_press / (total_press - partial_press);
+}
+
+template <typename T> __device__ T virtual_temperature(T temperature, T mixing_ratio) {
+    const T eps = T(NZT_epsilon);
+    return temperature * ((mixing_ratio + eps) / (eps * (1 + mixing_ratio)));
+}
+
+template <typename T> __device__ T potential_temperature(T pressure, T temperature) {
+    return temperature / pow(pressure / T(NZT_P0), T(NZT_Rd / NZT_Cpd));
+}
+
+template <typename T> __device__ T equivalent_potential_temperature(T pressure, T temperature, T dewpoint) {
+    const T r = saturation_mixing_ratio(pressure, dewpoint);
+    const T e = saturation_vapor_pressure(dewpoint);
+    const T t_l = 56 + 1 / (1 / (dewpoint - 56) + log(temperature / dewpoint) / 800);
+    const T th_l = potential_temperature(pressure - e, temperature) * pow(temperature / t_l, T(0.28) * r);
+    return th_l * exp(r * (1 + T(0.448) * r) * (3036 / t_l - T(1.78)));
+}
+
+template <typename T> __device__ T moist_lapse_solver(T pressure, T temperature) {
+    const T rd = T(NZT_Rd);
+    const T lv = T(NZT_Lv);
+    const T r = saturation_mixing_ratio(pressure, temperature);
+    return (rd * temperature + lv * r)
+        / (T(NZT_Cpd) + (lv * lv * r * T(NZT_epsilon) / (rd * temperature * temperature)))
+        / pressure;
+}
+
+template <typename T> __device__ T moist_lapse_integrator(T pressure, T next_pressure, T temperature, T step) {
+    int n = 1;
+    T delta = next_pressure - pressure;
+    if (fabs(delta) > step) {
+        n = (int)ceil(fabs(delta) / step);
+        delta = delta / T(n);
+    }
+    for (int s = 0; s < n; s++) {
+        const T k1 = delta * moist_lapse_solver(pressure, temperature);
+        temperature += delta * moist_lapse_solver(pressure + delta * T(0.5), temperature + k1 * T(0.5));
+        pressure += delta;
+    }
+    return temperature;
+}
+
+template <typename T> __device__ T lcl_solver(T pressure, T reference_pressure, T temperature, T mixing_ratio) {
+    const T td = dewpoint(vapor_pressure(pressure, mixing_ratio));
+    const T p = reference_pressure * pow(td / temperature, T(NZT_Cpd / NZT_Rd));
+    return isnan(p) ? pressure : p;
+}
+
+template <typename T>
+__device__ T lcl_integrator(T pressure, T temperature, T mixing_ratio, long long max_iters, T eps) {
+    T p0 = pressure;
+    for (long long i = 0; i < max_iters; i++) {
+        const T p1 = lcl_solver(p0, pressure, temperature, mixing_ratio);
+        T p2 = lcl_solver(p1, pressure, temperature, mixing_ratio);
+        const T delta = p2 - T(2) * p1 + p0;
+        if (delta) {
+            p2 = p0 - (p1 - p0) * (p1 - p0) / delta; /* delta squared */
+        }
+        const T err = p0 ? fabs((p2 - p0) / p0) : p2;
+        if (err < eps) {
+            return p2;
+        }
+        p0 = p2;
+    }
+    return not_a_number<T>();
+}
+
+template <typename T>
+__device__ T wet_bulb_normand(T pressure, T temperature, T dewpoint_, T step, long long max_iters, T eps) {
+    const T r = mixing_ratio(saturation_vapor_pressure(dewpoint_), pressure);
+    const T lcl_p = lcl_integrator(pressure, temperature, r, max_iters, eps);
+    const T lcl_t = dewpoint(vapor_pressure(lcl_p, r));
+    return moist_lapse_integrator(lcl_p, pressure, lcl_t, step);
+}
+
+/*
+ * ``pressure_stride`` is 0 when the levels are shared by every column (BROADCAST), ``Z`` for
+ * (N, Z) levels (MATRIX) and 1 with ``Z == 1`` for ELEMENT_WISE.
+ */
+template <typename T>
+__global__ void moist_lapse(
+    T* out,
+    const T* pressure,
+    const T* reference_pressure,
+    const T* temperature,
+    T step,
+    long long N,
+    long long Z,
+    long long pressure_stride,
+    T top_pressure,
+    T min_temperature
+) {
+    const long long i = blockIdx.x * (long long)blockDim.x + threadIdx.x;
+    if (i >= N) {
+        return;
+    }
+    const T* levels = pressure + i * pressure_stride;
+    T* row = out + i * Z;
+    T p = reference_pressure[i];
+    T t = temperature[i];
+    /* stopped above ``top_pressure`` or after the first level colder than ``min_temperature`` */
+    bool stopped = isnan(p) || isnan(t);
+    for (long long k = 0; k < Z; k++) {
+        stopped = stopped || levels[k] < top_pressure;
+        if (stopped || isnan(levels[k])) {
+            row[k] = not_a_number<T>();
+            continue;
+        }
+        row[k] = t = moist_lapse_integrator(p, levels[k], t, step);
+        p = levels[k];
+        stopped = t < min_temperature;
+    }
+}
+
+template <typename T>
+__global__ void lcl(
+    T* out, const T* pressure, const T* temperature, const T* dewpoint_, long long max_iters, T eps, long long N
+) {
+    const long long i = blockIdx.x * (long long)blockDim.x + threadIdx.x;
+    if (i >= N) {
+        return;
+    }
+    const T r = mixing_ratio(saturation_vapor_pressure(dewpoint_[i]), pressure[i]);
+    const T lcl_p = lcl_integrator(pressure[i], temperature[i], r, max_iters, eps);
+    out[i] = lcl_p;
+    out[N + i] = dewpoint(vapor_pressure(lcl_p, r));
+}
+
+template <typename T>
+__global__ void downdraft_cape(
+    T* out,
+    const T* pressure,
+    const T* temperature,
+    const T* dewpoint_,
+    T step,
+    long long max_iters,
+    T eps,
+    long long N,
+    long long Z,
+    long long pressure_stride
+) {
+    const long long i = blockIdx.x * (long long)blockDim.x + threadIdx.x;
+    if (i >= N) {
+        return;
+    }
+    const T* p = pressure + i * pressure_stride;
+    const T* t = temperature + i * Z;
+    const T* td = dewpoint_ + i * Z;
+
+    /* the source level, the minimum theta_e in the 700-500 hPa layer, a nan level is never picked */
+    long long k = Z;
+    T theta_e_min = infinity<T>();
+    for (long long j = 0; j < Z; j++) {
+        if (p[j] <= T(7e4) && p[j] >= T(5e4)) {
+            const T theta_e = equivalent_potential_temperature(p[j], t[j], td[j]);
+            if (theta_e < theta_e_min) {
+                theta_e_min = theta_e;
+                k = j;
+            }
+        }
+    }
+    if (k == Z) {
+        out[i] = not_a_number<T>();
+        return;
+    }
+
+    T p_prev = p[k];
+    T trace = wet_bulb_normand(p_prev, t[k], td[k], step, max_iters, eps);
+    double delta_prev = (double)(
+        virtual_temperature(t[k], saturation_mixing_ratio(p_prev, td[k]))
+        - virtual_temperature(trace, saturation_mixing_ratio(p_prev, trace))
+    );
+    double logp_prev = log((double)p_prev);
+    double dcape = 0.0;
+    for (long long j = k - 1; j >= 0; j--) {
+        if (isnan(p[j]) || isnan(t[j]) || isnan(td[j])) {
+            continue;
+        }
+        trace = moist_lapse_integrator(p_prev, p[j], trace, step);
+        const double delta = (double)(
+            virtual_temperature(t[j], saturation_mixing_ratio(p[j], td[j]))
+            - virtual_temperature(trace, saturation_mixing_ratio(p[j], trace))
+        );
+        const double logp = log((double)p[j]);
+        dcape += 0.5 * (delta + delta_prev) * (logp - logp_prev);
+        delta_prev = delta;
+        logp_prev = logp;
+        p_prev = p[j];
+    }
+    out[i] = (T)(NZT_Rd * dcape);
+}
+"""
+
+_KERNELS = ("moist_lapse", "lcl", "downdraft_cape")
+_TYPES = {np.dtype(np.float32): "float", np.dtype(np.float64): "double"}
+
+
+def is_device_array(x: Any) -> bool:
+    """A ``cupy.ndarray``, checked without importing cupy."""
+    return type(x).__module__.partition(".")[0] == "cupy"
+
+
+@functools.lru_cache(maxsize=None)
+def _module() -> Any:
+    import cupy as cp
+
+    constants = {"Rd": Rd, "Rv": Rv, "Lv": Lv, "Cpd": Cpd, "epsilon": epsilon, "T0": T0, "E0": E0, "P0": P0}
+    defines = "".join(f"#define NZT_{name} {float(value)!r}\n" for name, value in constants.items())
+    return cp.RawModule(
+        code=defines + _SOURCE,
+        options=("--std=c++14",),
+        name_expressions=[f"{k}<{t}>" for k in _KERNELS for t in _TYPES.values()],
+    )
+
+
+def _launch(name: str, dtype: np.dtype[Any], n: int, *args: Any) -> None:
+    kernel = _module().get_function(f"{name}<{_TYPES[dtype]}>")
+    blocks = (n + THREADS_PER_BLOCK - 1) // THREADS_PER_BLOCK
+    kernel((blocks,), (THREADS_PER_BLOCK,), args)
+
+
+def _resolve_dtype(dtype: Any, default: Any, out: Any) -> np.dtype[Any]:
+    if dtype is None:
+        dtype = default if out is None else out.dtype
+    dtype = np.dtype(np.float32 if np.float32 == np.dtype(dtype) else np.float64)
+    return dtype
+
+
+def _output_array(out: Any, shape: tuple[int, ...], dtype: np.dtype[Any]) -> Any:
+    # the same contract as ``_c._output_array``, the kernels write C-contiguous rows
+    import cupy as cp
+
+    if out is None:
+        return cp.empty(shape, dtype=dtype)
+    elif not is_device_array(out):
+        raise ValueError("out must be a cupy array when the inputs are on the device.")
+    elif out.shape != shape:
+        raise ValueError(f"out must have shape {shape}, got {out.shape}.")
+    elif out.dtype != dtype:
+        raise ValueError(f"out must have dtype {dtype}, got {out.dtype}.")
+    elif not out.flags.c_contiguous:
+        raise ValueError("out must be C-contiguous.")
+
+    return out
+
+
+def _device(x: Any, dtype: np.dtype[Any]) -> Any:
+    import cupy as cp
+
+    return cp.ascontiguousarray(cp.asarray(x, dtype=dtype))
+
+
+def dispatch(cuda_function: Callable[..., Any]) -> Callable[[F], F]:
+    """Route a call of the decorated CPU function to ``cuda_function`` when any of its arguments
+    is a device array."""
+
+    def decorator(function: F) -> F:
+        @functools.wraps(function)
+        def wrapper(*args: Any, **kwargs: Any) -> Any:
+            if any(map(is_device_array, args)) or any(map(is_device_array, kwargs.values())):
+                return cuda_function(*args, **kwargs)
+            return function(*args, **kwargs)
+
+        return wrapper  # type: ignore[return-value]
+
+    return decorator
+
+
+# =================================================================================================
+# .....{ kernels }.....
+# =================================================================================================
+def moist_lapse(
+    pressure: Any,
+    temperature: Any,
+    reference_pressure: Any = None,
+    *,
+    step: float = 1000.0,
+    threads: Any = None,
+    dtype: Any = None,
+    out: Any = None,
+    method: str = "rk2",
+    rtol: float = 1e-5,
+    top_pressure: float = 0.0,
+    min_temperature: float = 0.0,
+) -> Any:
+    """Device ``moist_lapse``, the broadcast mode is resolved as in the CPU kernel."""
+    import cupy as cp
+
+    if method != "rk2":
+        raise ValueError(f"the CUDA backend only implements method='rk2', got {method!r}.")
+    if isinstance(pressure, PressureGrid):
+        pressure = pressure.pressure
+        if dtype is None and out is None:
+            dtype = temperature.dtype
+
+    dtype = _resolve_dtype(dtype, pressure.dtype, out)
+    pressure, temperature = _device(pressure, dtype), _device(temperature, dtype).reshape(-1)
+    if (ndim := pressure.ndim) == 1:
+        pressure = pressure.reshape(1, -1)  # (1, Z)
+    elif ndim != 2:
+        raise ValueError("pressure must be 1D or 2D array.")
+
+    N = temperature.shape[0]
+    if not N:
+        # no columns, the empty result is still validated against or written to ``out`` as on the CPU
+        if ndim == 1 and pressure.size == 0 and reference_pressure is not None:
+            return _output_array(out, (0,), dtype)  # (N,) (N,) (N,)
+        return _output_array(out, (0, pressure.shape[1]), dtype)
+
+    element_wise = False
+    if reference_pressure is not None:
+        reference_pressure = _device(reference_pressure, dtype).reshape(-1)
+        if ndim == 1 and pressure.size == N == reference_pressure.size:
+            element_wise = True  # (N,) (N,) (N,)
+            pressure = pressure.reshape(N, 1)
+        elif N != reference_pressure.shape[0]:
+            raise ValueError("reference_pressure and temperature arrays must be the same size.")
+        elif pressure.shape[0] not in (1, N):
+            raise ValueError("Unable to determine the broadcast mode.")
+    elif ndim == 2 and N == pressure.shape[0]:
+        reference_pressure = pressure[cp.arange(N), cp.argmin(cp.isnan(pressure), axis=1)]
+    elif pressure.shape[0] == 1:
+        reference_pressure = cp.repeat(pressure[0, cp.argmin(cp.isnan(pressure[0]))], N)
+    else:
+        raise ValueError("Unable to determine the broadcast mode.")
+
+    Z = pressure.shape[1]
+    x = _output_array(out, (N,) if element_wise else (N, Z), dtype)
+    _launch(
+        "moist_lapse",
+        dtype,
+        N,
+        x,
+        pressure,
+        _device(reference_pressure, dtype),
+        temperature,
+        dtype.type(step),
+        np.int64(N),
+        np.int64(Z),
+        np.int64(0 if pressure.shape[0] == 1 and N != 1 else Z),
+        dtype.type(top_pressure),
+        dtype.type(min_temperature),
+    )
+    return x
+
+
+def lcl(
+    pressure: Any,
+    temperature: Any,
+    dewpoint: Any,
+    *,
+    max_iters: int = 50,
+    eps: float = 0.1,
+    threads: Any = None,
+    dtype: Any = None,
+    out: Any = None,
+    method: str = "iterative",
+) -> Any:
+    """Device ``lcl``, returns the ``(2, N)`` LCL pressure and temperature."""
+    if method != "iterative":
+        raise ValueError(f"the CUDA backend only implements method='iterative', got {method!r}.")
+
+    dtype = _resolve_dtype(dtype, pressure.dtype, out)
+    pressure, temperature, dewpoint = (_device(x, dtype).reshape(-1) for x in (pressure, temperature, dewpoint))
+    if not pressure.size == temperature.size == dewpoint.size:
+        raise ValueError("pressure, temperature, and dewpoint arrays must be the same size.")
+
+    N = pressure.size
+    x = _output_array(out, (2, N), dtype)
+    _launch("lcl", dtype, N, x, pressure, temperature, dewpoint, np.int64(max_iters), dtype.type(eps), np.int64(N))
+    return x
+
+
+def downdraft_cape(
+    pressure: Any,
+    temperature: Any,
+    dewpoint: Any,
+    *,
+    step: float = 1000.0,
+    max_iters: int = 50,
+    eps: float = 0.1,
+    threads: Any = None,
+    dtype: Any = None,
+    out: Any = None,
+    batch_size: Any = None,
+    max_memory: Any = None,
+) -> Any:
+    """Device ``downdraft_cape``, returns the ``(N,)`` DCAPE in ``J/kg``. The tiling options of the
+    CPU kernel are accepted and ignored, the device kernel is launched over every column at once."""
+    if isinstance(pressure, PressureGrid):
+        pressure = pressure.pressure
+
+    dtype = _resolve_dtype(dtype, temperature.dtype, out)
+    pressure, temperature, dewpoint = (_device(x, dtype) for x in (pressure, temperature, dewpoint))
+    if pressure.ndim == 1:
+        pressure = pressure.reshape(1, -1)
+    if temperature.ndim != 2 or temperature.shape != dewpoint.shape:
+        raise ValueError("temperature and dewpoint must be (N, Z) arrays of the same shape.")
+
+    N, Z = temperature.shape
+    if pressure.shape[1] != Z or pressure.shape[0] not in (1, N):
+        raise ValueError("pressure must have shape (Z,), (1, Z) or (N, Z).")
+
+    x = _output_array(out, (N,), dtype)
+    _launch(
+        "downdraft_cape",
+        dtype,
+        N,
+        x,
+        pressure,
+        temperature,
+        dewpoint,
+        dtype.type(step),
+        np.int64(max_iters),
+        dtype.type(eps),
+        np.int64(N),
+        np.int64(Z),
+        np.int64(0 if pressure.shape[0] == 1 else Z),
+    )
+    return x
@@ -6,143 +6,300 @@
 
 # pyright: reportGeneralTypeIssues=false, reportUnusedExpression=false, reportMissingImports=false
 from cython.parallel cimport parallel, prange
+from libc.stdint cimport INT64_MIN, int64_t
+
 import numpy as np
 cimport numpy as np
 
+from ._c cimport acos, asin, atan2, cos, fmod, pi, sin
+
 np.import_array()
 
+cdef:
+    double nan = float('nan')
+    double DEG = pi / 180.0
+    double UNIX_EPOCH_JD = 2440587.5    # the julian day of 1970-01-01T00:00:00
+    double J2000_JD = 2451545.0
+    size_t BLOCK = 4096                 # elements per task of the element-wise loops
+
+# the integer number of ticks per day of the datetime64 units, coarser units and units that do not
+# divide a day are converted to seconds first
+TICKS_PER_DAY = {
+    "D": 1,
+    "h": 24,
+    "m": 1440,
+    "s": 86400,
+    "ms": 86400 * 10**3,
+    "us": 86400 * 10**6,
+    "ns": 86400 * 10**9,
+}
+
+# -------------------------------------------------------------------------------------------------
+# datetime64
+# -------------------------------------------------------------------------------------------------
+cdef tuple _ticks(np.ndarray dt):
+    """The flattened ``int64`` representation of ``dt`` and its number of ticks per day, without a
+    copy for the common units."""
+    if dt.dtype.kind != "M":
+        raise ValueError(f"expected a datetime64 array, got {dt.dtype}.")
+
+    unit, count = np.datetime_data(dt.dtype)
+    per_day = TICKS_PER_DAY.get(unit, 0)
+    if not per_day or per_day % count:
+        dt = dt.astype("datetime64[s]")
+        per_day, count = 86400, 1
+
+    return dt.ravel().view(np.int64), per_day // count
+
 
-cdef double pe4dt(long year, long month, bint apply_corection = 0) noexcept nogil:
-    """POLYNOMIAL EXPRESSIONS FOR DELTA T (ΔT)
-    see: https://eclipse.gsfc.nasa.gov/SEcat5/deltatpoly.html
+cdef inline int64_t floor_divide(int64_t x, int64_t y) noexcept nogil:
+    cdef int64_t q = x / y
+    if (x % y) < 0:
+        q -= 1
+    return q
+
+
+cdef inline void civil_from_days(int64_t days, int64_t* year, int64_t* month) noexcept nogil:
+    """The proleptic gregorian year and month of a day count since 1970-01-01, in a single pass
+    without the intermediate ``datetime64[Y]`` and ``datetime64[M]`` arrays.
+
+    see: https://howardhinnant.github.io/date_algorithms.html#civil_from_days
     """
-    cdef double delta_t, u, y, t
-
-    y = year + (month - 0.5) / 12
-
-    if year < -500:
-        u = (y - 1820) / 100
-        delta_t = -20 + 32 * u**2
-    elif year < 500:
-        u = y / 100
-        delta_t = (
-            10583.6
-            - 1014.41 * u
-            + 33.78311 * u**2
-            - 5.952053 * u**3
-            - 0.1798452 * u**4
-            + 0.022174192 * u**5
-            + 0.0090316521 * u**6
-        )
-    elif year < 1600:
-        u = (y - 1000) / 100
-        delta_t = (
-            1574.2
-            - 556.01 * u
-            + 71.23472 * u**2
-            + 0.319781 * u**3
-            - 0.8503463 * u**4
-            - 0.005050998 * u**5
-            + 0.0083572073 * u**6
-        )
-    elif year < 1700:
-        t = y - 1600
-        delta_t = 120 - 0.9808 * t - 0.01532 * t**2 + t**3 / 7129
-    elif year < 1800:
-        t = y - 1700
-        delta_t = (
-            8.83
-            + 0.1603 * t
-            - 0.0059285 * t**2
-            + 0.00013336 * t**3
-            - t**4 / 1174000
-        )
-    elif year < 1860:
-        t = y - 1800
-        delta_t = (
-            13.72
-            - 0.332447 * t
-            + 0.0068612 * t**2
-            + 0.0041116 * t**3
-            - 0.00037436 * t**4
-            + 0.0000121272 * t**5
-            - 0.0000001699 * t**6
-            + 0.000000000875 * t**7
-        )
-    elif year < 1900:
-        t = y - 1860
-        delta_t = (
-            7.62
-            + 0.5737 * t
-            - 0.251754 * t**2
-            + 0.01680668 * t**3
-            - 0.0004473624 * t**4
-            + t**5 / 233174
-        )
-    elif year < 1920:
-        t = y - 1900
-        delta_t = (
-            -2.79
-            + 1.494119 * t
-            - 0.0598939 * t**2
-            + 0.0061966 * t**3
-            - 0.000197 * t**4
-        )
-    elif year < 1941:
-        t = y - 1920
-        delta_t = 21.20 + 0.84493 * t - 0.076100 * t**2 + 0.0020936 * t**3
-    elif year < 1961:
-        t = y - 1950
-        delta_t = 29.07 + 0.407 * t - t**2 / 233 + t**3 / 2547
-    elif year < 1986:
-        t = y - 1975
-        delta_t = 45.45 + 1.067 * t - t**2 / 260 - t**3 / 718
-    elif year < 2005:
-        t = y - 2000
-        delta_t = (
-            63.86
-            + 0.3345 * t
-            - 0.060374 * t**2
-            + 0.0017275 * t**3
-            + 0.000651814 * t**4
-            + 0.00002373599 * t**5
-        )
-    elif year < 2050:
-        t = y - 2000
-        delta_t = 62.92 + 0.32217 * t + 0.005589 * t**2
-    elif year < 2150:
-        delta_t = -20 + 32 * ((y - 1820) / 100) ** 2 - 0.5628 * (2150 - y)
-    else:
-        u = (y - 1820) / 100
-        delta_t = -20 + 32 * u**2
-
-    if apply_corection:
-        delta_t -= -0.000012932 * (y - 1955) ** 2
-
-    return delta_t
-
-
-cdef double[:] _delta_t(long[:] years, long[:] months):
-    cdef size_t i, N
-    cdef double[:] out
-
-    N = years.size
-    out = np.empty(N, dtype=np.float64)
+    cdef int64_t z, era, doe, yoe, doy, mp
+
+    z = days + 719468
+    era = (z if z >= 0 else z - 146096) / 146097
+    doe = z - era * 146097                                          # [0, 146096]
+    yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365     # [0, 399]
+    doy = doe - (365 * yoe + yoe / 4 - yoe / 100)                   # [0, 365]
+    mp = (5 * doy + 2) / 153                                        # [0, 11] from march
+    month[0] = mp + 3 if mp < 10 else mp - 9
+    year[0] = yoe + era * 400 + (month[0] <= 2)
+
+
+# -------------------------------------------------------------------------------------------------
+# delta_t
+# -------------------------------------------------------------------------------------------------
+# POLYNOMIAL EXPRESSIONS FOR DELTA T (ΔT)
+# see: https://eclipse.gsfc.nasa.gov/SEcat5/deltatpoly.html
+# Each era is ``(stop, y0, scale, c0, ..., c7)``, the polynomial ``c0 + c1 u + ... + c7 u^7`` in
+# ``u = (y - y0) / scale`` applies to the years before ``stop``, where ``y = year + (month - 0.5) / 12``.
+# The 2050-2150 expression ``-20 + 32 u^2 - 0.5628 (2150 - y)`` is expanded in ``u`` as well.
+_ERAS = np.array(
+    [
+        [-500, 1820, 100, -20, 0, 32, 0, 0, 0, 0, 0],
+        [500, 0, 100, 10583.6, -1014.41, 33.78311, -5.952053, -0.1798452, 0.022174192, 0.0090316521, 0],
+        [1600, 1000, 100, 1574.2, -556.01, 71.23472, 0.319781, -0.8503463, -0.005050998, 0.0083572073, 0],
+        [1700, 1600, 1, 120, -0.9808, -0.01532, 1 / 7129, 0, 0, 0, 0],
+        [1800, 1700, 1, 8.83, 0.1603, -0.0059285, 0.00013336, -1 / 1174000, 0, 0, 0],
+        [
+            1860, 1800, 1,
+            13.72, -0.332447, 0.0068612, 0.0041116, -0.00037436, 0.0000121272, -0.0000001699, 0.000000000875,
+        ],
+        [1900, 1860, 1, 7.62, 0.5737, -0.251754, 0.01680668, -0.0004473624, 1 / 233174, 0, 0],
+        [1920, 1900, 1, -2.79, 1.494119, -0.0598939, 0.0061966, -0.000197, 0, 0, 0],
+        [1941, 1920, 1, 21.20, 0.84493, -0.076100, 0.0020936, 0, 0, 0, 0],
+        [1961, 1950, 1, 29.07, 0.407, -1 / 233, 1 / 2547, 0, 0, 0, 0],
+        [1986, 1975, 1, 45.45, 1.067, -1 / 260, -1 / 718, 0, 0, 0, 0],
+        [2005, 2000, 1, 63.86, 0.3345, -0.060374, 0.0017275, 0.000651814, 0.00002373599, 0, 0],
+        [2050, 2000, 1, 62.92, 0.32217, 0.005589, 0, 0, 0, 0, 0],
+        [2150, 1820, 100, -205.724, 56.28, 32, 0, 0, 0, 0, 0],
+        [np.inf, 1820, 100, -20, 0, 32, 0, 0, 0, 0, 0],
+    ],
+    dtype=np.float64,
+)
+cdef const double[:, ::1] ERAS = _ERAS
+cdef size_t ERA_COUNT = _ERAS.shape[0]
+
+
+cdef inline double horner(const double* era, double y) noexcept nogil:
+    """The polynomial of a single row of ``ERAS`` at ``y``, the row is passed as a pointer so that
+    no memoryview slice is created per element."""
+    cdef double u, r
+    cdef size_t k
+
+    u = (y - era[1]) / era[2]
+    r = era[10]
+    for k in range(9, 2, -1):
+        r = r * u + era[k]
+    return r
+
+
+cdef size_t era_of(int64_t year, size_t era) noexcept nogil:
+    """The era of ``year`` searched from the era of the previous element, which for sorted inputs
+    spanning a few years is found without a single step."""
+    while era + 1 < ERA_COUNT and year >= ERAS[era, 0]:
+        era += 1
+    while era > 0 and year < ERAS[era - 1, 0]:
+        era -= 1
+    return era
+
+
+cdef inline double delta_t_from_days(int64_t days, size_t* era) noexcept nogil:
+    cdef int64_t year, month
+
+    civil_from_days(days, &year, &month)
+    era[0] = era_of(year, era[0])
+    return horner(&ERAS[era[0], 0], <double> year + (<double> month - 0.5) / 12.0)
+
+
+cdef void delta_t_block_(
+    double[:] out, const int64_t[:] ticks, int64_t per_day, size_t start, size_t stop
+) noexcept nogil:
+    cdef size_t i, era = 0
+
+    for i in range(start, stop):
+        if ticks[i] == INT64_MIN: # NaT
+            out[i] = nan
+        else:
+            out[i] = delta_t_from_days(floor_divide(ticks[i], per_day), &era)
+
+
+cdef void _delta_t(double[:] out, const int64_t[:] ticks, int64_t per_day):
+    cdef size_t N, b
+
+    N = ticks.shape[0]
     with nogil, parallel():
-        for i in prange(N, schedule='dynamic'):
-            out[i] = pe4dt(years[i], months[i])
+        # every block costs the same, so the blocks are divided statically and each keeps its own
+        # era from one element to the next
+        for b in prange((N + BLOCK - 1) // BLOCK, schedule='static'):
+            delta_t_block_(out, ticks, per_day, b * BLOCK, min(N, (b + 1) * BLOCK))
 
-    return out
 
 def delta_t(np.ndarray dt):
     """
-    >>> np.array(['1970-01-01T02:00:00'], dtype="datetime64[Y]").astype(np.int64) + 1970
-    array([1970])
-    >>> np.array(['1970-03-01T02:00:00'], dtype="datetime64[M]").astype(np.int64) % 12 + 1
-    array([3])
+    ΔT = TT - UT in seconds of an array of ``datetime64`` of any shape and unit, ``nan`` for NaT.
+
+    The year and month are extracted from the ``int64`` representation in a single pass and the
+    era of each element is looked up from the era of the previous one, so the sorted timestamps of
+    a forecast cycle evaluate a single polynomial with Horner's method.
+
+    >>> delta_t(np.array(["2000-01-01T00:00"], dtype="datetime64[m]"))
+    array([63.87383281])
     """
-    cdef long[:] Y = dt.astype("datetime64[Y]").astype(np.int64) + 1970
-    cdef long[:] M = dt.astype("datetime64[M]").astype(np.int64) % 12 + 1
-    return np.array(_delta_t(Y, M), dtype=np.float64, copy=False)
+    cdef np.ndarray ticks, x
+    cdef int64_t per_day
+
+    ticks, per_day = _ticks(dt)
+    x = np.empty(ticks.shape[0], dtype=np.float64)
+    _delta_t(x, ticks, per_day)
+
+    return x.reshape((<object> dt).shape)
+
+
+# -------------------------------------------------------------------------------------------------
+# solar_position
+# -------------------------------------------------------------------------------------------------
+cdef void solar_geometry_(double* out, int64_t ticks, int64_t per_day) noexcept nogil:
+    """The sine and cosine of the declination, the equation of time and the UTC minute of the day
+    of a single time, from the NOAA solar calculator (after Meeus, Astronomical Algorithms) in
+    julian centuries of terrestrial time."""
+    cdef int64_t days
+    cdef size_t era = 0
+    cdef double fraction, T, L0, M, e, C, omega, lam, eps, y, eot, decl
+
+    days = floor_divide(ticks, per_day)
+    fraction = <double> (ticks - days * per_day) / <double> per_day
+    T = (
+        <double> days + fraction + UNIX_EPOCH_JD - J2000_JD + delta_t_from_days(days, &era) / 86400.0
+    ) / 36525.0
+
+    L0 = fmod(280.46646 + T * (36000.76983 + T * 0.0003032), 360.0) * DEG  # geometric mean longitude
+    M = (357.52911 + T * (35999.05029 - 0.0001537 * T)) * DEG              # mean anomaly
+    e = 0.016708634 - T * (0.000042037 + 0.0000001267 * T)                # orbital eccentricity
+    C = (
+        sin(M) * (1.914602 - T * (0.004817 + 0.000014 * T))
+        + sin(2 * M) * (0.019993 - 0.000101 * T)
+        + sin(3 * M) * 0.000289
+    ) * DEG                                                                 # equation of the center
+    omega = (125.04 - 1934.136 * T) * DEG
+    lam = L0 + C - (0.00569 + 0.00478 * sin(omega)) * DEG                   # apparent longitude
+    eps = (
+        23.0 + (26.0 + (21.448 - T * (46.815 + T * (0.00059 - T * 0.001813))) / 60.0) / 60.0
+        + 0.00256 * cos(omega)
+    ) * DEG                                                                 # obliquity of the ecliptic
+    decl = asin(sin(eps) * sin(lam))
+
+    y = (sin(eps / 2) / cos(eps / 2)) ** 2
+    eot = 4.0 / DEG * (
+        y * sin(2 * L0)
+        - 2 * e * sin(M)
+        + 4 * e * y * sin(M) * cos(2 * L0)
+        - 0.5 * y * y * sin(4 * L0)
+        - 1.25 * e * e * sin(2 * M)
+    )                                                                       # minutes
+
+    out[0] = sin(decl)
+    out[1] = cos(decl)
+    out[2] = eot
+    out[3] = fraction * 1440.0
+
+
+cdef void _solar_position(
+    double[:, :, :] out,
+    const double[:] latitude,
+    const double[:] longitude,
+    const double[:, ::1] geometry,
+):
+    cdef size_t N, T, i, j
+    cdef double sin_lat, cos_lat, sin_decl, cos_decl, H, cos_zenith
+
+    N = latitude.shape[0]
+    T = geometry.shape[0]
+    with nogil, parallel():
+        for i in prange(N, schedule='static'):
+            sin_lat = sin(latitude[i] * DEG)
+            cos_lat = cos(latitude[i] * DEG)
+            for j in range(T):
+                sin_decl = geometry[j, 0]
+                cos_decl = geometry[j, 1]
+                # the hour angle from the true solar time, in minutes
+                H = ((geometry[j, 3] + geometry[j, 2] + 4.0 * longitude[i]) / 4.0 - 180.0) * DEG
+                cos_zenith = sin_lat * sin_decl + cos_lat * cos_decl * cos(H)
+                out[0, i, j] = acos(min(1.0, max(-1.0, cos_zenith))) / DEG
+                out[1, i, j] = fmod(
+                    atan2(sin(H), cos(H) * sin_lat - sin_decl / cos_decl * cos_lat) / DEG + 540.0, 360.0
+                )
+
+
+def solar_position(np.ndarray latitude, np.ndarray longitude, np.ndarray dt):
+    """
+    latitude and longitude shape ``(N,)`` in degrees, dt shape ``(T,)`` UTC ``datetime64``
+
+    The geometric solar zenith and azimuth (clockwise from north) angles in degrees of every point
+    at every time, without atmospheric refraction. The solar declination and the equation of time
+    only depend on the time, they are computed once per time and shared by all of the points.
+    The NOAA algorithm is accurate to about 0.01 degrees from 1800 to 2100.
+
+    Returns:
+        ``(2, N, T)`` array of the zenith and azimuth angles, ``nan`` for NaT.
+
+    >>> lat, lon = np.array([40.0, -33.9]), np.array([-105.0, 18.4])
+    >>> solar_position(lat, lon, np.arange("2024-06-21", "2024-06-22", np.timedelta64(1, "h")))
+    """
+    cdef size_t T, j
+    cdef np.ndarray ticks, geometry, x
+    cdef const int64_t[:] ticks_view
+    cdef double[:, ::1] geometry_view
+    cdef int64_t per_day
+
+    latitude, longitude = (np.asarray(v, dtype=np.float64).reshape(-1) for v in (latitude, longitude))
+    if latitude.shape[0] != longitude.shape[0]:
+        raise ValueError("latitude and longitude arrays must be the same size.")
+
+    ticks, per_day = _ticks(dt)
+    T = ticks.shape[0]
+    ticks_view = ticks
+    geometry = np.empty((T, 4), dtype=np.float64)
+    geometry_view = geometry
+    with nogil, parallel():
+        for j in prange(T, schedule='static'):
+            if ticks_view[j] == INT64_MIN:
+                geometry_view[j, 0] = geometry_view[j, 1] = geometry_view[j, 2] = geometry_view[j, 3] = nan
+            else:
+                solar_geometry_(&geometry_view[j, 0], ticks_view[j], per_day)
 
+    x = np.empty((2, latitude.shape[0], T), dtype=np.float64)
+    _solar_position(x, latitude, longitude, geometry)
 
+    return x
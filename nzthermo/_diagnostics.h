@@ -0,0 +1,94 @@
+/*
+ * Opt-in solver diagnostics, compiled in with ``-DNZTHERMO_DIAGNOSTICS`` (``setup.py --diagnostics``).
+ *
+ * Without the macro ``NZT_DIAGNOSTICS`` is 0 and every hook below is an empty inline function, so
+ * the default build is unchanged. With it the kernels record the number of moist lapse rate
+ * evaluations, a histogram of the LCL iterations, the columns whose LCL did not converge and the
+ * number of columns handled by each OpenMP thread. The counters are process wide and updated with
+ * relaxed atomics, so calls running concurrently from several Python threads are merged.
+ *
+ * A column is identified by its index along ``N`` in the call that processes it, the column loops
+ * call ``nzt_diag_column`` before the column kernel so that the solvers nested in that kernel can
+ * attribute a failure to it. The block kernels of ``_simd.h`` call ``nzt_diag_columns`` once per
+ * block of ``NZT_BLOCK`` lanes, so a failure inside a block would be reported at the index of
+ * the block's first column. They only run the fixed step RK2 integrator, which records no
+ * failures, so every recorded index is currently that of the failing column.
+ */
+#ifndef NZTHERMO_DIAGNOSTICS_H
+#define NZTHERMO_DIAGNOSTICS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#define NZT_MAX_THREADS 256
+#define NZT_LCL_HISTOGRAM_SIZE 64  /* the last bin counts every call with at least as many iterations */
+#define NZT_MAX_NONCONVERGED 4096  /* the indices beyond this are counted but not recorded */
+
+typedef struct {
+    uint64_t solver_evaluations;
+    uint64_t lcl_iterations[NZT_LCL_HISTOGRAM_SIZE];
+    uint64_t lcl_nonconverged;
+    uint64_t thread_columns[NZT_MAX_THREADS];
+    int64_t nonconverged[NZT_MAX_NONCONVERGED];
+} nzt_diagnostics_t;
+
+static nzt_diagnostics_t nzt_diagnostics;
+
+static inline nzt_diagnostics_t *nzt_get_diagnostics(void) { return &nzt_diagnostics; }
+
+static inline void nzt_reset_diagnostics(void) { memset(&nzt_diagnostics, 0, sizeof(nzt_diagnostics)); }
+
+#ifdef NZTHERMO_DIAGNOSTICS
+#define NZT_DIAGNOSTICS 1
+
+static _Thread_local int64_t nzt_diag_current_column = -1;
+
+static inline void nzt_diag_add(uint64_t *counter, uint64_t n) {
+    __atomic_fetch_add(counter, n, __ATOMIC_RELAXED);
+}
+
+/* ``n`` columns starting at ``start`` are handled by the calling thread */
+static inline void nzt_diag_columns(int64_t start, uint64_t n) {
+#ifdef _OPENMP
+    int thread = omp_get_thread_num();
+#else
+    int thread = 0;
+#endif
+    if (thread >= NZT_MAX_THREADS) {
+        thread = NZT_MAX_THREADS - 1;
+    }
+    nzt_diag_current_column = start;
+    nzt_diag_add(&nzt_diagnostics.thread_columns[thread], n);
+}
+
+static inline void nzt_diag_column(int64_t i) { nzt_diag_columns(i, 1); }
+
+static inline void nzt_diag_solver(uint64_t n) { nzt_diag_add(&nzt_diagnostics.solver_evaluations, n); }
+
+static inline void nzt_diag_lcl(size_t iterations, int converged) {
+    if (iterations >= NZT_LCL_HISTOGRAM_SIZE) {
+        iterations = NZT_LCL_HISTOGRAM_SIZE - 1;
+    }
+    nzt_diag_add(&nzt_diagnostics.lcl_iterations[iterations], 1);
+    if (!converged) {
+        const uint64_t k = __atomic_fetch_add(&nzt_diagnostics.lcl_nonconverged, 1, __ATOMIC_RELAXED);
+        if (k < NZT_MAX_NONCONVERGED) {
+            nzt_diagnostics.nonconverged[k] = nzt_diag_current_column;
+        }
+    }
+}
+#else
+#define NZT_DIAGNOSTICS 0
+
+static inline void nzt_diag_columns(int64_t start, uint64_t n) { (void)start; (void)n; }
+static inline void nzt_diag_column(int64_t i) { (void)i; }
+static inline void nzt_diag_solver(uint64_t n) { (void)n; }
+static inline void nzt_diag_lcl(size_t iterations, int converged) { (void)iterations; (void)converged; }
+#endif /* NZTHERMO_DIAGNOSTICS */
+
+#endif /* NZTHERMO_DIAGNOSTICS_H */
@@ -0,0 +1,184 @@
+/*
+ * Column batched (SIMD) kernels for the moist adiabatic lapse rate.
+ *
+ * The functions in this header advance a block of up to NZT_BLOCK parcels that share the same
+ * pressure levels. The outer loops are over levels and sub-steps, so the step count and the
+ * pressure dependent terms are computed once for the whole block, and the inner loops are over
+ * independent columns and are vectorized with ``#pragma omp simd``. The libm ``exp`` call is replaced by ``nzt_exp`` which only uses
+ * arithmetic, ``floor`` and integer bit operations so that it vectorizes without a vector math
+ * library.
+ *
+ * Runtime CPU dispatch: on x86-64 GCC the lane kernel is compiled for AVX-512F, AVX2 and the
+ * baseline ISA with ``target_clones`` and the best clone is selected by the dynamic loader when
+ * the extension is imported. NEON is part of the AArch64 baseline and needs no dispatch.
+ */
+#ifndef NZTHERMO_SIMD_H
+#define NZTHERMO_SIMD_H
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "_diagnostics.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#define NZT_BLOCK 256
+
+#if defined(__GNUC__) && !defined(__clang__) && defined(__x86_64__) && defined(__linux__)
+#define NZT_TARGET_CLONES __attribute__((target_clones("avx512f", "avx2", "default")))
+#else
+#define NZT_TARGET_CLONES
+#endif
+
+#if defined(_OPENMP) || defined(__GNUC__)
+#define NZT_PRAGMA_SIMD _Pragma("omp simd")
+#else
+#define NZT_PRAGMA_SIMD
+#endif
+
+typedef struct {
+    double Rd;
+    double Lv;
+    double Cpd;
+    double epsilon;
+    double T0;
+    double E0;
+} nzt_constants;
+
+/*
+ * exp(x) by range reduction x = k ln2 + r, |r| <= ln2 / 2 and a degree 13 Taylor polynomial,
+ * accurate to ~1 ulp for -708 <= x <= 709. The reduction runs on x clamped to that range, so the
+ * conversion of k to an integer is always defined, and the result is selected afterwards: nan
+ * for nan, inf above the range and 0 below it (the subnormal results are flushed).
+ */
+static inline double nzt_exp(double x) {
+    /* nan fails both comparisons and is clamped to the lower bound */
+    const double xc = x >= -708.0 ? (x <= 709.0 ? x : 709.0) : -708.0;
+    /* round to nearest without floor, which does not vectorize unless -fno-trapping-math */
+    const double k = (xc * 1.4426950408889634 + 0x1.8p52) - 0x1.8p52;
+    const double r = xc - k * 6.93147180369123816490e-01 - k * 1.90821492927058770002e-10;
+    double p = 1.6059043836821613e-10;
+    p = p * r + 2.0876756987868100e-09;
+    p = p * r + 2.5052108385441720e-08;
+    p = p * r + 2.7557319223985893e-07;
+    p = p * r + 2.7557319223985888e-06;
+    p = p * r + 2.4801587301587302e-05;
+    p = p * r + 1.9841269841269841e-04;
+    p = p * r + 1.3888888888888889e-03;
+    p = p * r + 8.3333333333333333e-03;
+    p = p * r + 4.1666666666666667e-02;
+    p = p * r + 1.6666666666666667e-01;
+    p = p * r + 0.5;
+    p = p * r + 1.0;
+    p = p * r + 1.0;
+
+    int64_t bits = ((int64_t)(int32_t)k + 1023) << 52;
+    double scale;
+    memcpy(&scale, &bits, sizeof(scale));
+    return x != x ? x : x > 709.0 ? INFINITY : x < -708.0 ? 0.0 : p * scale;
+}
+
+static inline double nzt_saturation_vapor_pressure(double temperature, const nzt_constants *c) {
+    return c->E0 * nzt_exp(17.67 * (temperature - c->T0) / (temperature - 29.65));
+}
+
+static inline double nzt_saturation_mixing_ratio(double pressure, double temperature, const nzt_constants *c) {
+    const double e = nzt_saturation_vapor_pressure(temperature, c);
+    return 0.6219 * e / (pressure - e);
+}
+
+/* ``inverse_pressure`` is hoisted out of the column loop by the caller */
+static inline double nzt_moist_lapse_solver(
+    double pressure, double inverse_pressure, double temperature, const nzt_constants *c
+) {
+    const double r = nzt_saturation_mixing_ratio(pressure, temperature, c);
+    return (c->Rd * temperature + c->Lv * r)
+        / (c->Cpd + (c->Lv * c->Lv * r * c->epsilon / (c->Rd * temperature * temperature)))
+        * inverse_pressure;
+}
+
+/*
+ * Advance ``n`` parcels from ``pressure`` to ``next_pressure`` with the same RK2 sub-steps as the
+ * scalar ``moist_lapse_integrator``.
+ */
+NZT_TARGET_CLONES
+static void nzt_moist_lapse_lanes(
+    double *restrict temperature,
+    size_t n,
+    double pressure,
+    double next_pressure,
+    double step,
+    const nzt_constants *c
+) {
+    size_t steps = 1;
+    double delta = next_pressure - pressure;
+    if (fabs(delta) > step) {
+        steps = (size_t)ceil(fabs(delta) / step);
+        delta = delta / (double)steps;
+    }
+    nzt_diag_solver(2 * steps * n);
+
+    for (size_t s = 0; s < steps; s++) {
+        const double midpoint = pressure + delta * 0.5;
+        const double inverse_pressure = 1.0 / pressure;
+        const double inverse_midpoint = 1.0 / midpoint;
+        NZT_PRAGMA_SIMD
+        for (size_t i = 0; i < n; i++) {
+            const double t = temperature[i];
+            const double k1 = delta * nzt_moist_lapse_solver(pressure, inverse_pressure, t, c);
+            temperature[i] = t + delta * nzt_moist_lapse_solver(midpoint, inverse_midpoint, t + k1 * 0.5, c);
+        }
+        pressure += delta;
+    }
+}
+
+/*
+ * Transpose a level-major ``(Z, n)`` block into ``n`` contiguous output rows of length ``Z``
+ * separated by ``row_stride`` elements. The output is written once and not read back, so on x86
+ * each element is written with a scalar non-temporal store (``movnti``) that goes around the
+ * cache. These are not vector streaming stores: the transpose reads the block with a stride of
+ * ``n``, so the elements of a row are not contiguous in registers, and the row start is not
+ * aligned to a vector.
+ */
+static void nzt_store_rows_d(double *out, ptrdiff_t row_stride, const double *block, size_t n, size_t Z) {
+    for (size_t i = 0; i < n; i++) {
+        double *row = out + (ptrdiff_t)i * row_stride;
+        for (size_t k = 0; k < Z; k++) {
+#if defined(__SSE2__) && defined(__x86_64__)
+            long long bits;
+            memcpy(&bits, &block[k * n + i], sizeof(bits));
+            _mm_stream_si64((long long *)&row[k], bits);
+#else
+            row[k] = block[k * n + i];
+#endif
+        }
+    }
+#if defined(__SSE2__)
+    _mm_sfence();
+#endif
+}
+
+static void nzt_store_rows_f(float *out, ptrdiff_t row_stride, const double *block, size_t n, size_t Z) {
+    for (size_t i = 0; i < n; i++) {
+        float *row = out + (ptrdiff_t)i * row_stride;
+        for (size_t k = 0; k < Z; k++) {
+#if defined(__SSE2__)
+            const float value = (float)block[k * n + i];
+            int bits;
+            memcpy(&bits, &value, sizeof(bits));
+            _mm_stream_si32((int *)&row[k], bits);
+#else
+            row[k] = (float)block[k * n + i];
+#endif
+        }
+    }
+#if defined(__SSE2__)
+    _mm_sfence();
+#endif
+}
+
+#endif /* NZTHERMO_SIMD_H */
@@ -15,6 +15,7 @@ from typing import (
     Generic,
     Literal,
     NamedTuple,
+    Sequence,
     TypeVar,
     overload,
 )
@@ -22,8 +23,22 @@ from typing import (
 import numpy as np
 from numpy.typing import NDArray
 
-from . import functional as F
-from ._c import lcl, moist_lapse
+from . import _cuda, functional as F
+from ._c import (
+    PressureGrid,
+    _batch_rows,
+    cape_cin,
+    convective_levels as _convective_levels,
+    downdraft_cape as _downdraft_cape,
+    elementwise as _elementwise,
+    lcl as _lcl,
+    mixed_parcel,
+    moist_lapse as _moist_lapse,
+    most_unstable_parcel,
+    parcel_profile as _parcel_profile,
+    sounding as _sounding,
+    wet_bulb_temperature as _wet_bulb_temperature,
+)
 from ._typing import Kelvin, Kilogram, N, Pascal, Ratio, Z, shape
 from .const import *
 
@@ -38,13 +53,34 @@ Array2d = np.ndarray[Pair[int], np.dtype[float_]]
 Indices = NDArray[np.intp]
 newaxis: Final[None] = np.newaxis
 
+# the kernels with a CUDA backend run on the device when any of their arguments is a cupy array
+moist_lapse = _cuda.dispatch(_cuda.moist_lapse)(_moist_lapse)
+lcl = _cuda.dispatch(_cuda.lcl)(_lcl)
+downdraft_cape = _cuda.dispatch(_cuda.downdraft_cape)(_downdraft_cape)
+
+
+def _promote(*args: Any) -> tuple[Any, ...]:
+    """
+    Cast the floating point arrays in ``args`` to their common dtype under the numpy promotion
+    rules, for the compiled kernels that take a single dtype. Python scalars are returned as is.
+    """
+    dtypes = [x.dtype for x in args if isinstance(x, np.ndarray) and np.issubdtype(x.dtype, np.floating)]
+    if len(set(dtypes)) < 2:
+        return args
+    dtype = np.result_type(*dtypes)
+    return tuple(x.astype(dtype, copy=False) if isinstance(x, np.ndarray) else x for x in args)
+
 
 # =================================================================================================
 # .....{ basic thermodynamics }.....
-# None of the following require any type of array broadcasting or fancy indexing
+# None of the following require any type of array broadcasting or fancy indexing, the functions
+# that take ``out`` are evaluated in a single fused and parallel pass by the compiled kernel so they
+# can be chained through one buffer without the temporaries of the numpy expressions
 # =================================================================================================
 # arg count: 1
-def dewpoint(vapor_pressure: Pascal[NDArray[float_]]) -> Kelvin[NDArray[float_]]:
+def dewpoint(
+    vapor_pressure: Pascal[NDArray[float_]], *, out: NDArray[float_] | None = None
+) -> Kelvin[NDArray[float_]]:
     """
     ther are two ways to calculate the dewpoint temperature from the vapor pressure
     ```
@@ -54,17 +90,18 @@ def dewpoint(vapor_pressure: Pascal[NDArray[float_]]) -> Kelvin[NDArray[float_]]
     ln = np.log(e / E0)
     Td = ((17.67 - ln) * T0 + 243.5 * ln) / (17.67 - ln)
     ```
+    The dewpoint is nan where the vapor pressure is not positive.
     """
-    vapor_pressure[vapor_pressure <= 0.0] = np.nan
-    ln = np.log(vapor_pressure / E0)
-    return T0 + 243.5 * ln / (17.67 - ln)
+    return _elementwise("dewpoint", vapor_pressure, out=out)
 
 
 _dewpoint: Final = dewpoint  # alias for the dewpoint function to mitigate namespace conflicts
 
 
-def saturation_vapor_pressure(temperature: Kelvin[NDArray[float_]]) -> Pascal[NDArray[float_]]:
-    return E0 * np.exp(17.67 * (temperature - T0) / (temperature - 29.65))
+def saturation_vapor_pressure(
+    temperature: Kelvin[NDArray[float_]], *, out: NDArray[float_] | None = None
+) -> Pascal[NDArray[float_]]:
+    return _elementwise("saturation_vapor_pressure", temperature, out=out)
 
 
 def mixing_ratio_from_specific_humidity(specific_humidity: Kilogram[NDArray[float_]]) -> Kilogram[NDArray[float_]]:
@@ -73,9 +110,12 @@ def mixing_ratio_from_specific_humidity(specific_humidity: Kilogram[NDArray[floa
 
 # arg count: 2
 def vapor_pressure(
-    pressure: Pascal[NDArray[float_]], mixing_ratio: Ratio[NDArray[float_] | float]
+    pressure: Pascal[NDArray[float_]],
+    mixing_ratio: Ratio[NDArray[float_] | float],
+    *,
+    out: NDArray[float_] | None = None,
 ) -> Pascal[NDArray[float_]]:
-    return pressure * mixing_ratio / ((Rd / Rv) + mixing_ratio)
+    return _elementwise("vapor_pressure", pressure, mixing_ratio, ratio=Rd / Rv, out=out)
 
 
 def exner_function(
@@ -90,8 +130,13 @@ def mixing_ratio(
     partial_press: Pascal[NDArray[float_]],
     total_press: Pascal[NDArray[float_] | float],
     molecular_weight_ratio: Ratio[NDArray[float_] | float] = Rd / Rv,
+    *,
+    out: NDArray[float_] | None = None,
 ) -> Ratio[NDArray[float_]]:
-    return molecular_weight_ratio * partial_press / (total_press - partial_press)
+    if np.ndim(molecular_weight_ratio) == 0:
+        return _elementwise("mixing_ratio", partial_press, total_press, ratio=molecular_weight_ratio, out=out)
+
+    return np.multiply(molecular_weight_ratio, partial_press / (total_press - partial_press), out=out)
 
 
 def dry_lapse(
@@ -108,9 +153,12 @@ def dry_lapse(
 
 
 def saturation_mixing_ratio(
-    pressure: Pascal[NDArray[float_]], temperature: Kelvin[NDArray[float_]]
+    pressure: Pascal[NDArray[float_]],
+    temperature: Kelvin[NDArray[float_]],
+    *,
+    out: NDArray[float_] | None = None,
 ) -> Ratio[NDArray[float_]]:
-    return mixing_ratio(saturation_vapor_pressure(temperature), pressure)
+    return _elementwise("saturation_mixing_ratio", pressure, temperature, ratio=Rd / Rv, out=out)
 
 
 # .....{ theta }.....
@@ -120,19 +168,23 @@ ThetaW = Annotated[T, "Wet bulb potential temperature"]
 
 
 def potential_temperature(
-    pressure: Pascal[NDArray[float_]], temperature: Kelvin[NDArray[float_]]
+    pressure: Pascal[NDArray[float_]],
+    temperature: Kelvin[NDArray[float_]],
+    *,
+    out: NDArray[float_] | None = None,
 ) -> Theta[Kelvin[NDArray[float_]]]:
-    return temperature / exner_function(pressure)
+    return _elementwise("potential_temperature", pressure, temperature, out=out)
 
 
 def equivalent_potential_temperature(
-    pressure: Pascal[NDArray[float_]], temperature: Kelvin[NDArray[float_]], dewpoint: Kelvin[NDArray[float_]]
+    pressure: Pascal[NDArray[float_]],
+    temperature: Kelvin[NDArray[float_]],
+    dewpoint: Kelvin[NDArray[float_]],
+    *,
+    out: NDArray[float_] | None = None,
 ) -> ThetaE[Kelvin[NDArray[float_]]]:
-    r = saturation_mixing_ratio(pressure, dewpoint)
-    e = saturation_vapor_pressure(dewpoint)
-    t_l = 56 + 1.0 / (1.0 / (dewpoint - 56) + np.log(temperature / dewpoint) / 800.0)
-    th_l = potential_temperature(pressure - e, temperature) * (temperature / t_l) ** (0.28 * r)
-    return th_l * np.exp(r * (1 + 0.448 * r) * (3036.0 / t_l - 1.78))
+    """Bolton (1980), as in MetPy."""
+    return _elementwise("equivalent_potential_temperature", pressure, temperature, dewpoint, out=out)
 
 
 # .....{ virtual temperature }.....
@@ -141,8 +193,9 @@ def virtual_temperature(
     mixing_ratio: Ratio[NDArray[float_]],
     *,
     molecular_weight_ratio: float = Rd / Rv,
+    out: NDArray[float_] | None = None,
 ) -> Kelvin[NDArray[float_]]:
-    return temperature * ((mixing_ratio + molecular_weight_ratio) / (molecular_weight_ratio * (1 + mixing_ratio)))
+    return _elementwise("virtual_temperature", temperature, mixing_ratio, ratio=molecular_weight_ratio, out=out)
 
 
 def dewpoint_from_specific_humidity(
@@ -156,16 +209,34 @@ def dewpoint_from_specific_humidity(
 # wet bulb temperature
 # -------------------------------------------------------------------------------------------------
 def wet_bulb_temperature(
-    pressure: Pascal[np.ndarray[shape[N], np.dtype[np.float32]]],
-    temperature: Kelvin[np.ndarray[shape[N], np.dtype[np.float32]]],
-    dewpoint: Kelvin[np.ndarray[shape[N], np.dtype[np.float32]]],
-) -> Kelvin[np.ndarray[shape[N], np.dtype[np.float32]]]:
-    # TODO:...
-    if not all(x.ndim == 1 for x in (pressure, temperature, dewpoint)):
-        raise NotImplementedError("Currently only support for 1D arrays")
-    lcl_p, lcl_t = lcl(pressure, temperature, dewpoint)
-
-    return moist_lapse(pressure, lcl_t, lcl_p)
+    pressure: Pascal[NDArray[float_]],
+    temperature: Kelvin[NDArray[float_]],
+    dewpoint: Kelvin[NDArray[float_]],
+    *,
+    method: Literal["normand", "stull"] = "normand",
+    step: float = 1000.0,
+    max_iters: int = 50,
+    eps: float = 0.1,
+    threads: int | None = None,
+    out: NDArray[float_] | None = None,
+) -> Kelvin[NDArray[float_]]:
+    """
+    The wet bulb temperature of inputs of any broadcastable shape, from the lcl and the moist
+    adiabatic descent back to ``pressure`` in a single compiled pass, or the closed form
+    ``method="stull"`` approximation. The result is written into ``out`` when it is provided, it
+    must have the broadcast shape and may be non-contiguous.
+    """
+    return _wet_bulb_temperature(
+        pressure,
+        temperature,
+        dewpoint,
+        method=method,
+        step=step,
+        max_iters=max_iters,
+        eps=eps,
+        threads=threads,
+        out=out,
+    )
 
 
 # -------------------------------------------------------------------------------------------------
@@ -196,6 +267,8 @@ def ccl(
     dewpoint: Kelvin[NDArray[float_]],
     *,
     which: Literal["all"] = "all",
+    batch_size: int | None = None,
+    max_memory: int | None = None,
 ) -> Pair[ConvectiveCondensationLevel[float_]]: ...
 @overload
 def ccl(
@@ -204,6 +277,8 @@ def ccl(
     dewpoint: Kelvin[NDArray[float_]],
     *,
     which: Literal["lower", "upper"] = "lower",
+    batch_size: int | None = None,
+    max_memory: int | None = None,
 ) -> ConvectiveCondensationLevel[float_]: ...
 def ccl(
     pressure: Pascal[NDArray[float_]],
@@ -211,6 +286,8 @@ def ccl(
     dewpoint: Kelvin[NDArray[float_]],
     *,
     which: Literal["lower", "upper", "all"] = "lower",
+    batch_size: int | None = None,
+    max_memory: int | None = None,
 ) -> ConvectiveCondensationLevel[float_] | Pair[ConvectiveCondensationLevel[float_]]:
     """
     # Convective Condensation Level (CCL)
@@ -220,90 +297,68 @@ def ccl(
     greater than or equal in height (lower or equal pressure level) than the LCL. The CCL and the
     LCL are equal when the atmosphere is saturated. The CCL is found at the intersection of the
     saturation mixing ratio line (through the surface dewpoint) and the environmental temperature.
+
+    The columns are processed in tiles of ``batch_size`` columns, or as many as fit in
+    ``max_memory`` bytes of ``(Z,)`` temporaries, see ``_batch_rows``. The results of the tiles are
+    written into single ``(N,)`` arrays. A ``(Z,)`` pressure is shared by every column.
     """
+    if pressure.ndim == 1:
+        pressure = pressure[newaxis, :]  # (1, Z) shared by every tile
     if temperature.ndim == 1:
         temperature = temperature[newaxis, :]
         dewpoint = dewpoint[newaxis, :]
-        pressure = pressure[newaxis, :]
     elif temperature.ndim != 2:
         raise ValueError("temperature and dewpoint must be 1D or 2D arrays")
 
+    N, Z = temperature.shape
+    levels = ("lower", "upper") if which == "all" else (which,)
+    # every tile holds the inputs cast to their common dtype and the dewpoint of the mixing ratio
+    # line, the (N,) results of the tiles are written into a single set of output arrays
+    itemsize = np.result_type(pressure, temperature, dewpoint).itemsize
+    rows = _batch_rows(N, 4 * Z * itemsize, batch_size, max_memory)
+
+    results: list[ConvectiveCondensationLevel[float_]] = []
+    for start in range(0, max(N, 1), rows):
+        s = slice(start, start + rows)
+        tile = _ccl(pressure if pressure.shape[0] == 1 else pressure[s], temperature[s], dewpoint[s], levels)
+        if rows >= N:
+            results = tile
+        else:
+            if not results:
+                results = [ConvectiveCondensationLevel(*(np.empty(N, dtype=x.dtype) for x in c)) for c in tile]
+            for result, c in zip(results, tile):
+                for x, y in zip(result, c):
+                    x[s] = y
+
+    if which != "all":
+        return results[0]
+
+    return results[0], results[1]
+
+
+def _ccl(
+    pressure: Pascal[NDArray[float_]],
+    temperature: Kelvin[NDArray[float_]],
+    dewpoint: Kelvin[NDArray[float_]],
+    levels: Sequence[Literal["lower", "upper"]],
+) -> list[ConvectiveCondensationLevel[float_]]:
+    pressure, temperature, dewpoint = _promote(pressure, temperature, dewpoint)
+
     p0 = pressure[:, 0]  # (N,)
     td0 = dewpoint[:, 0]  # (N,)
-    td = _dewpoint(  # (N, Z)
-        vapor_pressure(pressure, mixing_ratio(saturation_vapor_pressure(td0[:, newaxis]), p0[:, newaxis]))
-    )
+    # the (N,) surface mixing ratio is broadcast along the levels and the (N, Z) vapor pressure and
+    # dewpoint are computed in place in a single buffer
+    td = vapor_pressure(pressure, saturation_mixing_ratio(p0, td0)[:, newaxis])  # (N, Z)
+    td = _dewpoint(td, out=td)
 
     intersect = F.intersect_nz(pressure, td, temperature, log_x=True)  # (N, Z)
 
-    if which != "all":
-        return ConvectiveCondensationLevel.from_intersect(p0, intersect, which)
-
-    return (
-        ConvectiveCondensationLevel.from_intersect(p0, intersect, "lower"),
-        ConvectiveCondensationLevel.from_intersect(p0, intersect, "upper"),
-    )
+    return [ConvectiveCondensationLevel.from_intersect(p0, intersect, which) for which in levels]
 
 
 # -------------------------------------------------------------------------------------------------
 # Parcel Profile
 # -------------------------------------------------------------------------------------------------
-def _parcel_profile(
-    pressure: np.ndarray,
-    temperature: np.ndarray,
-    dewpoint: np.ndarray,
-    refrence_pressure: np.ndarray | None = None,
-    *,
-    axis=-1,
-):
-    Z = pressure.shape[axis]
-    P = np.reshape(np.moveaxis(pressure, axis, -1), (-1, Z))  # (N, Z)
-    T = temperature.reshape(-1, 1)  # (N, 1)
-    Td = dewpoint.reshape(-1, 1)  # (N, 1)
-    N = T.shape[0]
-
-    if refrence_pressure is None:
-        P0 = P[:, :1]
-    else:
-        P0 = refrence_pressure.reshape(-1, 1)  # (N, 1)
-
-    if not T.shape == Td.shape == P0.shape == (N, 1):
-        raise ValueError("temperature, dewpoint, and refrence pressure must have the same shape")
-    # ---------------------------------------------------------------------------------------------
-    # - Find the LCL
-    # ---------------------------------------------------------------------------------------------
-    lcl_p, lcl_t = lcl(P0, T, Td)  # ((N, 1), (N, 1))
-
-    # - lower
-    # [[101300. 100000. 97500. 95000. 94171.484 nan ...], ...] (N, Z)
-    p_mask = P >= lcl_p
-    p_lower = F.mask_insert(p_mask, P, lcl_p, kind="above", copy=False)  # (N, Z)
-    t_lower = dry_lapse(p_lower, T, P0)
-
-    # - upper
-    # [[... nan 97500. 95000. 94171.484 90000. ...], ...] (N, Z)
-    p_upper = F.mask_insert(~p_mask, P, lcl_p, kind="below", copy=False)  # (N, Z)
-    t_upper = np.full_like(t_lower, np.nan)
-
-    nans = np.isnan(t_lower) | np.isnan(p_upper)
-    nx, zx = np.nonzero(~nans)
-    _, i = np.unique(nx, return_index=True)
-    nx, zx = nx[i], zx[i]
-
-    t_upper[nx, :] = moist_lapse(
-        p_upper[nx, :],
-        t_lower[nx, zx],
-        p_upper[nx, zx],
-    )
-
-    # OKAY now concat every thing
-    index = np.nonzero(p_lower.mask)
-    p_lower[index] = p_upper[index]
-    t_lower[index] = t_upper[index]
-
-    return (p_lower.squeeze(), lcl_p.squeeze()), (t_lower.squeeze(), lcl_t.squeeze())
-
-
 class ParcelProfile(NamedTuple, Generic[float_]):
     pressure: Annotated[
         Pascal[np.ndarray[shape[N, Z], np.dtype[float_]]],
@@ -334,7 +389,7 @@ class ParcelProfile(NamedTuple, Generic[float_]):
 
 
 def parcel_profile(
-    pressure: Pascal[np.ndarray[shape[Z], np.dtype[float_]]],
+    pressure: Pascal[np.ndarray[shape[Z], np.dtype[float_]]] | PressureGrid,
     temperature: Kelvin[np.ndarray[shape[N, Z], np.dtype[float_]]],
     dewpoint: Kelvin[np.ndarray[shape[N, Z], np.dtype[float_]]],
     *,
@@ -342,101 +397,155 @@ def parcel_profile(
     temperature_2m: Kelvin[np.ndarray[shape[N], np.dtype[float_]] | None] = None,
     dewpoint_2m: Kelvin[np.ndarray[shape[N], np.dtype[float_]] | None] = None,
 ) -> ParcelProfile[float_]:
-    assert pressure.ndim == 1
-    P = pressure.reshape(1, -1)  # (1, Z)
-    T, Td = temperature, dewpoint
-    Z = T.shape[1]
-    Z += 1  # add one for the 2m values
+    """
+    Lift a parcel from the 2m values, or the first level of the profile when they are not provided,
+    dry adiabatically to the LCL and moist adiabatically above it. The LCL is inserted into the
+    profile so all of the ``(N, Z)`` fields have ``Z + 1`` levels, ``temperature`` and ``dewpoint``
+    are the environment interpolated to the LCL and ``parcel_temperature`` is the parcel trace.
 
-    if pressure_2m is not None:
-        P2 = pressure_2m.reshape(-1, 1)
-    else:
-        P2 = P[:, :1]
+    The ascent runs in a single compiled pass per column, so no intermediate ``(N, Z)`` arrays are
+    allocated beyond the outputs.
+    """
+    return ParcelProfile(
+        *_parcel_profile(pressure, temperature, dewpoint, pressure_2m, temperature_2m, dewpoint_2m)
+    )
 
-    if temperature_2m is None:
-        T2 = T[:, :1]
-    else:
-        T2 = temperature_2m.reshape(-1, 1)
 
-    if dewpoint_2m is None:
-        Td2 = Td[:, :1]
-    else:
-        Td2 = dewpoint_2m.reshape(-1, 1)
+# -------------------------------------------------------------------------------------------------
+# level of free convection and equilibrium level
+# -------------------------------------------------------------------------------------------------
+class ConvectiveLevel(NamedTuple, Generic[float_]):
+    pressure: Pascal[np.ndarray[shape[N], np.dtype[float_]]]
+    temperature: Kelvin[np.ndarray[shape[N], np.dtype[float_]]]
 
-    (pp_p, lcl_p), (pp_t, lcl_t) = _parcel_profile(P, T2, Td2, P2, axis=1)
-    if pp_t.shape == (N, Z - 1):  # concat the 2m values
-        pp_t = np.concatenate([T2, pp_t], axis=1)
 
-    interp_t, interp_td = F.interpolate_nz(lcl_p, pressure, T, Td, interp_nan=True)
+class ConvectiveLevels(NamedTuple, Generic[float_]):
+    lfc: ConvectiveLevel[float_]
+    el: ConvectiveLevel[float_]
+    cape: Annotated[np.ndarray[shape[N], np.dtype[float_]], "J/kg"]
+    cin: Annotated[np.ndarray[shape[N], np.dtype[float_]], "J/kg"]
 
-    t_new = F.insert_along_z(T, interp_t, pressure, lcl_p)
-    td_new = F.insert_along_z(Td, interp_td, pressure, lcl_p)
 
-    return ParcelProfile(
-        pressure=pp_p,
-        lcl_pressure=lcl_p,
-        temperature=pp_t,
-        parcel_temperature=t_new,
-        lcl_temperature=lcl_t,
-        dewpoint=td_new,
+def convective_levels(
+    pressure: Pascal[np.ndarray[shape[Z] | shape[N, Z], np.dtype[float_]]],
+    temperature: Kelvin[np.ndarray[shape[N, Z], np.dtype[float_]]],
+    dewpoint: Kelvin[np.ndarray[shape[N, Z], np.dtype[float_]]],
+    *,
+    which_lfc: Literal["bottom", "top", "most_cape"] = "top",
+    which_el: Literal["bottom", "top", "most_cape"] = "top",
+    virtual: bool = False,
+) -> ConvectiveLevels[float_]:
+    """
+    The Level of Free Convection (LFC), Equilibrium Level (EL), CAPE and CIN of a surface based
+    parcel. The parcel is lifted once per column and the levels and energies are all taken from the
+    same pass, so requesting them together costs the same as requesting any one of them.
+    """
+    lfc_p, lfc_t, el_p, el_t, cape, cin = _convective_levels(
+        pressure, temperature, dewpoint, which_lfc=which_lfc, which_el=which_el, virtual=virtual
     )
 
+    return ConvectiveLevels(ConvectiveLevel(lfc_p, lfc_t), ConvectiveLevel(el_p, el_t), cape, cin)
+
+
+def lfc(
+    pressure: Pascal[np.ndarray[shape[Z] | shape[N, Z], np.dtype[float_]]],
+    temperature: Kelvin[np.ndarray[shape[N, Z], np.dtype[float_]]],
+    dewpoint: Kelvin[np.ndarray[shape[N, Z], np.dtype[float_]]],
+    *,
+    which: Literal["bottom", "top", "most_cape"] = "top",
+) -> ConvectiveLevel[float_]:
+    """
+    # Level of Free Convection (LFC)
+
+    The level at which a surface based parcel becomes warmer than the environment, ``nan`` where
+    the parcel is never positively buoyant. ``which`` selects the ``"bottom"`` or ``"top"``
+    crossing, or the one at the base of the layer with the most CAPE.
+    """
+    lfc_p, lfc_t, *_ = _convective_levels(pressure, temperature, dewpoint, which_lfc=which, which_el=which)
+
+    return ConvectiveLevel(lfc_p, lfc_t)
+
+
+def el(
+    pressure: Pascal[np.ndarray[shape[Z] | shape[N, Z], np.dtype[float_]]],
+    temperature: Kelvin[np.ndarray[shape[N, Z], np.dtype[float_]]],
+    dewpoint: Kelvin[np.ndarray[shape[N, Z], np.dtype[float_]]],
+    *,
+    which: Literal["bottom", "top", "most_cape"] = "top",
+) -> ConvectiveLevel[float_]:
+    """
+    # Equilibrium Level (EL)
+
+    The level at which a surface based parcel becomes cooler than the environment again above the
+    LFC, ``nan`` where it does not exist. ``which`` selects the ``"bottom"`` or ``"top"`` crossing,
+    or the one at the top of the layer with the most CAPE.
+    """
+    _, _, el_p, el_t, *_ = _convective_levels(pressure, temperature, dewpoint, which_lfc=which, which_el=which)
+
+    return ConvectiveLevel(el_p, el_t)
+
 
 # -------------------------------------------------------------------------------------------------
-# downdraft_cape
+# sounding
 # -------------------------------------------------------------------------------------------------
-def downdraft_cape(
-    pressure: Pascal[np.ndarray[shape[Z], np.dtype[float_]]],
+SoundingField = Literal[
+    "lcl_pressure",
+    "lcl_temperature",
+    "lfc_pressure",
+    "lfc_temperature",
+    "el_pressure",
+    "el_temperature",
+    "cape",
+    "cin",
+    "dcape",
+    "ccl_pressure",
+    "ccl_temperature",
+    "convective_temperature",
+    "lifted_index",
+    "precipitable_water",
+]
+
+
+class Sounding(NamedTuple, Generic[float_]):
+    lcl_pressure: Pascal[np.ndarray[shape[N], np.dtype[float_]]]
+    lcl_temperature: Kelvin[np.ndarray[shape[N], np.dtype[float_]]]
+    lfc_pressure: Pascal[np.ndarray[shape[N], np.dtype[float_]]]
+    lfc_temperature: Kelvin[np.ndarray[shape[N], np.dtype[float_]]]
+    el_pressure: Pascal[np.ndarray[shape[N], np.dtype[float_]]]
+    el_temperature: Kelvin[np.ndarray[shape[N], np.dtype[float_]]]
+    cape: Annotated[np.ndarray[shape[N], np.dtype[float_]], "J/kg"]
+    cin: Annotated[np.ndarray[shape[N], np.dtype[float_]], "J/kg"]
+    dcape: Annotated[np.ndarray[shape[N], np.dtype[float_]], "J/kg"]
+    ccl_pressure: Pascal[np.ndarray[shape[N], np.dtype[float_]]]
+    ccl_temperature: Kelvin[np.ndarray[shape[N], np.dtype[float_]]]
+    convective_temperature: Kelvin[np.ndarray[shape[N], np.dtype[float_]]]
+    lifted_index: Kelvin[np.ndarray[shape[N], np.dtype[float_]]]
+    precipitable_water: Annotated[np.ndarray[shape[N], np.dtype[float_]], "kg/m^2"]
+
+
+def sounding(
+    pressure: Pascal[np.ndarray[shape[Z] | shape[N, Z], np.dtype[float_]]],
     temperature: Kelvin[np.ndarray[shape[N, Z], np.dtype[float_]]],
     dewpoint: Kelvin[np.ndarray[shape[N, Z], np.dtype[float_]]],
-) -> np.ndarray[shape[N], np.dtype[float_]]:
-    dtype = temperature.dtype
-    pressure, temperature, dewpoint = (x.astype(dtype) for x in (pressure, temperature, dewpoint))
+    outputs: Sequence[SoundingField] | None = None,
+    *,
+    which_lfc: Literal["bottom", "top", "most_cape"] = "bottom",
+    which_el: Literal["bottom", "top", "most_cape"] = "top",
+    virtual: bool = True,
+) -> Sounding[float_]:
+    """
+    # Sounding
 
-    assert temperature.shape == dewpoint.shape
-    N, Z = temperature.shape
-    if pressure.shape == (Z,):
-        pressure = pressure.reshape(1, Z)
-    elif pressure.shape != (1, Z):
-        raise ValueError("pressure shape must be either (Z,) or (1, Z)")
-
-    mid_layer_idx = ((pressure <= 7e4) & (pressure >= 5e4)).squeeze()
-    p_layer, t_layer, td_layer = (x[:, mid_layer_idx] for x in (pressure, temperature, dewpoint))
-
-    theta_e = equivalent_potential_temperature(p_layer, t_layer, td_layer)
-    nx, zx = np.arange(N), np.argmin(theta_e, axis=1)
-    # Tims suggestion was to allow for the parcel to potentially be conditionally based
-    p_top = p_layer[0, zx]  # (N,)
-    t_top = t_layer[nx, zx]  # (N,)
-    td_top = td_layer[nx, zx]  # (N,)
-    wb_top = wet_bulb_temperature(p_top, t_top, td_top)  # (N,)
-
-    # reshape our pressure into a 2d pressure grid and put the hard cap on everything above the hard cap
-    cap = -(np.searchsorted(np.squeeze(pressure)[::-1], np.min(p_top)) - 1)
-    pressure = pressure[0, :cap].repeat(N).reshape(-1, N).transpose()  # (N, Z -cap)
-    if not np.any(pressure):
-        return np.repeat(np.nan, N).astype(dtype)
-
-    # our moist_lapse rate function has nan ignoring capabilities
-    pressure[pressure < p_top[:, newaxis]] = np.nan
-    temperature = temperature[:, :cap]
-    dewpoint = dewpoint[:, :cap]
-
-    trace = moist_lapse(pressure, wb_top, p_top)  # (N, Z)
-    e_vt = virtual_temperature(temperature, saturation_mixing_ratio(pressure, dewpoint))  # (N, Z)
-    p_vt = virtual_temperature(trace, saturation_mixing_ratio(pressure, trace))  # (N, Z)
-
-    delta = e_vt - p_vt
-    logp = np.log(pressure)
-
-    # the np.trapz function does not support np.nan values, but we only really have a couple of unique
-    # levels in the gridded dataset. So this is really just like a loop of 4, 5 iterations
-    dcape = np.zeros(N, dtype=dtype)  # (N,)
-    batch, levels = np.nonzero(np.diff(pressure > p_top[:, newaxis], prepend=True, append=False))
-    for lvl in np.unique(levels):
-        above = levels == lvl
-        nx = batch[above]  # the sample indices
-        zx = np.s_[: np.argmin(~np.isnan(pressure[above]).any(axis=0))]
-        dcape[nx] = -(Rd * np.trapz(delta[nx, zx], logp[nx, zx], axis=1))
-
-    return dcape
+    Many diagnostics of a surface based parcel from one fused pass per column: the parcel is
+    lifted once and shared by the LCL, LFC, EL, CAPE, CIN and lifted index, and DCAPE, the lower
+    CCL and the precipitable water are computed while the column is still in cache. Only the passes
+    needed for ``outputs`` (all of them by default) are run, the other fields are ``nan``.
+
+    >>> snd = nzt.sounding(pressure, temperature, dewpoint, outputs=["cape", "cin", "lifted_index"])
+    >>> snd.cape, snd.cin, snd.lifted_index
+    """
+    return Sounding(
+        *_sounding(
+            pressure, temperature, dewpoint, outputs=outputs, which_lfc=which_lfc, which_el=which_el, virtual=virtual
+        )
+    )
@@ -1,10 +1,12 @@
 from __future__ import annotations
 
+import warnings
 from typing import Generic, Literal, NamedTuple, ParamSpec, Self, TypeVar, overload
 
 import numpy as np
 from numpy.typing import NDArray
 
+from ._c import insert as _insert, interpolate as _interpolate, intersect as _intersect
 from ._typing import N, Z, shape
 
 P = ParamSpec("P")
@@ -59,7 +61,7 @@ def interpolate_nz(  # type: ignore[overload-overlap]
     fp: np.ndarray[shape[N, Z], np.dtype[float_]],
     /,
     *,
-    mode: Literal["clip"] = ...,
+    mode: Literal["nan", "clip"] = ...,
     log_x: bool = False,
     interp_nan: bool = ...,
 ) -> np.ndarray[shape[N], np.dtype[float_]]: ...
@@ -68,7 +70,7 @@ def interpolate_nz(
     x: np.ndarray[shape[N], np.dtype[float_]],
     xp: np.ndarray[shape[Z], np.dtype[float_]],
     *args: np.ndarray[shape[N, Z], np.dtype[float_]],
-    mode: Literal["clip"] = ...,
+    mode: Literal["nan", "clip"] = ...,
     log_x: bool = False,
     interp_nan: bool = ...,
 ) -> tuple[np.ndarray[shape[N], np.dtype[float_]], ...]: ...
@@ -76,7 +78,7 @@ def interpolate_nz(
     x: np.ndarray[shape[N], np.dtype[float_]],
     xp: np.ndarray[shape[Z], np.dtype[float_]],
     *args: np.ndarray[shape[N, Z], np.dtype[float_]],
-    mode: Literal["clip"] = "clip",
+    mode: Literal["nan", "clip"] = "nan",
     log_x: bool = False,
     interp_nan: bool = False,
 ) -> np.ndarray[shape[N], np.dtype[float_]] | tuple[np.ndarray[shape[N], np.dtype[float_]], ...]:
@@ -87,12 +89,16 @@ def interpolate_nz(
         x: Input array of shape (N,) containing the values to be interpolated.
         xp: Input array of shape (Z,) containing the reference values.
         *args: Variable number of input arrays of shape (N, Z) containing additional data.
+        mode: How ``x`` outside of ``xp`` is handled, only ``"nan"`` is supported: a value of
+            ``x`` that is nan or outside of ``xp`` is nan in every field, ``interp_nan`` fills
+            them from the neighbouring values. ``"clip"``, the former name of the same
+            behaviour, is accepted with a ``DeprecationWarning``.
 
     Returns:
         np.ndarray or tuple of np.ndarray: Interpolated values for each batch.
 
     Raises:
-        None
+        ValueError: if ``mode`` is not ``"nan"`` or ``"clip"``.
 
     Examples:
         >>> lcl_p = np.array([93290.11, 92921.01, 92891.83, 93356.17, 94216.14]) # (N,)
@@ -113,21 +119,21 @@ def interpolate_nz(
         (array([296.69, 296.78, 296.68, 296.97, 297.44]), array([295.12, 294.78, 295.23, 295.42, 296.22]))
 
     """
-    fp = np.array(args)  # (B, N, Z)
-    assert fp.shape[1:] == (x.shape[0], xp.shape[0])
-    if log_x is True:
-        x = np.log(x)
-        xp = np.log(xp)
+    if mode == "clip":
+        warnings.warn(
+            "interpolate_nz(mode='clip') is deprecated, it is the same as the default mode='nan'.",
+            DeprecationWarning,
+            stacklevel=2,
+        )
+    elif mode != "nan":
+        raise ValueError(f"mode must be 'nan', got {mode!r}.")
+    # the bracketing levels of each column are found once by binary search in the compiled kernel
+    # and shared by all of the fields
+    x = _interpolate(x, xp, *args, log_x=log_x)  # (B, N)
 
-    nx, zx = indices_nz(x, xp)
-
-    x0, y0 = xp[zx], fp[:, nx, zx]
-    assert mode == "clip"
-    # TODO: add support for other modes
-    zx = np.minimum(zx + 1, xp.size - 1)  # clip
-    x1, y1 = xp[zx], fp[:, nx, zx]
-
-    x = linear_interpolate(x, x0, x1, y0, y1, log_x=False, interp_nan=interp_nan)
+    if interp_nan is True:
+        mask = np.isnan(x)
+        x[mask] = np.interp(np.flatnonzero(mask), np.flatnonzero(~mask), x[~mask])
 
     if x.shape[0] == 1:
         return x[0]
@@ -142,35 +148,14 @@ def insert_along_z(
     arr: np.ndarray[shape[N, Z], np.dtype[float_]],
     values: np.ndarray[shape[N], np.dtype[float_]],
     z: np.ndarray[shape[Z], np.dtype[float_]],
-    x: np.ndarray[shape[N] | shape[N, Z], np.dtype[float_]] | None = None,
+    x: np.ndarray[shape[N] | shape[N, Literal[1]], np.dtype[float_]] | None = None,
 ) -> np.ndarray[shape[N, Z], np.dtype[float_]]:
-    N, Z = arr.shape
-    dtype = arr.dtype
-    arr = np.pad(arr, ((0, 0), (0, 1)), mode="constant", constant_values=np.nan)
-    Z += 1
-    if x is None:
-        x = values[:, newaxis]
-    if x.ndim == 1:
-        x = x[:, np.newaxis]
-    elif not x.ndim == 2:
-        raise ValueError("x must be a 1D or 2D array")
-
-    indices = np.zeros((N, 1), dtype=int) + np.arange(Z)  # (N, Z)
-    out = np.full((N, Z), np.nan, dtype=dtype)
-    idx = np.argmin(np.abs(z[newaxis, :] - x), axis=1)
-    # insert all of our new values
-    out[np.arange(N), idx] = values
-
-    # insert all the values below the new values
-    mask = idx[:, newaxis] > indices
-    out[mask] = arr[mask]
-
-    # insert all the values above the new values
-    mask |= np.isnan(arr)  # account for the additional padding
-    nx, zx = np.nonzero(~mask)
-    out[nx, np.minimum(zx + 1, Z)] = arr[nx, zx]
-
-    return out
+    """
+    Insert ``values`` into each row of ``arr`` after the levels of the monotone ``z`` that bracket
+    ``x`` (``values`` by default), the bracket is found by binary search and the rows are copied
+    around the new level in the compiled kernel.
+    """
+    return _insert(arr, values, z, x)
 
 
 def mask_insert(
@@ -260,31 +245,25 @@ def intersect_nz(
     elif not (a.shape[0] == b.shape[0]):
         raise ValueError("a and b must have the same number of elements")
 
-    if log_x is True:
-        x = np.log(x)
-
-    mask = np.diff(np.sign(a - b), axis=-1, append=1) != 0  # (N, Z)
-    if np.sum(nah := np.all(~mask, axis=-1)):
-        mask[nah] = True
-
-    nx, z0 = np.nonzero(mask)
-    z1 = np.clip(z0 + 1, 0, Z - 1)
-
-    if x.ndim == 1:
-        x0, x1 = x[z0], x[z1]
-    else:
-        x0, x1 = x[nx, z0], x[nx, z1]
+    # the compiled kernel scans each column once for its lower and upper crossing, they are
+    # interleaved per column so that ``lower`` and ``upper`` select the first and last of each
+    lower_x, lower_y, upper_x, upper_y = _intersect(x, a, b, log_x=log_x)  # (4, N)
+    N = lower_x.shape[0]
+    x = np.stack([lower_x, upper_x], axis=1).reshape(-1)
+    y = np.stack([lower_y, upper_y], axis=1).reshape(-1)
 
-    a0, a1 = a[nx, z0], a[nx, z1]
-    b0, b1 = b[nx, z0], b[nx, z1]
+    return Intersection(x, y, np.repeat(np.arange(N), 2))  # type: ignore
 
-    delta_y0 = a0 - b0
-    delta_y1 = a1 - b1
 
-    with np.errstate(divide="ignore", invalid="ignore"):
-        x = ((delta_y1 * x0 - delta_y0 * x1)) / (delta_y1 - delta_y0)  # type: ignore
-        y = ((x - x0) / (x1 - x0)) * (a1 - a0) + a0  # type: NDArray[float_] # type: ignore
-        if log_x is True:
-            x = np.exp(x)
-
-    return Intersection(x, y, nx)  # type: ignore
+def intersections_nz(
+    x: np.ndarray[shape[Z] | shape[N, Z], np.dtype[float_]],
+    a: np.ndarray[shape[N, Z], np.dtype[float_]],
+    b: np.ndarray[shape[N, Z], np.dtype[float_]],
+    k: int,
+    *,
+    log_x: bool = False,
+) -> tuple[np.ndarray[shape[N, Z], np.dtype[float_]], np.ndarray[shape[N, Z], np.dtype[float_]]]:
+    """The ``x`` and ``y`` of the first ``k`` points where ``a`` and ``b`` cross, as ``(N, k)``
+    arrays padded with nan for the columns with fewer than ``k`` crossings."""
+    x_k, y_k = _intersect(x.squeeze(), a, b, log_x=log_x, k=k)
+    return x_k, y_k
@@ -0,0 +1,348 @@
+"""
+Chunked, streaming front end for the ``(N, Z)`` kernels.
+
+The compiled kernels operate on in memory ``np.ndarray`` inputs. The functions in this module tile
+the ``N`` dimension of any array like input that supports slicing along its first axis (``zarr``,
+``h5py``, ``np.memmap``, ``xarray.DataArray`` or ``dask.array`` backed data) into chunks sized to
+a memory budget. Reading and decoding the next chunk runs on a background thread while the OpenMP
+kernels, which release the GIL, work on the current one, so at most two chunks of inputs are held
+in memory at any time.
+
+>>> import zarr
+>>> import nzthermo.stream as nzs
+>>> store = zarr.open("era5.zarr")
+>>> pressure = store["level"][:] * 100.0  # (Z,)
+>>> T, Td = store["temperature"], store["dewpoint"]  # (N, Z) on disk
+>>> dcape = nzs.downdraft_cape(pressure, T, Td, max_memory=2**30)  # (N,)
+
+Inputs that are shared by every column, a ``(Z,)`` or ``(1, Z)`` pressure array in the
+``BROADCAST`` mode, are passed to every chunk unchanged. The results are written into ``out``
+when it is provided, which can itself be an on disk array.
+
+``map_blocks`` builds the equivalent lazy ``dask.array`` graph for inputs that are already dask
+or xarray backed. ``dask`` and ``xarray`` are only imported when they are used.
+"""
+
+from __future__ import annotations
+
+import concurrent.futures
+from typing import Any, Callable, Iterator, Sequence
+
+import numpy as np
+
+from . import core as _core
+from ._c import lcl as _lcl, moist_lapse as _moist_lapse
+
+DEFAULT_MAX_MEMORY = 256 * 2**20
+"""The default memory budget, in bytes, for a single chunk of inputs and outputs."""
+
+
+def _leading(x: Any) -> int | None:
+    shape = getattr(x, "shape", ())
+    return shape[0] if len(shape) else None
+
+
+def _column_nbytes(x: Any, dtype: np.dtype[Any] | None) -> int:
+    itemsize = np.dtype(dtype or x.dtype).itemsize
+    return itemsize * int(np.prod(x.shape[1:], dtype=np.int64))
+
+
+def chunk_size(
+    *arrays: Any,
+    max_memory: int = DEFAULT_MAX_MEMORY,
+    dtype: Any = None,
+    outputs: float = 1.0,
+) -> int:
+    """The number of columns per chunk so that, for the deepest array, the inputs and ``outputs``
+    times as many bytes of results fit in ``max_memory``. With prefetching two chunks of inputs are
+    alive at once, which is accounted for."""
+    dtype = np.dtype(dtype) if dtype is not None else None
+    inputs = sum(_column_nbytes(x, dtype) for x in arrays)
+    deepest = max((_column_nbytes(x, dtype) for x in arrays), default=0)
+    per_column = 2 * inputs + outputs * deepest
+    return max(1, int(max_memory // max(per_column, 1)))
+
+
+def iter_chunks(n: int, size: int) -> Iterator[slice]:
+    for start in range(0, n, size):
+        yield slice(start, min(start + size, n))
+
+
+def _load(args: Sequence[Any], tiled: Sequence[bool], s: slice, dtype: Any) -> tuple[Any, ...]:
+    # reading from the underlying store and decoding happens here, on the prefetch thread
+    return tuple(
+        np.asarray(x[s], dtype=dtype) if t else x for x, t in zip(args, tiled)  # type: ignore[call-overload]
+    )
+
+
+def map_chunks(
+    func: Callable[..., Any],
+    *args: Any,
+    tiled: Sequence[bool],
+    chunks: int | None = None,
+    max_memory: int = DEFAULT_MAX_MEMORY,
+    cast: Any = None,
+    prefetch: bool = True,
+    **kwargs: Any,
+) -> Iterator[tuple[slice, Any]]:
+    """
+    Call ``func`` on consecutive chunks of the ``N`` dimension, yielding ``(slice, result)`` pairs.
+
+    ``tiled`` marks which of the positional ``args`` are sliced along their first axis, the others
+    are passed whole to every call. The loaded chunks are converted to ``cast`` when it is not None.
+    When ``prefetch`` is true the next chunk is loaded on a background thread while ``func`` runs
+    on the current one (double buffering).
+    """
+    if len(tiled) != len(args):
+        raise ValueError("tiled must have the same length as args.")
+    lengths = {_leading(x) for x, t in zip(args, tiled) if t and x is not None}
+    if len(lengths) != 1:
+        raise ValueError("the tiled arrays must have the same leading dimension.")
+    (n,) = lengths
+    assert n is not None
+    tiled = [t and x is not None for x, t in zip(args, tiled)]
+    # shared inputs are read once, the kernels require in memory arrays
+    args = tuple(x if t or x is None else np.asarray(x, dtype=cast) for x, t in zip(args, tiled))
+    if chunks is None:
+        chunks = chunk_size(*(x for x, t in zip(args, tiled) if t), max_memory=max_memory, dtype=cast)
+    slices = list(iter_chunks(n, chunks))
+    if not slices:
+        return
+
+    if not prefetch:
+        for s in slices:
+            yield s, func(*_load(args, tiled, s, cast), **kwargs)
+        return
+
+    with concurrent.futures.ThreadPoolExecutor(max_workers=1, thread_name_prefix="nzthermo") as pool:
+        future = pool.submit(_load, args, tiled, slices[0], cast)
+        for i, s in enumerate(slices):
+            inputs = future.result()
+            if i + 1 < len(slices):  # decode the next chunk while the kernel runs on this one
+                future = pool.submit(_load, args, tiled, slices[i + 1], cast)
+            yield s, func(*inputs, **kwargs)
+
+
+def _index(axis: int, s: slice) -> tuple[slice, ...]:
+    return (slice(None),) * axis + (s,)
+
+
+def _gather(
+    results: Iterator[tuple[slice, Any]],
+    n: int,
+    axis: int,
+    out: Any = None,
+) -> Any:
+    """Write the chunked results into ``out``, allocating it from the first chunk when it is None.
+    Tuple results (including named tuples) are gathered element by element."""
+    for s, result in results:
+        is_tuple = isinstance(result, tuple)
+        leaves = result if is_tuple else (result,)
+        if out is None:
+            buffers = []
+            for x in leaves:
+                shape = list(x.shape)
+                shape[axis] = n
+                buffers.append(np.empty(shape, dtype=x.dtype))
+            if not is_tuple:
+                out = buffers[0]
+            elif hasattr(result, "_fields"):  # named tuple
+                out = type(result)(*buffers)
+            else:
+                out = tuple(buffers)
+
+        for dst, x in zip(out if is_tuple else (out,), leaves):
+            dst[_index(axis, s)] = x
+
+    return out
+
+
+def _is_shared_pressure(pressure: Any, n: int | None) -> bool:
+    return pressure.ndim == 1 or (pressure.shape[0] == 1 and n != 1)
+
+
+# =================================================================================================
+# .....{ streaming kernels }.....
+# =================================================================================================
+def moist_lapse(
+    pressure: Any,
+    temperature: Any,
+    reference_pressure: Any = None,
+    *,
+    chunks: int | None = None,
+    max_memory: int = DEFAULT_MAX_MEMORY,
+    prefetch: bool = True,
+    out: Any = None,
+    **kwargs: Any,
+) -> Any:
+    """Chunked ``moist_lapse``, the ``BROADCAST``, ``MATRIX`` and ``ELEMENT_WISE`` modes are
+    preserved within each chunk."""
+    n = _leading(temperature)
+    element_wise = reference_pressure is not None and pressure.ndim == 1 and pressure.shape[0] == n
+    tiled = (element_wise or not _is_shared_pressure(pressure, n), True, True)
+    results = map_chunks(
+        _moist_lapse,
+        pressure,
+        temperature,
+        reference_pressure,
+        tiled=tiled,
+        chunks=chunks,
+        max_memory=max_memory,
+        cast=kwargs.get("dtype"),
+        prefetch=prefetch,
+        **kwargs,
+    )
+    return _gather(results, n or 0, 0, out)
+
+
+def lcl(
+    pressure: Any,
+    temperature: Any,
+    dewpoint: Any,
+    *,
+    chunks: int | None = None,
+    max_memory: int = DEFAULT_MAX_MEMORY,
+    prefetch: bool = True,
+    out: Any = None,
+    **kwargs: Any,
+) -> Any:
+    """Chunked ``lcl``, returns the ``(2, N)`` LCL pressure and temperature."""
+    results = map_chunks(
+        _lcl,
+        pressure,
+        temperature,
+        dewpoint,
+        tiled=(True, True, True),
+        chunks=chunks,
+        max_memory=max_memory,
+        cast=kwargs.get("dtype"),
+        prefetch=prefetch,
+        **kwargs,
+    )
+    return _gather(results, _leading(temperature) or 0, 1, out)
+
+
+def downdraft_cape(
+    pressure: Any,
+    temperature: Any,
+    dewpoint: Any,
+    *,
+    chunks: int | None = None,
+    max_memory: int = DEFAULT_MAX_MEMORY,
+    prefetch: bool = True,
+    out: Any = None,
+    **kwargs: Any,
+) -> Any:
+    """Chunked ``downdraft_cape``, returns the ``(N,)`` DCAPE."""
+    n = _leading(temperature)
+    results = map_chunks(
+        _core.downdraft_cape,
+        pressure,
+        temperature,
+        dewpoint,
+        tiled=(not _is_shared_pressure(pressure, n), True, True),
+        chunks=chunks,
+        max_memory=max_memory,
+        cast=kwargs.get("dtype"),
+        prefetch=prefetch,
+        **kwargs,
+    )
+    return _gather(results, n or 0, 0, out)
+
+
+def ccl(
+    pressure: Any,
+    temperature: Any,
+    dewpoint: Any,
+    *,
+    which: str = "lower",
+    chunks: int | None = None,
+    max_memory: int = DEFAULT_MAX_MEMORY,
+    prefetch: bool = True,
+    out: Any = None,
+) -> Any:
+    """Chunked ``ccl``, returns a ``ConvectiveCondensationLevel`` of ``(N,)`` arrays. ``which="all"``
+    is not supported, call it once for ``"lower"`` and once for ``"upper"``."""
+    if which not in ("lower", "upper"):
+        raise ValueError("which must be either 'lower' or 'upper'.")
+    n = _leading(temperature)
+    results = map_chunks(
+        _core.ccl,
+        pressure,
+        temperature,
+        dewpoint,
+        tiled=(not _is_shared_pressure(pressure, n), True, True),
+        chunks=chunks,
+        max_memory=max_memory,
+        prefetch=prefetch,
+        which=which,
+    )
+    return _gather(results, n or 0, 0, out)
+
+
+# =================================================================================================
+# .....{ dask / xarray }.....
+# =================================================================================================
+def map_blocks(
+    func: Callable[..., np.ndarray],
+    *args: Any,
+    tiled: Sequence[bool],
+    axis: int = 0,
+    chunks: int | None = None,
+    max_memory: int = DEFAULT_MAX_MEMORY,
+    **kwargs: Any,
+) -> Any:
+    """
+    Build a lazy ``dask.array`` that applies ``func`` block by block along the ``N`` dimension.
+
+    Tiled inputs are rechunked to a single chunk along every axis but the first, shared inputs are
+    computed and passed whole. ``xarray.DataArray`` inputs are unwrapped to their underlying data.
+    ``func`` must return a single array with the ``N`` dimension at ``axis``, e.g. ``moist_lapse``,
+    ``lcl`` (``axis=1``) or ``downdraft_cape``.
+
+    >>> import xarray as xr
+    >>> ds = xr.open_zarr("era5.zarr")
+    >>> dcape = map_blocks(
+    ...     nzt.downdraft_cape, pressure, ds["t"].data, ds["td"].data, tiled=(False, True, True)
+    ... ).compute()
+    """
+    import dask.array as da
+
+    args = tuple(getattr(x, "data", x) if type(x).__module__.startswith("xarray") else x for x in args)
+    tiled_arrays = [x for x, t in zip(args, tiled) if t]
+    if chunks is None:
+        chunks = chunk_size(*tiled_arrays, max_memory=max_memory, dtype=kwargs.get("dtype"))
+
+    blocks = []
+    for x, t in zip(args, tiled):
+        if t:
+            x = da.asarray(x)
+            x = x.rechunk((chunks,) + tuple(-1 for _ in x.shape[1:]))
+        elif isinstance(x, da.Array):
+            x = x.compute()
+        blocks.append(x)
+
+    n = tiled_arrays[0].shape[0]
+    sample = func(*(np.asarray(x[:1]) if t else x for x, t in zip(blocks, tiled)), **kwargs)
+    out_chunks = [(s,) for s in sample.shape]
+    out_chunks[axis] = tuple(b.stop - b.start for b in iter_chunks(n, chunks))
+
+    def block(*xs: Any) -> np.ndarray:
+        return func(*xs, **kwargs)
+
+    # tiled arrays share the "n" index and are concatenated along the others, shared arrays are
+    # passed whole to every block
+    index: list[Any] = []
+    for x, t in zip(blocks, tiled):
+        index += [x, "n" + "".join(f"z{i}" for i in range(1, x.ndim))] if t else [x, None]
+
+    out_index = "".join("n" if i == axis else f"o{i}" for i in range(sample.ndim))
+    return da.blockwise(
+        block,
+        out_index,
+        *index,
+        concatenate=True,
+        dtype=sample.dtype,
+        adjust_chunks={"n": out_chunks[axis]},
+        new_axes={k: v[0] for k, v in zip(out_index, out_chunks) if k != "n"},
+    )
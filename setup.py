@@ -12,7 +12,8 @@ include_dirs: list[str] = [np.get_include()]
 compiler_directives: dict[str, int | bool] = {"language_level": 3}
 define_macros: list[tuple[str, str | None]] = [("NPY_NO_DEPRECATED_API", "NPY_1_7_API_VERSION")]
 extra_link_args: list[str] = []
-extra_compile_args: list[str] = []
+# the column batched kernels in nzthermo/_simd.h rely on ``#pragma omp simd`` even without OpenMP
+extra_compile_args: list[str] = ["-fopenmp-simd"]
 purge = False
 
 if "--production" in sys.argv:
@@ -30,6 +31,13 @@ if tuple(sys.argv[1:3]) == ("clean", "--all"):
             os.remove(file)
 
 
+if "--diagnostics" in sys.argv:
+    print("=" * 100, "compiling with diagnostics", "=" * 100)
+    sys.argv.remove("--diagnostics")
+    # the solver counters in nzthermo/_diagnostics.h, see nzthermo.diagnostics
+    define_macros.append(("NZTHERMO_DIAGNOSTICS", "1"))
+
+
 if "--coverage" in sys.argv:
     if purge is True:
         raise ValueError("Cannot compile for coverage and production at the same time.")
@@ -40,16 +48,8 @@ if "--coverage" in sys.argv:
     # and include the following trace macros
     define_macros.extend([("CYTHON_TRACE", "1"), ("CYTHON_TRACE_NOGIL", "1")])
 else:
-    # runtime:
-    #   The schedule and chunk size are taken from the runtime scheduling variable, which can be set
-    #   through the openmp.omp_set_schedule() function call, or the OMP_SCHEDULE environment variable.
-    #   Note that this essentially disables any static compile time optimisations of the scheduling code
-    #   itself and may therefore show a slightly worse performance than when the same scheduling policy
-    #   is statically configured at compile time.
-    if (omp := os.getenv("OMP_SCHEDULE", "dynamic")) not in ("static", "dynamic", "guided", "auto"):
-        raise OSError(f"the provided ``OMP_SCHEDULE`` is invalid got := {omp}")
-    os.environ["OMP_SCHEDULE"] = omp
-    define_macros += [("OMP_SCHEDULE", omp)]
+    # the thread count and the schedule of the column loops are selected at runtime, see
+    # nzthermo.set_num_threads and nzthermo.set_schedule
     extra_compile_args += ["-fopenmp"]
     extra_link_args += ["-fopenmp"]
 
@@ -57,6 +57,7 @@ extension_modules = [
     setuptools.Extension(
         "nzthermo._c",
         ["nzthermo/_c.pyx"],
+        depends=["nzthermo/_simd.h", "nzthermo/_diagnostics.h"],
         include_dirs=include_dirs,
         define_macros=define_macros,
         extra_compile_args=extra_compile_args,
@@ -0,0 +1,133 @@
+from __future__ import annotations
+
+import metpy.calc as mpcalc
+import numpy as np
+import pytest
+from metpy.units import units
+from numpy.testing import assert_allclose
+
+from nzthermo.core import cape_cin, convective_levels, el, lfc, mixed_parcel, most_unstable_parcel
+
+pressure = np.array(
+    [1013, 1000, 975, 950, 925, 900, 875, 850, 825, 800, 775, 750, 725, 700, 650, 600, 550, 500, 450, 400, 350, 300],
+)
+pressure *= 100
+temperature = np.array(
+    [
+        [243, 242, 241, 240, 239, 237, 236, 235, 233, 232, 231, 229, 228, 226, 235, 236, 234, 231, 226, 221, 217, 211],
+        [250, 249, 248, 247, 246, 244, 243, 242, 240, 239, 238, 236, 235, 233, 240, 239, 236, 232, 227, 223, 217, 211],
+        [293, 292, 290, 288, 287, 285, 284, 282, 281, 279, 279, 280, 279, 278, 275, 270, 268, 264, 260, 254, 246, 237],
+        [300, 299, 297, 295, 293, 291, 292, 291, 291, 289, 288, 286, 285, 285, 281, 278, 273, 268, 264, 258, 251, 242],
+    ]
+)
+dewpoint = np.array(
+    [
+        [224, 224, 224, 224, 224, 223, 223, 223, 223, 222, 222, 222, 221, 221, 233, 233, 231, 228, 223, 218, 213, 207],
+        [233, 233, 232, 232, 232, 232, 231, 231, 231, 231, 230, 230, 230, 229, 237, 236, 233, 229, 223, 219, 213, 207],
+        [288, 288, 287, 286, 281, 280, 279, 277, 276, 275, 270, 258, 244, 247, 243, 254, 262, 248, 229, 232, 229, 224],
+        [294, 294, 293, 292, 291, 289, 285, 282, 280, 280, 281, 281, 278, 274, 273, 269, 259, 246, 240, 241, 226, 219],
+    ]
+)
+
+
+def metpy_cape_cin(i: int) -> tuple[float, float]:
+    # with the lcl inserted into the profile metpy integrates over the same nodes as the kernel
+    p, t, td, prof = mpcalc.parcel_profile_with_lcl(
+        pressure * units.pascal, temperature[i] * units.kelvin, dewpoint[i] * units.kelvin
+    )
+    cape, cin = mpcalc.cape_cin(p, t, td, prof)
+    return cape.m, cin.m
+
+
+@pytest.mark.parametrize("dtype", [np.float64, np.float32])
+def test_cape_cin(dtype) -> None:
+    cape, cin = cape_cin(pressure.astype(dtype), temperature.astype(dtype), dewpoint.astype(dtype))
+    assert cape.dtype == cin.dtype == np.dtype(dtype)
+    expected = np.array([metpy_cape_cin(i) for i in range(len(temperature))])
+    assert_allclose(cape, expected[:, 0], rtol=1e-2, atol=1.0)
+    assert_allclose(cin, expected[:, 1], rtol=1e-2, atol=1.0)
+
+
+def test_cape_cin_reference_parcel() -> None:
+    # lifting from the first level explicitly is the same as the surface based default
+    P, T, Td = (x.astype(np.float64) for x in (pressure, temperature, dewpoint))
+    N = len(T)
+    assert_allclose(
+        cape_cin(P, T, Td, np.repeat(P[0], N), T[:, 0], Td[:, 0]),
+        cape_cin(P, T, Td),
+    )
+    # MATRIX: (N, Z) pressure
+    assert_allclose(cape_cin(np.tile(P, (N, 1)), T, Td), cape_cin(P, T, Td))
+
+
+def metpy_lfc_el(i: int, which: str) -> tuple[float, float, float, float]:
+    p, t, td = pressure * units.pascal, temperature[i] * units.kelvin, dewpoint[i] * units.kelvin
+    prof = mpcalc.parcel_profile(p, t[0], td[0])
+    lfc_p, lfc_t = mpcalc.lfc(p, t, td, prof, which=which)
+    el_p, el_t = mpcalc.el(p, t, td, prof, which=which)
+    return lfc_p.to("Pa").m, lfc_t.to("K").m, el_p.to("Pa").m, el_t.to("K").m
+
+
+@pytest.mark.parametrize("which", ["bottom", "top"])
+def test_lfc_el(which) -> None:
+    P, T, Td = (x.astype(np.float64) for x in (pressure, temperature, dewpoint))
+    expected = np.array([metpy_lfc_el(i, which) for i in range(len(T))])
+
+    lfc_p, lfc_t = lfc(P, T, Td, which=which)
+    assert_allclose(lfc_p, expected[:, 0], rtol=1e-2)
+    assert_allclose(lfc_t, expected[:, 1], atol=1.0)
+
+    el_p, el_t = el(P, T, Td, which=which)
+    assert_allclose(el_p, expected[:, 2], rtol=1e-2)
+    assert_allclose(el_t, expected[:, 3], atol=1.0)
+
+
+def test_convective_levels() -> None:
+    P, T, Td = (x.astype(np.float64) for x in (pressure, temperature, dewpoint))
+    # a single pass gives the same levels as the separate calls
+    levels = convective_levels(P, T, Td, which_lfc="bottom", which_el="bottom")
+    assert_allclose(levels.lfc, lfc(P, T, Td, which="bottom"))
+    assert_allclose(levels.el, el(P, T, Td, which="bottom"))
+    # and with virtual temperature the same energies as cape_cin
+    levels = convective_levels(P, T, Td, which_lfc="bottom", which_el="top", virtual=True)
+    assert_allclose(np.stack([levels.cape, levels.cin]), cape_cin(P, T, Td))
+    # the most cape layer never has less cape than the bottom to top one
+    most = convective_levels(P, T, Td, which_lfc="most_cape", which_el="most_cape", virtual=True)
+    assert np.all(most.cape >= levels.cape - 1e-6)
+    # the levels are nan where the parcel is never buoyant
+    assert np.all(np.isnan(levels.lfc.pressure) == (levels.cape == 0.0))
+
+    with pytest.raises(ValueError):
+        lfc(P, T, Td, which="wide")  # type: ignore[arg-type]
+
+
+def test_mixed_parcel() -> None:
+    P, T, Td = (x.astype(np.float64) for x in (pressure, temperature, dewpoint))
+    p0, t0, td0 = mixed_parcel(P, T, Td)
+    for i in range(len(T)):
+        p_, t_, td_ = mpcalc.mixed_parcel(P * units.pascal, T[i] * units.kelvin, Td[i] * units.kelvin)
+        assert_allclose(p0[i], p_.m_as("Pa"))
+        assert_allclose(t0[i], t_.m_as("K"), atol=0.1)
+        assert_allclose(td0[i], td_.m_as("K"), atol=0.1)
+
+    # the parcel is selected in the same pass as the ascent
+    assert_allclose(cape_cin(P, T, Td, parcel="mixed_layer"), cape_cin(P, T, Td, p0, t0, td0))
+
+
+def test_most_unstable_parcel() -> None:
+    P, T, Td = (x.astype(np.float64) for x in (pressure, temperature, dewpoint))
+    p0, t0, td0 = most_unstable_parcel(P, T, Td)
+    for i in range(len(T)):
+        p_, t_, td_, _ = mpcalc.most_unstable_parcel(P * units.pascal, T[i] * units.kelvin, Td[i] * units.kelvin)
+        assert_allclose(p0[i], p_.m_as("Pa"))
+        assert_allclose(t0[i], t_.m_as("K"))
+        assert_allclose(td0[i], td_.m_as("K"))
+
+    assert_allclose(cape_cin(P, T, Td, parcel="most_unstable"), cape_cin(P, T, Td, p0, t0, td0))
+
+    with pytest.raises(ValueError):
+        cape_cin(P, T, Td, p0, t0, td0, parcel="most_unstable")
+    with pytest.raises(ValueError):
+        cape_cin(P, T, Td, parcel="lowest")
+    with pytest.raises(ValueError):
+        cape_cin(P, T, Td, depth=30000.0)  # the surface parcel has no depth
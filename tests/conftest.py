@@ -0,0 +1,10 @@
+import pytest
+
+
+@pytest.fixture
+def cp():
+    """``cupy`` for the CUDA backend tests, skipped without it or without a device."""
+    cupy = pytest.importorskip("cupy")
+    if not cupy.cuda.is_available():
+        pytest.skip("no CUDA device available")
+    return cupy
@@ -6,7 +6,23 @@ import pytest
 from metpy.units import units
 from numpy.testing import assert_allclose
 
-from nzthermo.core import ccl, lcl, wet_bulb_temperature
+from nzthermo._c import elementwise
+from nzthermo.core import (
+    ccl,
+    dewpoint,
+    dry_lapse,
+    equivalent_potential_temperature,
+    exner_function,
+    lcl,
+    mixing_ratio,
+    parcel_profile,
+    potential_temperature,
+    saturation_mixing_ratio,
+    saturation_vapor_pressure,
+    vapor_pressure,
+    virtual_temperature,
+    wet_bulb_temperature,
+)
 
 
 def pressure_levels(sfc=1013.25, dtype: Any = np.float64):
@@ -15,6 +31,29 @@ def pressure_levels(sfc=1013.25, dtype: Any = np.float64):
     return np.array(pressure, dtype=dtype) * 100.0
 
 
+PRESSURE_LEVELS = np.array(
+    [101300.0, 100000.0, 97500.0, 95000.0, 92500.0, 90000.0, 87500.0, 85000.0, 82500.0, 80000.0],
+)  # (Z,)
+TEMPERATURE = np.array(
+    [
+        [303.3, 302.36, 300.16, 298.0, 296.09, 296.73, 295.96, 294.79, 293.51, 291.81],
+        [303.58, 302.6, 300.41, 298.24, 296.49, 295.35, 295.62, 294.43, 293.27, 291.6],
+        [303.75, 302.77, 300.59, 298.43, 296.36, 295.15, 295.32, 294.19, 292.84, 291.54],
+        [303.46, 302.51, 300.34, 298.19, 296.34, 295.51, 295.06, 293.84, 292.42, 291.1],
+        [303.23, 302.31, 300.12, 297.97, 296.28, 295.68, 294.83, 293.67, 292.56, 291.47],
+    ],
+)  # (N, Z)
+DEWPOINT = np.array(
+    [
+        [297.61, 297.36, 296.73, 296.05, 294.69, 289.18, 286.82, 285.82, 284.88, 283.81],
+        [297.62, 297.36, 296.79, 296.18, 294.5, 292.07, 287.74, 286.67, 285.15, 284.02],
+        [297.76, 297.51, 296.91, 296.23, 295.05, 292.9, 288.86, 287.12, 285.99, 283.98],
+        [297.82, 297.56, 296.95, 296.23, 295.0, 292.47, 289.97, 288.45, 287.09, 285.17],
+        [298.22, 297.95, 297.33, 296.69, 295.19, 293.16, 291.42, 289.66, 287.28, 284.31],
+    ],
+)  # (N, Z)
+
+
 @pytest.mark.parametrize("dtype", [np.float64, np.float32])
 def test_wet_bulb_temperature(dtype):
     pressure = np.array([912.12, 1012.93], dtype=dtype) * 100.0  # (N,) :: surface pressure
@@ -33,6 +72,104 @@ def test_wet_bulb_temperature(dtype):
     )
 
 
+def test_wet_bulb_temperature_nd() -> None:
+    # (N, Z) inputs are computed element-wise and keep their shape
+    T = TEMPERATURE.astype(np.float64)
+    Td = DEWPOINT.astype(np.float64)
+    P = np.broadcast_to(PRESSURE_LEVELS, T.shape)
+    tw = wet_bulb_temperature(P, T, Td)
+    assert tw.shape == T.shape
+    assert_allclose(tw.ravel(), wet_bulb_temperature(P.ravel(), T.ravel(), Td.ravel()))
+    # the pressure is broadcast
+    assert_allclose(wet_bulb_temperature(PRESSURE_LEVELS, T, Td), tw)
+    assert np.all((Td - 1e-3 <= tw) & (tw <= T + 1e-3))
+
+    # a non-contiguous out is written through a buffer
+    out = np.full(T.shape[::-1], np.nan).T
+    assert wet_bulb_temperature(P, T, Td, out=out) is out
+    assert_allclose(out, tw)
+
+    # the stull fit is valid near sea level
+    stull = wet_bulb_temperature(np.full_like(T, 101325.0), T, Td, method="stull")
+    assert_allclose(stull, wet_bulb_temperature(np.full_like(T, 101325.0), T, Td), atol=1.0)
+
+    with pytest.raises(ValueError):
+        wet_bulb_temperature(P, T, Td, method="davies-jones")  # type: ignore[arg-type]
+
+
+@pytest.mark.parametrize("dtype", [np.float64, np.float32])
+def test_elementwise(dtype) -> None:
+    P, T, Td = (x.astype(dtype) for x in (PRESSURE_LEVELS, TEMPERATURE, DEWPOINT))  # (Z,) and (N, Z)
+    p, t, td = P * units.pascal, T * units.kelvin, Td * units.kelvin
+
+    r = saturation_mixing_ratio(P, Td)
+    assert r.shape == T.shape and r.dtype == np.dtype(dtype)
+    assert_allclose(r, mpcalc.saturation_mixing_ratio(p, td).m, rtol=1e-4)
+    assert_allclose(mixing_ratio(saturation_vapor_pressure(Td), P), r, rtol=1e-6)
+    assert_allclose(dewpoint(vapor_pressure(P, r)), Td, rtol=1e-5)
+    assert_allclose(potential_temperature(P, T), mpcalc.potential_temperature(p, t).m, rtol=1e-5)
+    assert_allclose(
+        equivalent_potential_temperature(P, T, Td), mpcalc.equivalent_potential_temperature(p, t, td).m, rtol=1e-4
+    )
+    assert_allclose(virtual_temperature(T, r), mpcalc.virtual_temperature(t, r * units("kg/kg")).m, rtol=1e-5)
+    assert np.isnan(dewpoint(np.array([0.0, -1.0], dtype=dtype))).all()
+
+
+def test_elementwise_out() -> None:
+    P = np.broadcast_to(PRESSURE_LEVELS, TEMPERATURE.shape)
+    theta = potential_temperature(P, TEMPERATURE)
+
+    # in place, the output is one of the arguments
+    x = TEMPERATURE.copy()
+    assert potential_temperature(P, x, out=x) is x
+    assert_allclose(x, theta)
+
+    # a strided output
+    out = np.empty(TEMPERATURE.shape[::-1]).T
+    potential_temperature(P, TEMPERATURE, out=out)
+    assert_allclose(out, theta)
+
+    # scalars, 0-d and empty arrays
+    assert_allclose(elementwise("potential_temperature", 100000.0, 300.0), 300.0)
+    assert elementwise("dewpoint", np.empty((0,))).shape == (0,)
+
+    with pytest.raises(ValueError):
+        potential_temperature(P, TEMPERATURE, out=np.empty(TEMPERATURE.shape[0]))
+    with pytest.raises(ValueError):
+        elementwise("potential_temperature", P)
+    with pytest.raises(ValueError):
+        elementwise("unknown", P)
+
+
+def test_dtype_promotion() -> None:
+    # float32 inputs and python scalars stay in float32, mixed arrays promote as in numpy
+    P = np.broadcast_to(PRESSURE_LEVELS, TEMPERATURE.shape)  # (N, Z) float64
+    P32, T, Td = P.astype(np.float32), TEMPERATURE.astype(np.float32), DEWPOINT.astype(np.float32)
+
+    for x in (
+        exner_function(P32, 100000.0),
+        dry_lapse(P32, T),
+        potential_temperature(P32, T),
+        saturation_mixing_ratio(P32, Td),
+        equivalent_potential_temperature(P32, T, Td),
+        virtual_temperature(T, saturation_mixing_ratio(P32, Td)),
+        *ccl(P32, T, Td),
+    ):
+        assert x.dtype == np.float32
+
+    for x in (
+        dry_lapse(P, T),
+        potential_temperature(P, T),
+        saturation_mixing_ratio(P, Td),
+        equivalent_potential_temperature(P, T, Td),
+        *ccl(P, T, Td),
+    ):
+        assert x.dtype == np.float64
+
+    theta_e = equivalent_potential_temperature(P, TEMPERATURE, DEWPOINT)
+    assert_allclose(equivalent_potential_temperature(P32, T, Td), theta_e, rtol=1e-5)
+
+
 @pytest.mark.parametrize("dtype", [np.float64, np.float32])
 def test_ccl(dtype) -> None:
     P = (
@@ -64,6 +201,27 @@ def test_ccl(dtype) -> None:
         )
 
 
+@pytest.mark.parametrize("batch_size", [1, 2, 7])
+def test_ccl_batch_size(batch_size) -> None:
+    P = np.broadcast_to(PRESSURE_LEVELS, TEMPERATURE.shape)
+    lower, upper = ccl(P, TEMPERATURE, DEWPOINT, which="all")
+    tiled = ccl(P, TEMPERATURE, DEWPOINT, which="all", batch_size=batch_size)
+    for a, b in zip((lower, upper), tiled):
+        for x, y in zip(a, b):
+            assert x.shape == y.shape == (len(TEMPERATURE),)
+            assert_allclose(x, y)
+
+    for x, y in zip(lower, ccl(P, TEMPERATURE, DEWPOINT, max_memory=1)):  # a column per tile
+        assert_allclose(x, y)
+
+    # a (Z,) pressure shared by every tile, with a budget of two columns per tile
+    Z = PRESSURE_LEVELS.size
+    itemsize = np.result_type(PRESSURE_LEVELS, TEMPERATURE).itemsize
+    for x, y in zip(lower, ccl(PRESSURE_LEVELS, TEMPERATURE, DEWPOINT, max_memory=2 * 4 * Z * itemsize)):
+        assert x.shape == y.shape == (len(TEMPERATURE),)
+        assert_allclose(x, y)
+
+
 @pytest.mark.parametrize("dtype", [np.float64, np.float32])
 def test_lcl(dtype) -> None:
     pressure = np.array([912.12, 1012.93], dtype=dtype) * 100.0
@@ -76,3 +234,91 @@ def test_lcl(dtype) -> None:
         )
         assert_allclose(lcl_p[i], lcl_p_.m, rtol=1e-4)  # type: ignore
         assert_allclose(lcl_t[i], lcl_t_.m, rtol=1e-4)
+
+
+@pytest.mark.parametrize("dtype", [np.float64, np.float32])
+def test_lcl_out(dtype) -> None:
+    pressure = np.array([912.12, 1012.93], dtype=dtype) * 100.0
+    temperature = np.array([225.31, 254.0], dtype=dtype)
+    dewpoint = np.array([220.31, 240.0], dtype=dtype)
+
+    out = np.full((2, 2), np.nan, dtype=dtype)
+    x = lcl(pressure, temperature, dewpoint, out=out)
+    assert x is out
+    assert_allclose(x, lcl(pressure, temperature, dewpoint))
+
+    with pytest.raises(ValueError):
+        lcl(pressure, temperature, dewpoint, out=np.empty((2, 3), dtype=dtype))
+
+
+@pytest.mark.parametrize("dtype", [np.float64, np.float32])
+@pytest.mark.parametrize("method", ["bolton", "romps"])
+def test_lcl_closed_form(dtype, method) -> None:
+    pressure = np.array([912.12, 1012.93, 1000.0, 950.0], dtype=dtype) * 100.0
+    temperature = np.array([225.31, 254.0, 303.0, 310.0], dtype=dtype)
+    dewpoint = np.array([220.31, 240.0, 293.0, 250.0], dtype=dtype)
+    lcl_p, lcl_t = lcl(pressure, temperature, dewpoint, method=method)
+    assert lcl_p.dtype == np.dtype(dtype)
+    for i in range(len(temperature)):
+        lcl_p_, lcl_t_ = mpcalc.lcl(
+            pressure[i] * units.pascal, temperature[i] * units.kelvin, dewpoint[i] * units.kelvin
+        )
+        assert_allclose(lcl_p[i], lcl_p_.m, rtol=5e-3)  # type: ignore
+        assert_allclose(lcl_t[i], lcl_t_.m, atol=0.2)
+
+    # a saturated parcel is already at its lcl
+    assert_allclose(lcl(pressure, temperature, temperature, method=method), [pressure, temperature], rtol=1e-5)
+
+    with pytest.raises(ValueError):
+        lcl(pressure, temperature, dewpoint, method="unknown")
+
+
+def test_lcl_romps_lambert_w() -> None:
+    # the W_{-1} arguments of the analytic lcl span about -0.22 to -0.02, compare the fixed Halley
+    # iterations against scipy over that range
+    from scipy.special import lambertw
+
+    from nzthermo.const import epsilon
+
+    temperature, rh = (x.ravel() for x in np.meshgrid(np.linspace(190.0, 340.0, 31), np.geomspace(1e-4, 1.0, 17)))
+    pressure = np.full_like(temperature, 95000.0)
+    # the dewpoint of each relative humidity with respect to the Bolton saturation vapor pressure
+    ln = np.log(rh) + 17.67 * (temperature - 273.15) / (temperature - 29.65)
+    dewpoint = (17.67 * 273.15 - 29.65 * ln) / (17.67 - ln)
+
+    e = saturation_vapor_pressure(dewpoint)
+    q = epsilon * e / (pressure - (1.0 - epsilon) * e)
+    cpa, cpv, cvl, rgasa, rgasv, e0v, t_trip = 719.0 + 287.04, 1418.0 + 461.0, 4119.0, 287.04, 461.0, 2.3740e6, 273.16
+    cpm = (1.0 - q) * cpa + q * cpv
+    Rm = (1.0 - q) * rgasa + q * rgasv
+    e0 = e0v - (1418.0 - cvl) * t_trip
+    rh_l = np.minimum(
+        1.0,
+        np.exp((cpv - cvl) / rgasv * np.log(dewpoint / temperature) + e0 / rgasv * (1 / temperature - 1 / dewpoint)),
+    )
+    a = cpm / Rm + (cvl - cpv) / rgasv
+    c = -e0 / (rgasv * temperature) / a
+    x = rh_l ** (1.0 / a) * c * np.exp(c)
+    assert -0.23 < x.min() and x.max() < -0.01 and ((-0.18 < x) & (x < -0.1)).any()
+
+    lcl_t = c / lambertw(x, k=-1).real * temperature
+    lcl_p = pressure * (lcl_t / temperature) ** (cpm / Rm)
+    assert_allclose(lcl(pressure, temperature, dewpoint, method="romps"), [lcl_p, lcl_t], rtol=1e-12)
+
+
+@pytest.mark.parametrize("dtype", [np.float64, np.float32])
+def test_parcel_profile(dtype) -> None:
+    P, T, Td = (x.astype(dtype) for x in (PRESSURE_LEVELS, TEMPERATURE, DEWPOINT))
+    pp = parcel_profile(P, T, Td)
+    N, Z = T.shape
+    for x in (pp.pressure, pp.temperature, pp.parcel_temperature, pp.dewpoint):
+        assert x.shape == (N, Z + 1)
+        assert x.dtype == np.dtype(dtype)
+    assert pp.lcl_pressure.shape == pp.lcl_temperature.shape == (N,)
+
+    for i in range(N):
+        p, t, td, prof = mpcalc.parcel_profile_with_lcl(P * units.pascal, T[i] * units.kelvin, Td[i] * units.kelvin)
+        assert_allclose(pp.pressure[i], p.m, rtol=1e-4)
+        assert_allclose(pp.temperature[i], t.m, rtol=1e-4)
+        assert_allclose(pp.dewpoint[i], td.m, rtol=1e-4)
+        assert_allclose(pp.parcel_temperature[i], prof.m, rtol=1e-3)
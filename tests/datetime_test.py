@@ -0,0 +1,79 @@
+from __future__ import annotations
+
+import numpy as np
+import pytest
+from numpy.testing import assert_allclose
+
+from nzthermo._datetime import delta_t, solar_position
+
+
+def pe4dt(year: int, month: int) -> float:
+    # a subset of the NASA polynomial expressions, evaluated term by term
+    y = year + (month - 0.5) / 12
+    if year < -500:
+        return -20 + 32 * ((y - 1820) / 100) ** 2
+    elif 1700 <= year < 1800:
+        t = y - 1700
+        return 8.83 + 0.1603 * t - 0.0059285 * t**2 + 0.00013336 * t**3 - t**4 / 1174000
+    elif 1961 <= year < 1986:
+        t = y - 1975
+        return 45.45 + 1.067 * t - t**2 / 260 - t**3 / 718
+    elif 1986 <= year < 2005:
+        t = y - 2000
+        return 63.86 + 0.3345 * t - 0.060374 * t**2 + 0.0017275 * t**3 + 0.000651814 * t**4 + 0.00002373599 * t**5
+    elif 2005 <= year < 2050:
+        t = y - 2000
+        return 62.92 + 0.32217 * t + 0.005589 * t**2
+    elif 2050 <= year < 2150:
+        return -20 + 32 * ((y - 1820) / 100) ** 2 - 0.5628 * (2150 - y)
+    raise NotImplementedError
+
+
+@pytest.mark.parametrize("unit", ["D", "h", "s", "ns", "15m"])
+def test_delta_t(unit) -> None:
+    dt = np.array(
+        ["-1000-07-01", "1750-02-11", "1970-12-31", "1999-01-01", "2004-12-31", "2024-03-01", "2100-06-15"],
+        dtype="datetime64[D]",
+    ).astype(f"datetime64[{unit}]")
+    years = dt.astype("datetime64[Y]").astype(np.int64) + 1970
+    months = dt.astype("datetime64[M]").astype(np.int64) % 12 + 1
+
+    assert_allclose(delta_t(dt), [pe4dt(y, m) for y, m in zip(years, months)])
+
+
+def test_delta_t_sorted_and_nat() -> None:
+    # unsorted inputs that cross several eras give the same values as the sorted ones
+    dt = np.arange("1600-01", "2200-01", dtype="datetime64[M]").astype("datetime64[h]")
+    rng = np.random.default_rng(0)
+    order = rng.permutation(dt.size)
+    assert_allclose(delta_t(dt[order]), delta_t(dt)[order])
+    assert_allclose(delta_t(dt.reshape(-1, 12)), delta_t(dt).reshape(-1, 12))
+
+    x = delta_t(np.array(["2000-01-01", "NaT"], dtype="datetime64[s]"))
+    assert np.isnan(x[1]) and not np.isnan(x[0])
+
+
+def test_solar_position() -> None:
+    lat = np.array([0.0, 23.44, -23.44, 40.0])
+    lon = np.array([0.0, 0.0, 0.0, -105.0])
+    dt = np.array(["2024-03-20T12:07", "2024-06-20T12:02", "2024-12-21T11:58", "NaT"], dtype="datetime64[m]")
+    x = solar_position(lat, lon, dt)
+    assert x.shape == (2, 4, 4)
+
+    # the sun is overhead at local solar noon on the equator at the equinox and on the tropics at
+    # the solstices
+    assert_allclose(np.diagonal(x[0])[:3], 0.0, atol=0.5)
+    assert np.isnan(x[:, :, 3]).all()
+
+    # noon in Boulder on the june solstice, the sun is due south at 90 - (40 - 23.44) degrees
+    t = np.array(["2024-06-20T19:02"], dtype="datetime64[m]")
+    zenith, azimuth = solar_position(lat[3:], lon[3:], t)[:, 0, 0]
+    assert_allclose(zenith, 40.0 - 23.44, atol=0.2)
+    assert_allclose(azimuth, 180.0, atol=2.0)
+
+    # the sun rises in the east
+    sunrise = solar_position(lat[:1], lon[:1], np.array(["2024-03-20T06:07"], dtype="datetime64[m]"))[:, 0, 0]
+    assert_allclose(sunrise, [90.0, 90.0], atol=1.0)
+
+    with pytest.raises(ValueError):
+        solar_position(lat, lon[:2], dt)
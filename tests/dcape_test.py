@@ -48,3 +48,53 @@ def test_downdraft_cape(dtype) -> None:
         ],
         rtol=1e-2,
     )
+
+
+def test_downdraft_cape_broadcast_modes() -> None:
+    P, T, Td = (x.astype(np.float64) for x in (pressure, temperature, dewpoint))
+    dcape = downdraft_cape(P, T, Td)
+    assert_allclose(downdraft_cape(P[np.newaxis, :], T, Td), dcape)  # (1, Z)
+    assert_allclose(downdraft_cape(np.tile(P, (len(T), 1)), T, Td), dcape)  # (N, Z)
+
+    # no levels in the 700-500 hPa layer
+    assert np.all(np.isnan(downdraft_cape(P[:10], T[:, :10], Td[:, :10])))
+
+
+@pytest.mark.parametrize("dtype", [np.float64, np.float32])
+def test_downdraft_cape_cuda(cp, dtype) -> None:
+    P, T, Td = (x.astype(dtype) for x in (pressure, temperature, dewpoint))
+    dcape = downdraft_cape(P, T, Td)
+    x = downdraft_cape(cp.asarray(P), cp.asarray(T), cp.asarray(Td))
+    assert isinstance(x, cp.ndarray)
+    assert_allclose(x.get(), dcape, rtol=1e-4)
+    matrix = cp.asarray(np.tile(P, (len(T), 1)))  # (N, Z)
+    assert_allclose(downdraft_cape(matrix, cp.asarray(T), cp.asarray(Td)).get(), dcape, rtol=1e-4)
+
+
+@pytest.mark.parametrize("dtype", [np.float64, np.float32])
+def test_downdraft_cape_cuda_nan_layer(cp, dtype) -> None:
+    # nan levels in the 700-500 hPa layer are never the source of the downdraft on either backend
+    P, T, Td = (x.astype(dtype) for x in (pressure, temperature, dewpoint))
+    Td[0, 13] = np.nan  # the 700 hPa level, the first in the layer
+    Td[2, 15:17] = np.nan
+    Td[1, 13:18] = np.nan  # the entire layer
+    dcape = downdraft_cape(P, T, Td)
+    assert np.isnan(dcape[1]) and np.isfinite(dcape[[0, 2, 3]]).all()
+    assert_allclose(downdraft_cape(cp.asarray(P), cp.asarray(T), cp.asarray(Td)).get(), dcape, rtol=1e-4)
+
+
+@pytest.mark.parametrize("batch_size", [1, 3, 100])
+def test_downdraft_cape_batch_size(batch_size) -> None:
+    P, T, Td = (x.astype(np.float64) for x in (pressure, temperature, dewpoint))
+    dcape = downdraft_cape(P, T, Td, dtype=np.float32)
+    for p in (P, np.tile(P, (len(T), 1))):
+        x = downdraft_cape(p, T, Td, dtype=np.float32, batch_size=batch_size)
+        assert x.dtype == np.float32 and x.flags.c_contiguous
+        assert_allclose(x, dcape)
+
+    # a budget smaller than a single column still makes progress one column at a time
+    assert_allclose(downdraft_cape(P, T, Td, dtype=np.float32, max_memory=1), dcape)
+    with pytest.raises(ValueError):
+        downdraft_cape(P, T, Td, batch_size=1, max_memory=2**20)
+    with pytest.raises(ValueError):
+        downdraft_cape(P, T, Td, batch_size=0)
@@ -0,0 +1,84 @@
+from __future__ import annotations
+
+import numpy as np
+import pytest
+from numpy.testing import assert_array_equal
+
+import nzthermo as nzt
+
+from .cape_test import dewpoint, pressure, temperature
+
+P, T, Td = (x.astype(np.float64) for x in (pressure, temperature, dewpoint))
+
+requires_diagnostics = pytest.mark.skipif(not nzt.DIAGNOSTICS_ENABLED, reason="built without --diagnostics")
+
+
+@pytest.fixture(autouse=True)
+def reset():
+    nzt.reset_diagnostics()
+    yield
+    nzt.reset_diagnostics()
+
+
+def test_diagnostics_disabled() -> None:
+    d = nzt.diagnostics()
+    assert d["enabled"] is nzt.DIAGNOSTICS_ENABLED
+    if not nzt.DIAGNOSTICS_ENABLED:
+        nzt.cape_cin(P, T, Td)
+        d = nzt.diagnostics()
+        assert d["calls"] == [] and d["solver_evaluations"] == 0
+        assert not d["lcl_iterations"].any() and d["nonconverged"].size == 0
+
+
+@requires_diagnostics
+def test_diagnostics() -> None:
+    nzt.moist_lapse(P, T[:, 0], threads=2)
+    d = nzt.diagnostics()
+    (call,) = d["calls"]
+    assert (call["columns"], call["levels"]) == T.shape and call["seconds"] >= 0.0
+    assert d["thread_columns"].sum() == len(T)
+    assert d["solver_evaluations"] > 0
+
+    nzt.reset_diagnostics()
+    nzt.lcl(P[:4], T[:, 0], Td[:, 0])
+    d = nzt.diagnostics()
+    assert d["lcl_iterations"].sum() == len(T) and d["lcl_nonconverged"] == 0
+
+
+@requires_diagnostics
+def test_diagnostics_nonconverged() -> None:
+    lcl = nzt.lcl(P[:4], T[:, 0], Td[:, 0], max_iters=1, eps=1e-12)
+    d = nzt.diagnostics()
+    assert d["lcl_nonconverged"] == np.isnan(lcl[0]).sum() > 0
+    assert_array_equal(np.sort(d["nonconverged"]), np.flatnonzero(np.isnan(lcl[0])))
+
+
+@requires_diagnostics
+def test_diagnostics_rk45_carries_step() -> None:
+    # the accepted step is carried between the levels of a column, so a tiny initial step only
+    # costs the ramp up on the first level instead of on every level
+    def evaluations(step: float) -> int:
+        nzt.reset_diagnostics()
+        nzt.moist_lapse(P, T[:, 0], method="rk45", step=step)
+        return nzt.diagnostics()["solver_evaluations"]
+
+    # ~6 growth steps of a factor of 5 from 1 Pa, of 7 evaluations each, once per column
+    assert evaluations(1.0) - evaluations(1000.0) <= 7 * 8 * len(T)
+
+
+@requires_diagnostics
+def test_diagnostics_block_chunk() -> None:
+    # the BROADCAST rk2 blocks follow the schedule, with the chunk rounded up to whole blocks
+    schedule = nzt.get_schedule()
+    threshold = nzt.get_serial_threshold()
+    try:
+        nzt.set_serial_threshold(0)
+        nzt.set_schedule("static", 300)
+        nzt.moist_lapse(P, np.resize(T[:, 0], 1000))
+        nzt.moist_lapse(P, np.resize(T[:, 0], 1000), method="rk45")
+        block, column = nzt.diagnostics()["calls"]
+        assert block["schedule"] == column["schedule"] == "static"
+        assert (block["chunk"], column["chunk"]) == (2, 300)
+    finally:
+        nzt.set_schedule(*schedule)
+        nzt.set_serial_threshold(threshold)
@@ -1,7 +1,8 @@
 from __future__ import annotations
 
 import numpy as np
-from numpy.testing import assert_allclose
+import pytest
+from numpy.testing import assert_allclose, assert_array_equal
 
 import nzthermo.functional as F
 
@@ -68,3 +69,82 @@ def test_interpolate_nz() -> None:
         [[296.69, 296.78, 296.68, 296.97, 297.44], [295.12, 294.78, 295.23, 295.42, 296.22]],
         atol=1e-2,
     )
+
+
+def test_interpolate_nz_bracket() -> None:
+    xp = np.array([1013.0, 1000.0, 975.0, 950.0, 925.0, 900.0])  # (Z,) decreasing
+    fp = np.array([np.linspace(300.0, 290.0, 6), np.linspace(20.0, 10.0, 6), np.linspace(1.0, 2.0, 6)])
+    x = np.array([1013.0, 987.5, 900.0, 950.0, 1020.0, 850.0, np.nan])  # (N,)
+    a = np.tile(fp[0], (x.size, 1))
+    b = np.tile(fp[1], (x.size, 1))
+
+    # the fields share the bracket, outside of xp and nan are nan
+    ta, tb = F.interpolate_nz(x, xp, a, b)
+    assert_allclose(ta[:4], np.interp(x[:4], xp[::-1], fp[0, ::-1]))
+    assert_allclose(tb[:4], np.interp(x[:4], xp[::-1], fp[1, ::-1]))
+    assert np.isnan(ta[4:]).all() and np.isnan(tb[4:]).all()
+
+    # an increasing axis and log_x, with a strided field that is read in place
+    t = F.interpolate_nz(x[:4], xp[::-1].copy(), a[:4, ::-1], log_x=True)
+    assert_allclose(t, np.interp(np.log(x[:4]), np.log(xp[::-1]), fp[0, ::-1]))
+
+    # a float32 field
+    assert F.interpolate_nz(x, xp, a.astype(np.float32)).dtype == np.float32
+
+    # the former name of the mode is accepted with a warning
+    with pytest.warns(DeprecationWarning):
+        assert_array_equal(F.interpolate_nz(x, xp, a, mode="clip"), ta)
+    with pytest.raises(ValueError):
+        F.interpolate_nz(x, xp, a, mode="extrapolate")  # type: ignore[call-overload]
+
+
+def test_insert_along_z() -> None:
+    z = np.array([1000.0, 900.0, 800.0, 700.0])  # (Z,)
+    arr = np.tile(z, (5, 1))  # (N, Z)
+    values = np.array([950.0, 880.0, 1010.0, 650.0, 800.0])  # (N,)
+
+    out = F.insert_along_z(arr, values, z)
+    assert out.shape == (5, 5)
+    # the rows stay sorted, values below the first level are first and above the last are last
+    assert_array_equal(out[0], [1000.0, 950.0, 900.0, 800.0, 700.0])
+    assert_array_equal(out[1], [1000.0, 900.0, 880.0, 800.0, 700.0])
+    assert_array_equal(out[2], [1010.0, 1000.0, 900.0, 800.0, 700.0])
+    assert_array_equal(out[3], [1000.0, 900.0, 800.0, 700.0, 650.0])
+    assert_array_equal(out[4], [1000.0, 900.0, 800.0, 800.0, 700.0])
+
+    # the position and the inserted values may differ
+    out = F.insert_along_z(arr, np.full(5, -1.0), z, values[:, np.newaxis])
+    assert_array_equal((out == -1.0).argmax(axis=1), [1, 2, 0, 4, 3])
+
+
+def test_intersect_nz_log_x() -> None:
+    x = np.array([1013, 1000, 975, 950])
+    a = np.array([[0, -1, -2, -3], [1, -1, -2, -3]])
+    b = np.array([[1.0, -1.1, -1.2, 3.0], [2.0, -1.2, -2.0, -2.0]])
+    intersect = F.intersect_nz(x, a, b, log_x=True)
+    lower, upper = intersect.lower(), intersect.upper()
+    assert_allclose(lower.x, [1001.17, 1002.16], atol=1e-2)
+    assert_allclose(lower.y, [-0.91, -0.67], atol=1e-2)
+    assert_allclose(upper.x, [997.19, 975.0], atol=1e-2)
+    assert_allclose(upper.y, [-1.11, -2.0], atol=1e-2)
+    assert_array_equal(lower.indices, [0, 1])
+    assert_array_equal(upper.indices, [0, 1])
+
+    # (N, Z) x and a float32 profile
+    lower_ = F.intersect_nz(np.tile(x, (2, 1)), a.astype(np.float32), b.astype(np.float32), log_x=True).lower()
+    assert lower_.x.dtype == np.float32
+    assert_allclose(lower_.x, lower.x, rtol=1e-5)
+
+
+def test_intersections_nz() -> None:
+    x = np.array([1013.0, 1000.0, 975.0, 950.0, 925.0])
+    a = np.array([[0.0, -1.0, 1.0, -1.0, -2.0], [1.0, 2.0, 3.0, 4.0, 5.0]])
+    b = np.zeros_like(a)
+    x_k, y_k = F.intersections_nz(x, a, b, 3)
+    assert x_k.shape == y_k.shape == (2, 3)
+    assert_allclose(x_k[0], [1013.0, 987.5, 962.5])
+    assert_allclose(y_k[0], [0.0, 0.0, 0.0])
+    assert np.isnan(x_k[1]).all() and np.isnan(y_k[1]).all()
+
+    x_k, _ = F.intersections_nz(x, a, b, 1)
+    assert_allclose(x_k[:, 0], [1013.0, np.nan])
@@ -1,3 +1,4 @@
+import os
 from typing import Any
 
 import metpy.calc as mpcalc
@@ -6,6 +7,7 @@ import pytest
 from metpy.units import units
 from numpy.testing import assert_allclose
 
+from nzthermo._c import _pseudo_adiabat_cache, _pseudo_adiabat_parameters
 from nzthermo.core import moist_lapse
 
 
@@ -217,3 +219,244 @@ def test_moist_lapse(dtype):
         mpcalc.moist_lapse(pressure[1] * units.pascal, temperature[1] * units.kelvin),
         rtol=1e-4,
     )
+
+
+@pytest.mark.parametrize("dtype", [np.float32, np.float64])
+def test_moist_lapse_out(dtype):
+    dtype = np.dtype(dtype)
+    pressure = pressure_levels(dtype=dtype)  # (Z,)
+    temperature = np.array([225.31, 254.0], dtype=dtype)  # (N,)
+
+    out = np.full((2, pressure.size), np.nan, dtype=dtype)  # (N, Z)
+    ml = moist_lapse(pressure, temperature, out=out)
+    assert ml is out
+    assert_allclose(ml, moist_lapse(pressure, temperature))
+
+    # ELEMENT_WISE: (N,) x (N,) x (N,)
+    ref_pressure = np.array([1013.12, 1013.14], dtype=dtype) * 100.0
+    out = np.full(2, np.nan, dtype=dtype)  # (N,)
+    ml = moist_lapse(pressure[[4, 8]], temperature, ref_pressure, out=out)
+    assert ml is out
+    assert_allclose(ml, moist_lapse(pressure[[4, 8]], temperature, ref_pressure))
+
+    with pytest.raises(ValueError):
+        moist_lapse(pressure, temperature, out=np.empty((2, pressure.size - 1), dtype=dtype))
+    with pytest.raises(ValueError):
+        moist_lapse(pressure, temperature, dtype=dtype, out=np.empty((2, pressure.size), dtype=np.int64))
+
+    # no columns, ``out`` is still validated and returned
+    out = np.empty((0, pressure.size), dtype=dtype)
+    assert moist_lapse(pressure, temperature[:0], out=out) is out
+    assert moist_lapse(pressure, temperature[:0]).shape == (0, pressure.size)
+    out = np.empty(0, dtype=dtype)
+    assert moist_lapse(pressure[:0], temperature[:0], ref_pressure[:0], out=out) is out
+    with pytest.raises(ValueError):
+        moist_lapse(pressure, temperature[:0], out=np.empty((0, pressure.size - 1), dtype=dtype))
+
+
+@pytest.mark.parametrize("dtype", [np.float32, np.float64])
+def test_moist_lapse_strided(dtype):
+    dtype = np.dtype(dtype)
+    # (Z, N) model output passed as a transposed view without being made contiguous
+    pressure = np.array([pressure_levels(1013.12, dtype=dtype), pressure_levels(1013.93, dtype=dtype)]).T
+    temperature = np.array([[225.31, 0.0], [254.0, 0.0]], dtype=dtype)[:, 0]  # (N,) strided
+    assert not pressure.T.flags.c_contiguous and not temperature.flags.c_contiguous
+
+    assert_allclose(
+        moist_lapse(pressure.T, temperature),
+        moist_lapse(np.ascontiguousarray(pressure.T), np.ascontiguousarray(temperature)),
+    )
+
+
+@pytest.mark.parametrize("dtype", [np.float32, np.float64])
+def test_moist_lapse_rk45(dtype):
+    dtype = np.dtype(dtype)
+    pressure = pressure_levels(dtype=dtype)  # (Z,)
+    temperature = np.array([225.31, 254.0, 300.0], dtype=dtype)  # (N,)
+
+    ml = moist_lapse(pressure, temperature, method="rk45", rtol=1e-6)
+    assert ml.dtype == dtype
+    for i in range(len(temperature)):
+        assert_allclose(
+            ml[i],
+            mpcalc.moist_lapse(pressure * units.pascal, temperature[i] * units.kelvin).m,
+            rtol=1e-4,
+        )
+    # the adaptive solution should agree with a finely stepped rk2 solution
+    assert_allclose(ml, moist_lapse(pressure, temperature, step=100.0), rtol=1e-4)
+
+    with pytest.raises(ValueError):
+        moist_lapse(pressure, temperature, method="euler")
+
+
+@pytest.mark.parametrize("dtype", [np.float32, np.float64])
+def test_moist_lapse_table(dtype, tmp_path, monkeypatch):
+    monkeypatch.setenv("NZTHERMO_CACHE_DIR", str(tmp_path))
+    dtype = np.dtype(dtype)
+    pressure = pressure_levels(dtype=dtype)  # (Z,)
+    temperature = np.array([225.31, 254.0, 280.0, 300.0], dtype=dtype)  # (N,)
+
+    ml = moist_lapse(pressure, temperature, method="table")
+    assert ml.dtype == dtype
+    # within the documented error bound of a finely stepped solution and of the default rk2 path
+    assert_allclose(ml, moist_lapse(pressure, temperature, step=50.0), atol=0.05)
+    assert_allclose(ml, moist_lapse(pressure, temperature), atol=0.1)
+
+    # the cache is keyed on the constants and grid of the table
+    path = _pseudo_adiabat_cache()
+    assert os.path.dirname(path) == str(tmp_path)
+    parameters = _pseudo_adiabat_parameters()
+    for name, value in (("step", 50.0), ("Lv", parameters["Lv"] * 1.001), ("version", 1)):
+        assert _pseudo_adiabat_cache({**parameters, name: value}) != path
+
+    # MATRIX, with nan masked levels and a reference pressure below the table (fallback to rk2)
+    pressure = np.array([pressure_levels(1013.12, dtype=dtype), pressure_levels(1120.0, dtype=dtype)])
+    pressure[0, :2] = np.nan
+    temperature = np.array([280.0, 300.0], dtype=dtype)
+    assert_allclose(
+        moist_lapse(pressure, temperature, method="table"),
+        moist_lapse(pressure, temperature),
+        atol=0.1,
+    )
+
+
+@pytest.mark.parametrize("dtype", [np.float32, np.float64])
+@pytest.mark.parametrize("N", [37, 600])
+def test_moist_lapse_broadcast_blocks(dtype, N):
+    # BROADCAST advances level-major blocks of columns, compare against the per-column MATRIX
+    # kernel with a partial final block, nan parcels and nan levels
+    dtype = np.dtype(dtype)
+    pressure = pressure_levels(dtype=dtype)  # (Z,)
+    pressure[[0, 5]] = np.nan
+    temperature = np.linspace(240.0, 305.0, N).astype(dtype)  # (N,)
+    temperature[3] = np.nan
+    # the vapor pressure exponent overflows and underflows the range of the vectorized exp
+    temperature[[7, 8]] = 29.6, 29.7
+    ref_pressure = np.linspace(1050.0, 850.0, N).astype(dtype) * 100.0
+
+    ml = moist_lapse(pressure, temperature, ref_pressure)
+    assert ml.shape == (N, pressure.size)
+    assert_allclose(ml, moist_lapse(np.tile(pressure, (N, 1)), temperature, ref_pressure), rtol=1e-5)
+    assert np.isnan(ml[3]).all()
+    assert np.isnan(ml[:, [0, 5]]).all()
+
+    # a non-contiguous output is written without the non-temporal stores
+    out = np.empty((pressure.size, N), dtype=dtype).T
+    assert_allclose(moist_lapse(pressure, temperature, ref_pressure, out=out), ml)
+
+
+@pytest.mark.parametrize("mode", ["BROADCAST", "MATRIX"])
+def test_moist_lapse_float32_precision(mode):
+    # the float32 specializations are held to the documented budget, the BROADCAST blocks integrate
+    # in double and the MATRIX per column kernel in single precision
+    pressure = np.linspace(1000.0, 100.0, 46) * 100.0  # (Z,)
+    temperature = np.linspace(250.0, 310.0, 61)  # (N,)
+    if mode == "MATRIX":
+        pressure = np.tile(pressure, (temperature.size, 1))  # (N, Z)
+
+    ml = moist_lapse(pressure.astype(np.float32), temperature.astype(np.float32))
+    assert ml.dtype == np.float32 and ml.shape == (temperature.size, 46)
+    assert_allclose(ml, moist_lapse(pressure, temperature), atol=1e-3)
+
+
+@pytest.mark.parametrize("dtype", [np.float32, np.float64])
+@pytest.mark.parametrize("method", ["rk2", "rk45", "table"])
+@pytest.mark.parametrize("N", [37, 600])
+def test_moist_lapse_stop(dtype, method, N):
+    dtype = np.dtype(dtype)
+    pressure = pressure_levels(dtype=dtype)  # (Z,)
+    temperature = np.linspace(240.0, 305.0, N).astype(dtype)  # (N,)
+    ref_pressure = np.full(N, 101325.0, dtype=dtype)
+    ml = moist_lapse(pressure, temperature, ref_pressure, method=method)
+
+    # the levels above the top are nan, the others are unchanged in every broadcast mode
+    top = pressure <= 50000.0
+    for p in (pressure, np.tile(pressure, (N, 1))):
+        x = moist_lapse(p, temperature, ref_pressure, method=method, top_pressure=50000.0)
+        assert np.isnan(x[:, ~top]).all()
+        assert_allclose(x[:, top], ml[:, top], rtol=1e-6)
+
+    # each parcel stops after the first level colder than the threshold
+    x = moist_lapse(pressure, temperature, ref_pressure, method=method, min_temperature=250.0)
+    for row, expected in zip(x, ml):
+        (colder,) = np.nonzero(expected < 250.0)
+        stop = colder[0] + 1 if colder.size else len(expected)
+        assert_allclose(row[:stop], expected[:stop], rtol=1e-6)
+        assert np.isnan(row[stop:]).all()
+
+
+def test_moist_lapse_leading_nan():
+    # leading nan levels mask out the levels below the surface of each column
+    pressure = np.tile(pressure_levels(), (3, 1))  # (N, Z)
+    pressure[1, :3] = np.nan
+    pressure[2, :] = np.nan
+    temperature = np.array([290.0, 285.0, 280.0])
+    ml = moist_lapse(pressure, temperature)
+    assert np.isnan(ml[1, :3]).all() and np.isnan(ml[2]).all()
+    assert_allclose(ml[1, 3:], moist_lapse(pressure[1:2, 3:], temperature[1:2])[0])
+
+
+@pytest.mark.parametrize("dtype", [np.float32, np.float64])
+@pytest.mark.parametrize("method", ["rk2", "rk45", "table"])
+def test_moist_lapse_element_wise(dtype, method, tmp_path, monkeypatch):
+    # the scalar ELEMENT_WISE kernel matches the per-column kernel on a single level
+    monkeypatch.setenv("NZTHERMO_CACHE_DIR", str(tmp_path))
+    dtype = np.dtype(dtype)
+    N = 300
+    temperature = np.linspace(240.0, 305.0, N).astype(dtype)  # (N,)
+    ref_pressure = np.linspace(1120.0, 850.0, N).astype(dtype) * 100.0  # partly below the table
+    pressure = (ref_pressure * np.linspace(0.3, 0.95, N)).astype(dtype)  # (N,)
+    pressure[5] = np.nan
+    temperature[3] = np.nan
+
+    for kwargs in ({}, {"top_pressure": 50000.0}, {"min_temperature": 250.0}):
+        x = moist_lapse(pressure, temperature, ref_pressure, method=method, **kwargs)
+        assert x.shape == (N,) and x.dtype == dtype
+        matrix = moist_lapse(pressure.reshape(N, 1), temperature, ref_pressure, method=method, **kwargs)  # (N, 1)
+        assert_allclose(x, matrix[:, 0])
+        assert np.isnan(x[[3, 5]]).all()
+
+
+@pytest.mark.parametrize("dtype", [np.float32, np.float64])
+def test_moist_lapse_cuda(cp, dtype):
+    # the device kernels are validated against the CPU kernels in every broadcast mode
+    dtype = np.dtype(dtype)
+    pressure = pressure_levels(dtype=dtype)  # (Z,)
+    pressure[5] = np.nan
+    temperature = np.linspace(240.0, 305.0, 300).astype(dtype)  # (N,)
+    temperature[3] = np.nan
+    ref_pressure = np.linspace(1050.0, 850.0, 300).astype(dtype) * 100.0
+    matrix = np.tile(pressure, (temperature.size, 1))
+
+    for args in [
+        (pressure, temperature, ref_pressure),  # BROADCAST
+        (pressure, temperature),  # BROADCAST from the first level
+        (matrix, temperature, ref_pressure),  # MATRIX
+        (ref_pressure * 0.8, temperature, ref_pressure),  # ELEMENT_WISE
+    ]:
+        ml = moist_lapse(*(cp.asarray(x) for x in args))
+        assert isinstance(ml, cp.ndarray) and ml.dtype == dtype
+        assert_allclose(ml.get(), moist_lapse(*args), rtol=1e-4)
+
+    # an empty batch is validated against and returned in ``out`` as on the CPU
+    out = cp.empty((0, pressure.size), dtype=dtype)
+    assert moist_lapse(cp.asarray(pressure), cp.asarray(temperature[:0]), out=out) is out
+    with pytest.raises(ValueError):
+        moist_lapse(cp.asarray(pressure), cp.asarray(temperature[:0]), out=cp.empty((0, 1), dtype=dtype))
+
+    with pytest.raises(ValueError):
+        moist_lapse(cp.asarray(pressure), cp.asarray(temperature), method="rk45")
+
+
+@pytest.mark.parametrize("dtype", [np.float32, np.float64])
+def test_lcl_cuda(cp, dtype):
+    from nzthermo.core import lcl
+
+    dtype = np.dtype(dtype)
+    pressure = np.linspace(1050.0, 700.0, 300).astype(dtype) * 100.0
+    temperature = np.linspace(260.0, 310.0, 300).astype(dtype)
+    dewpoint = (temperature - np.linspace(0.5, 25.0, 300)).astype(dtype)
+
+    x = lcl(cp.asarray(pressure), cp.asarray(temperature), cp.asarray(dewpoint))
+    assert isinstance(x, cp.ndarray) and x.shape == (2, 300)
+    assert_allclose(x.get(), lcl(pressure, temperature, dewpoint), rtol=1e-4)
@@ -0,0 +1,125 @@
+from __future__ import annotations
+
+import os
+import subprocess
+import sys
+from concurrent.futures import ThreadPoolExecutor
+
+import numpy as np
+import pytest
+from numpy.testing import assert_array_equal
+
+import nzthermo as nzt
+
+from .cape_test import dewpoint, pressure, temperature
+
+P, T, Td = (x.astype(np.float64) for x in (pressure, temperature, dewpoint))
+
+
+@pytest.fixture(autouse=True)
+def restore_settings():
+    schedule = nzt.get_schedule()
+    threshold = nzt.get_serial_threshold()
+    yield
+    nzt.set_num_threads(0)
+    nzt.set_schedule(*schedule)
+    nzt.set_serial_threshold(threshold)
+
+
+def test_set_num_threads() -> None:
+    nzt.set_num_threads(1)
+    assert nzt.get_num_threads() == 1
+    assert nzt.threading_info()["num_threads"] == 1
+    nzt.set_num_threads(0)
+    assert nzt.get_num_threads() >= 1
+
+    with pytest.raises(ValueError):
+        nzt.set_num_threads(-1)
+
+
+@pytest.mark.parametrize("kind", ["auto", "static", "dynamic", "guided", "runtime"])
+def test_schedule(kind) -> None:
+    nzt.set_serial_threshold(0)
+    expected = nzt.cape_cin(P, T, Td, threads=1)
+    nzt.set_schedule(kind, 0 if kind in ("auto", "runtime") else 2)
+    assert nzt.get_schedule()[0] == kind
+    assert_array_equal(nzt.cape_cin(P, T, Td), expected)
+    assert_array_equal(nzt.moist_lapse(P, T[:, 0], threads=2), nzt.moist_lapse(P, T[:, 0], threads=1))
+    # the calling thread's openmp settings are restored after the call
+    info = nzt.threading_info()
+    nzt.lcl(P[:4], T[:, 0], Td[:, 0], threads=3)
+    assert nzt.threading_info() == info
+
+
+@pytest.mark.skipif(not nzt.threading_info()["openmp"], reason="built without openmp")
+def test_schedule_restores_modifier() -> None:
+    # the runtime schedule of the process is restored with its monotonic modifier
+    code = (
+        "import numpy as np, nzthermo as nzt\n"
+        "before = nzt.threading_info()\n"
+        "nzt.set_serial_threshold(0)\n"
+        "nzt.set_schedule('static', 4)\n"
+        "nzt.lcl(np.full(64, 1e5), np.full(64, 300.0), np.full(64, 290.0))\n"
+        "after = nzt.threading_info()\n"
+        "print(all(before[k] == after[k] for k in ('runtime_schedule', 'runtime_monotonic', 'runtime_chunk')))\n"
+        "print(before['runtime_schedule'], before['runtime_monotonic'], before['runtime_chunk'])\n"
+    )
+    env = dict(os.environ, OMP_SCHEDULE="monotonic:dynamic,3")
+    result = subprocess.run([sys.executable, "-c", code], env=env, capture_output=True, text=True, check=True)
+    assert result.stdout.split() == ["True", "dynamic", "True", "3"]
+
+
+def test_serial_threshold() -> None:
+    assert nzt.threading_info()["serial_threshold"] == nzt.get_serial_threshold()
+    expected = nzt.cape_cin(P, T, Td, threads=2)
+    for threshold in (0, T.size + 1):
+        nzt.set_serial_threshold(threshold)
+        assert nzt.get_serial_threshold() == nzt.threading_info()["serial_threshold"] == threshold
+        assert_array_equal(nzt.cape_cin(P, T, Td), expected)
+        assert_array_equal(nzt.moist_lapse(P, T[:, 0]), nzt.moist_lapse(P, T[:, 0], threads=1))
+
+
+def test_serial_kernels() -> None:
+    # below the threshold every kernel runs its plain loop, the results match the OpenMP loops
+    matrix = np.tile(P, (len(T), 1))
+    calls = [
+        lambda: nzt.moist_lapse(P, T[:, 0]),
+        lambda: nzt.moist_lapse(P, T[:, 0], method="rk45"),
+        lambda: nzt.moist_lapse(matrix, T[:, 0]),
+        lambda: nzt.moist_lapse(P[[3] * len(T)], T[:, 0], P[[0] * len(T)]),
+        lambda: nzt.lcl(P[[0] * len(T)], T[:, 0], Td[:, 0]),
+        lambda: nzt.lcl(P[[0] * len(T)], T[:, 0], Td[:, 0], method="bolton"),
+        lambda: nzt.wet_bulb_temperature(P, T, Td),
+        lambda: nzt.saturation_mixing_ratio(P, Td),
+        lambda: nzt.parcel_profile(P, T, Td),
+        lambda: nzt.cape_cin(matrix, T, Td),
+        lambda: nzt.downdraft_cape(P, T, Td),
+        lambda: nzt.sounding(P, T, Td),
+    ]
+    nzt.set_serial_threshold(0)
+    expected = [fn() for fn in calls]
+    nzt.set_serial_threshold(2**62)
+    for fn, x in zip(calls, expected):
+        for a, b in zip(*((y,) if isinstance(y, np.ndarray) else y for y in (fn(), x))):
+            assert_array_equal(a, b)
+
+    if nzt.DIAGNOSTICS_ENABLED:
+        nzt.reset_diagnostics()
+        nzt.cape_cin(P, T, Td)
+        assert nzt.diagnostics()["calls"][-1]["serial"]
+
+
+def test_concurrent_calls() -> None:
+    expected = [nzt.cape_cin(P, T[i:], Td[i:], threads=1) for i in range(len(T))]
+    with ThreadPoolExecutor(max_workers=4) as pool:
+        results = list(pool.map(lambda i: nzt.cape_cin(P, T[i:], Td[i:]), range(len(T))))
+
+    for x, y in zip(results, expected):
+        assert_array_equal(x, y)
+
+
+def test_threads_validation() -> None:
+    with pytest.raises(ValueError):
+        nzt.cape_cin(P, T, Td, threads=0)
+    with pytest.raises(ValueError):
+        nzt.set_schedule("fastest")  # type: ignore[arg-type]
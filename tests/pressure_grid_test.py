@@ -0,0 +1,50 @@
+from __future__ import annotations
+
+import numpy as np
+import pytest
+from numpy.testing import assert_allclose
+
+import nzthermo as nzt
+
+from .dcape_test import dewpoint, pressure, temperature
+
+
+def test_pressure_grid() -> None:
+    grid = nzt.PressureGrid(pressure)
+    assert len(grid) == pressure.size
+    assert grid.pressure.dtype == np.float64 and not grid.pressure.flags.writeable
+    assert_allclose(grid.log_pressure, np.log(pressure))
+    assert_allclose(grid.exner, (pressure / 1e5) ** (2 / 7), rtol=1e-3)
+    # the 700-500 hPa layer
+    assert_allclose(grid.pressure[grid.layer_start : grid.layer_stop], [70000, 65000, 60000, 55000, 50000])
+
+    with pytest.raises(ValueError):
+        nzt.PressureGrid(pressure[::-1])
+    with pytest.raises(ValueError):
+        nzt.PressureGrid(np.where(pressure == 85000, np.nan, pressure))
+    with pytest.raises(ValueError):
+        nzt.PressureGrid(np.tile(pressure, (2, 1)))
+
+
+@pytest.mark.parametrize("dtype", [np.float64, np.float32])
+def test_pressure_grid_kernels(dtype) -> None:
+    P, T, Td = (x.astype(dtype) for x in (pressure, temperature, dewpoint))
+    grid = nzt.PressureGrid(P)
+
+    # the grid gives the same results as the pressure levels it was built from, in the dtype of
+    # the temperature
+    ml = nzt.moist_lapse(grid, T[:, 0])
+    assert ml.dtype == np.dtype(dtype)
+    assert_allclose(ml, nzt.moist_lapse(P, T[:, 0]))
+
+    dcape = nzt.downdraft_cape(grid, T, Td)
+    assert dcape.dtype == np.dtype(dtype)
+    assert_allclose(dcape, nzt.downdraft_cape(P, T, Td), rtol=1e-5)
+
+    expected = nzt.parcel_profile(P, T, Td)
+    for actual, x in zip(nzt.parcel_profile(grid, T, Td), expected):
+        assert actual.dtype == np.dtype(dtype)
+        assert_allclose(actual, x, rtol=1e-5)
+
+    # the same grid is reused for every call and every dtype
+    assert_allclose(nzt.downdraft_cape(grid, T.astype(np.float64), Td.astype(np.float64)), dcape, rtol=1e-4)
@@ -0,0 +1,76 @@
+from __future__ import annotations
+
+import metpy.calc as mpcalc
+import numpy as np
+import pytest
+from metpy.units import units
+from numpy.testing import assert_allclose
+
+from nzthermo._c import SOUNDING_FIELDS, sounding as _sounding
+from nzthermo.core import cape_cin, ccl, convective_levels, downdraft_cape, lcl, sounding
+
+from .cape_test import dewpoint, pressure, temperature
+
+P, T, Td = (x.astype(np.float64) for x in (pressure, temperature, dewpoint))
+
+
+def test_sounding_matches_separate_calls() -> None:
+    snd = sounding(P, T, Td)
+
+    lcl_p, lcl_t = lcl(np.repeat(P[0], len(T)), T[:, 0], Td[:, 0])
+    assert_allclose(snd.lcl_pressure, lcl_p)
+    assert_allclose(snd.lcl_temperature, lcl_t)
+
+    levels = convective_levels(P, T, Td, which_lfc="bottom", which_el="top", virtual=True)
+    assert_allclose(snd.lfc_pressure, levels.lfc.pressure)
+    assert_allclose(snd.el_temperature, levels.el.temperature)
+    assert_allclose(np.stack([snd.cape, snd.cin]), cape_cin(P, T, Td))
+    assert_allclose(snd.dcape, downdraft_cape(P, T, Td))
+
+    # the (Z,) pressure is shared by every column, as it is by sounding
+    c = ccl(P, T, Td)
+    for x, y in zip(c, ccl(np.broadcast_to(P, T.shape), T, Td)):
+        assert_allclose(x, y)
+    assert_allclose(snd.ccl_pressure, c.pressure, rtol=1e-6)
+    assert_allclose(snd.ccl_temperature, c.temperature, rtol=1e-6)
+    assert_allclose(snd.convective_temperature, c.convective_temperature, rtol=1e-6)
+
+
+def test_sounding_metpy() -> None:
+    snd = sounding(P, T, Td, outputs=["lifted_index", "precipitable_water"])
+    for i in range(len(T)):
+        p, t, td = P * units.pascal, T[i] * units.kelvin, Td[i] * units.kelvin
+        prof = mpcalc.parcel_profile(p, t[0], td[0])
+        li = mpcalc.lifted_index(p, t, prof)
+        pw = mpcalc.precipitable_water(p, td)
+        assert_allclose(snd.lifted_index[i], li.m_as("K").item(), atol=0.2)
+        assert_allclose(snd.precipitable_water[i], pw.m_as("mm"), rtol=1e-3)
+
+
+def test_sounding_outputs() -> None:
+    snd = sounding(P, T, Td, outputs=["dcape"])
+    assert_allclose(snd.dcape, downdraft_cape(P, T, Td))
+    assert np.isnan(snd.cape).all() and np.isnan(snd.precipitable_water).all()
+
+    snd = sounding(P.astype(np.float32), T.astype(np.float32), Td.astype(np.float32), outputs="cape")
+    assert snd.cape.dtype == np.float32
+
+    with pytest.raises(ValueError):
+        sounding(P, T, Td, outputs=["bulk_shear"])  # type: ignore[list-item]
+
+
+def test_sounding_out() -> None:
+    # the kernel writes every field of every column, the fields that are not requested as nan
+    out = np.zeros((len(SOUNDING_FIELDS), len(T)))
+    assert _sounding(P, T, Td, outputs=["dcape"], out=out) is out
+    dcape = SOUNDING_FIELDS.index("dcape")
+    assert_allclose(out[dcape], downdraft_cape(P, T, Td))
+    assert np.isnan(np.delete(out, dcape, axis=0)).all()
+
+    # invalid inputs leave ``out`` untouched
+    out[...] = 0.0
+    with pytest.raises(ValueError):
+        _sounding(P, T, Td[:, :-1], out=out)
+    with pytest.raises(ValueError):
+        _sounding(P, T, Td, outputs=["bulk_shear"], out=out)
+    assert not out.any()
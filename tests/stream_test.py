@@ -0,0 +1,58 @@
+from __future__ import annotations
+
+import numpy as np
+import pytest
+from numpy.testing import assert_allclose
+
+import nzthermo.stream as nzs
+from nzthermo.core import ccl, downdraft_cape, lcl, moist_lapse
+
+from .dcape_test import dewpoint, pressure, temperature
+
+# (N, Z) columns, repeated so the chunks do not line up with the number of unique columns
+T = np.tile(temperature, (5, 1)).astype(np.float64)
+Td = np.tile(dewpoint, (5, 1)).astype(np.float64)
+P = pressure.astype(np.float64)
+
+
+@pytest.mark.parametrize("prefetch", [True, False])
+@pytest.mark.parametrize("chunks", [1, 3, 7, 100])
+def test_stream_broadcast(chunks, prefetch) -> None:
+    assert_allclose(nzs.moist_lapse(P, T[:, 0], chunks=chunks, prefetch=prefetch), moist_lapse(P, T[:, 0]))
+    assert_allclose(nzs.downdraft_cape(P, T, Td, chunks=chunks, prefetch=prefetch), downdraft_cape(P, T, Td))
+    (p, t, ct), (p_, t_, ct_) = nzs.ccl(P[np.newaxis], T, Td, chunks=chunks), ccl(P[np.newaxis], T, Td)
+    assert_allclose(p, p_)
+    assert_allclose(t, t_)
+    assert_allclose(ct, ct_)
+
+
+def test_stream_matrix_and_element_wise() -> None:
+    P2 = np.tile(P, (T.shape[0], 1))
+    assert_allclose(nzs.moist_lapse(P2, T[:, 0], chunks=3), moist_lapse(P2, T[:, 0]))
+    # ELEMENT_WISE: (N,) x (N,) x (N,)
+    assert_allclose(
+        nzs.moist_lapse(P2[:, 5], T[:, 0], P2[:, 0], chunks=3),
+        moist_lapse(P2[:, 5], T[:, 0], P2[:, 0]),
+    )
+    assert_allclose(nzs.lcl(P2[:, 0], T[:, 0], Td[:, 0], chunks=3), lcl(P2[:, 0], T[:, 0], Td[:, 0]))
+
+
+def test_stream_out_and_memory(tmp_path) -> None:
+    # an on disk output, and chunks sized from the memory budget
+    out = np.lib.format.open_memmap(tmp_path / "dcape.npy", mode="w+", dtype=np.float32, shape=(T.shape[0],))
+    x = nzs.downdraft_cape(P, T, Td, max_memory=4096, out=out, dtype=np.float32)
+    assert x is out
+    assert_allclose(x, downdraft_cape(P, T, Td, dtype=np.float32), rtol=1e-5)
+    assert nzs.chunk_size(T, Td, max_memory=4096) == 4096 // (2 * 2 * 8 * T.shape[1] + 8 * T.shape[1])
+
+
+def test_stream_dask() -> None:
+    da = pytest.importorskip("dask.array")
+    t, td = da.from_array(T, chunks=(2, 5)), da.from_array(Td, chunks=(2, 5))
+    dcape = nzs.map_blocks(downdraft_cape, P, t, td, tiled=(False, True, True), chunks=3)
+    assert_allclose(dcape.compute(), downdraft_cape(P, T, Td))
+
+    p0 = P[: T.shape[0]]
+    lcl_ = nzs.map_blocks(lcl, da.from_array(p0), t[:, 0], td[:, 0], tiled=(True, True, True), axis=1, chunks=3)
+    assert lcl_.shape == (2, T.shape[0])
+    assert_allclose(lcl_.compute(), lcl(p0, T[:, 0], Td[:, 0]))